@@ -2,25 +2,111 @@
 #include "parser.hpp"
 #include "lexer.hpp"
 #include <memory>
+#include <map>
+#include <set>
+
+// type of an analyzed expression. literal is set for literals without a suffix and for
+// expressions made only of those, they take the type of the place they are used in.
+// error is set when an error was already reported for the expression.
+// lanes is set for vectors, type is the type of their elements then. arrays and slices
+// have arrayLength or isSlice set, type and lanes describe their elements. structs have
+// their name in structName and IDENT as their type. pointers have isPointer set, the other
+// members describe what they point to
+struct ExprType{
+  TokenType type = TokenType::VOID;
+  bool literal = false;
+  bool error = false;
+  unsigned lanes = 0;
+  unsigned arrayLength = 0;
+  bool isSlice = false;
+  std::string structName = {};
+  bool isPointer = false;
+  bool isAtomic = false;
+};
 
 struct SymbolInfo{
-  TokenType type;
+  ExprType type;
   bool intitialized;
+  DeclerationStmtNode* decleration = nullptr;
+};
+
+// 0 <= variable < bound holds in the body of a loop or an if. the bound is a constant or the
+// length of the array or slice lengthOf
+struct RangeFact{
+  std::string variable;
+  std::optional<uint64_t> bound;
+  std::string lengthOf;
 };
 
+// maps the type parameters of a generic function to the concrete types of an instantiation
+using TypeBindings = std::unordered_map<std::string, TokenType>;
+
 class Analyzer{
   private:
     // vector works like stack in this case, we push and pop scopes accordingly
     std::vector<std::unordered_map<std::string, SymbolInfo>> m_scopes;
     std::vector<std::string> m_errors;
 
+    std::unordered_map<std::string, FunctionNode*> m_functions;
+    std::unordered_map<std::string, const StructNode*> m_structs;
+
+    // prototype of the function whose body is being analyzed, return statements are checked against it
+    const ProtoTypeNode* m_currentFunction = nullptr;
+    // variables whose address that function takes, see FunctionNode::addressTaken
+    const std::set<std::string>* m_addressTaken = nullptr;
+
+    // facts of the loops and ifs around the statement being analyzed, innermost last
+    std::vector<RangeFact> m_rangeFacts;
+    // > 0 inside @unchecked functions and loops
+    unsigned m_unchecked = 0;
+
+    // instantiation cache for generic functions, keyed by the generic function and its type arguments
+    std::map<std::pair<const FunctionNode*, std::vector<TokenType>>, std::string> m_instantiations;
+
+    // instantiated functions that still have to be analyzed and added to the program
+    std::vector<std::unique_ptr<StmtNode>> m_instances;
+
+    SymbolInfo* LookupSymbol(const std::string& name);
+    std::string Instantiate(FunctionNode* generic, const std::vector<TokenType>& typeArgs);
+
+    Token CloneType(const Token& type, const TypeBindings& bindings);
+    std::unique_ptr<PrimaryExprNode> ClonePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr, const TypeBindings& bindings);
+    std::unique_ptr<ExprNode> CloneExpr(const std::unique_ptr<ExprNode>& expr, const TypeBindings& bindings);
+    std::unique_ptr<StmtNode> CloneStmt(const std::unique_ptr<StmtNode>& stmt, const TypeBindings& bindings);
+    std::unique_ptr<FunctionNode> CloneFunction(const FunctionNode* function, const TypeBindings& bindings);
+    bool IsConstantExpr(const std::unique_ptr<ExprNode>& expr);
+
+    // gives the literals of an expression without a suffix the type the expression is used as
+    void ResolveLiterals(const std::unique_ptr<ExprNode>& expr, TokenType type);
+    // literals that end up without a context become int or float
+    void ResolveDefault(const std::unique_ptr<ExprNode>& expr, const ExprType& type);
+    // reports an error unless the expression converts to the type implicitly. where names the place for the message
+    void CheckConversion(const std::unique_ptr<ExprNode>& expr, const ExprType& type, const ExprType& target, const std::string& where);
+    // the type both operands of a binary operator are converted to
+    ExprType UnifyOperands(const std::unique_ptr<ExprNode>& lhs, const ExprType& lhsType, const std::unique_ptr<ExprNode>& rhs, const ExprType& rhsType);
+    // calls of the vector builtins, see IsBuiltinFunction
+    ExprType AnalyzeBuiltin(const std::unique_ptr<CallExprNode>& call);
+    // type of the element array[index], clears boundsCheck when the index is known to be in range
+    ExprType AnalyzeIndex(const Token& array, const std::unique_ptr<ExprNode>& index, bool& boundsCheck);
+    // type of the field that fields selects in a value of the given type. name describes the value for messages
+    ExprType AnalyzeFields(ExprType type, const std::vector<Token>& fields, const std::string& name);
+    // reports duplicate fields and fields that can't be stored in a struct
+    void AnalyzeStruct(const StructNode& structNode);
+    // an atomic or a struct with atomic fields, which can't be read or written as a whole
+    bool IsAtomicValue(const ExprType& type);
+    // calls of load, store, fetch_add, fetch_sub and cas
+    ExprType AnalyzeAtomic(const std::unique_ptr<CallExprNode>& call);
+    // the fact a condition like i < len(a) gives its variable, nullopt for any other condition
+    std::optional<RangeFact> GetRangeFact(const std::unique_ptr<ExprNode>& condition);
+    // the fact that holds for the variable of a counting loop in its body, see AnalyzeStmt
+    std::optional<RangeFact> GetLoopFact(const std::unique_ptr<ForStmtNode>& forStmt);
 
   public:
     Analyzer() = default; 
     
 
-    void AnalyzePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr);
-    void AnalyzeExpr(const std::unique_ptr<ExprNode>& expr);
+    ExprType AnalyzePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr);
+    ExprType AnalyzeExpr(const std::unique_ptr<ExprNode>& expr);
     void AnalyzeStmt(const std::unique_ptr<StmtNode>& stmt);
     bool Analyze(const std::unique_ptr<ProgNode>& prog);
 
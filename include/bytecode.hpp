@@ -0,0 +1,167 @@
+#pragma once
+
+#include "parser.hpp"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// one register of the interpreter. values live in the low bytes, the same layout tier entries
+// use for arguments and results, so registers can be handed to JIT code as they are
+union Slot{
+    int32_t i32;
+    uint32_t u32;
+    float f32;
+    int64_t i64;
+    uint64_t u64;
+    double f64;
+};
+
+// a, b and c are operands of the instruction. bc is the 32 bit operand made of b and c
+enum class Opcode : uint8_t{
+    LOAD_CONST,      // a = constants[bc]
+    MOVE,            // a = b
+    LOAD_GLOBAL_32,  // a = *globals[b]
+    STORE_GLOBAL_32, // *globals[b] = a
+
+    ADD_I32,
+    SUB_I32,
+    MUL_I32,
+    DIV_I32,
+    DIV_U32,
+    // --checked-arith, stop the program on signed overflow
+    ADD_I32_CHECKED,
+    SUB_I32_CHECKED,
+    MUL_I32_CHECKED,
+    ADD_F32,
+    SUB_F32,
+    MUL_F32,
+    DIV_F32,
+
+    // comparisons write 0 or 1
+    EQ_I32,
+    NE_I32,
+    LT_I32,
+    GT_I32,
+    LE_I32,
+    GE_I32,
+    LT_U32,
+    GT_U32,
+    LE_U32,
+    GE_U32,
+    EQ_F32,
+    NE_F32,
+    LT_F32,
+    GT_F32,
+    LE_F32,
+    GE_F32,
+
+    I32_TO_F32,
+    U32_TO_F32,
+    F32_TO_I32,
+    F32_TO_U32,
+
+    JUMP,            // continue at instruction bc
+    JUMP_IF_FALSE,   // continue at instruction bc if a is 0
+    CALL,            // a = functions[b](c, c + 1, ...)
+    RETURN,          // return a
+    RETURN_VOID,
+
+    COUNT
+};
+
+struct Instruction{
+    Opcode op;
+    uint16_t a = 0;
+    uint16_t b = 0;
+    uint16_t c = 0;
+
+    uint32_t bc() const { return uint32_t(b) | uint32_t(c) << 16; }
+};
+
+enum class ValueKind{
+    I32,
+    U32,
+    F32,
+    // result of a comparison, stored like an i32
+    BOOL,
+    VOID
+};
+
+struct BytecodeFunction{
+    std::string name;
+    std::vector<Instruction> code;
+    std::vector<Slot> constants;
+    uint16_t registerCount = 0;
+    // the arguments are passed in the first registers
+    uint16_t paramCount = 0;
+    std::vector<ValueKind> paramKinds;
+    ValueKind returnKind = ValueKind::VOID;
+    // false when a parameter or the return value has a type the interpreter doesn't know,
+    // only JIT code can call the function then
+    bool knownSignature = true;
+    // functions the interpreter can't run are compiled by the JIT before their first call
+    bool supported = true;
+    std::string unsupportedReason;
+};
+
+struct BytecodeGlobal{
+    std::string name;
+    ValueKind kind;
+};
+
+struct BytecodeProgram{
+    std::vector<BytecodeFunction> functions;
+    std::unordered_map<std::string, uint16_t> functionIndices;
+    // global storage belongs to the JIT, the interpreter looks up the addresses by name
+    std::vector<BytecodeGlobal> globals;
+    std::unordered_map<std::string, uint16_t> globalIndices;
+};
+
+struct TypedRegister{
+    uint16_t reg;
+    ValueKind kind;
+};
+
+// lowers the function bodies of an analyzed program to register bytecode. every variable gets
+// its own register, expression results go to fresh temporaries
+class BytecodeCompiler{
+    private:
+        BytecodeProgram m_program;
+        BytecodeFunction* m_function = nullptr;
+        bool m_checkedArithmetic = false;
+        std::map<std::string, TypedRegister> m_locals;
+
+        void Unsupported(const std::string& reason);
+        uint16_t NewRegister();
+        size_t Emit(Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+        size_t EmitWide(Opcode op, uint16_t a, uint32_t bc);
+        void PatchJump(size_t instruction, size_t target);
+        TypedRegister LoadConstant(Slot value, ValueKind kind);
+        // converts integers stored into float variables, like the generator does
+        TypedRegister Convert(TypedRegister value, ValueKind kind);
+        // explicit conversion, floats are truncated towards 0 when converted to integers
+        TypedRegister Cast(TypedRegister value, ValueKind kind);
+
+        // the converted arguments of a call in consecutive registers, returns the first of them
+        uint16_t CompileArguments(uint16_t function, const std::vector<std::unique_ptr<ExprNode>>& args);
+        TypedRegister CompilePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr);
+        TypedRegister CompileExpr(const std::unique_ptr<ExprNode>& expr);
+        // a register that is 0 when the condition is false, floats are compared like the generator does
+        TypedRegister CompileCondition(const std::unique_ptr<ExprNode>& expr);
+        void CompileStmt(const std::unique_ptr<StmtNode>& stmt);
+        void CompileFunction(const FunctionNode& function);
+
+    public:
+        // checkedArithmetic uses the checked opcodes for signed add, sub and mul, like the generator does with --checked-arith
+        explicit BytecodeCompiler(bool checkedArithmetic = false) : m_checkedArithmetic(checkedArithmetic) {}
+
+        BytecodeProgram Compile(const std::unique_ptr<ProgNode>& prog);
+};
+
+// kind of the values of a type, nullopt for types the interpreter doesn't know
+std::optional<ValueKind> GetValueKind(TokenType type);
+// nullopt for vectors as well
+std::optional<ValueKind> GetValueKind(const Token& type);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "parser.hpp"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+// content addressed store of compiled objects on disk. every entry is a file named after its
+// key. loading an entry refreshes its modification time, so Trim can evict the least recently
+// used entries once the cache grows past its size limit
+class ObjectCache{
+    private:
+        std::string m_directory;
+        uint64_t m_maxSize;
+
+        std::atomic<unsigned> m_hits = 0;
+        std::atomic<unsigned> m_misses = 0;
+        std::atomic<unsigned> m_evicted = 0;
+
+        std::string GetEntryPath(const std::string& key);
+
+    public:
+        ObjectCache(const std::string& directory, uint64_t maxSize);
+
+        // false when the cache directory can't be created
+        bool IsValid();
+
+        // the cached object, nullptr on a miss
+        std::unique_ptr<llvm::MemoryBuffer> Load(const std::string& key);
+
+        // entries are written to a temporary file first, concurrent builds never see half an object
+        void Store(const std::string& key, llvm::StringRef object);
+
+        // evicts least recently used entries until the cache fits its size limit
+        void Trim();
+
+        void PrintStats();
+};
+
+// hashes everything the generated code of a function depends on: its AST without source
+// positions, the prototypes of the functions it calls, the declarations of the globals it
+// uses and the compiler configuration
+class FunctionHasher{
+    private:
+        llvm::MD5 m_hash;
+        const std::map<std::string, const ProtoTypeNode*>& m_functions;
+        const std::map<std::string, const DeclerationStmtNode*>& m_globals;
+        // debug info refers to lines and columns, so they are part of the key with -g
+        bool m_positions;
+
+        std::set<std::string> m_callees;
+        std::set<std::string> m_identifiers;
+
+        void HashString(llvm::StringRef text);
+        void HashToken(const Token& token);
+        void HashFields(const std::vector<Token>& fields);
+        void HashPrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr);
+        void HashExpr(const std::unique_ptr<ExprNode>& expr);
+        void HashStmt(const std::unique_ptr<StmtNode>& stmt);
+        void HashGlobal(const DeclerationStmtNode& global);
+        void HashPrototype(const ProtoTypeNode& prototype);
+
+    public:
+        FunctionHasher(const std::map<std::string, const ProtoTypeNode*>& functions, const std::map<std::string, const DeclerationStmtNode*>& globals, bool positions);
+
+        // hex key of a function
+        std::string HashFunction(const FunctionNode& function, const std::string& configuration);
+
+        // hex key of the definitions of all globals
+        std::string HashGlobals(const std::string& configuration);
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "options.hpp"
+#include "emitter.hpp"
+#include "generator.hpp"
+#include "optimizer.hpp"
+#include "llvm/Support/MemoryBuffer.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// target machines and optimization pipelines kept warm between compilations, so a long running
+// process builds them once per configuration instead of once per compile. every acquired pair is
+// used by one compilation at a time, the pool itself is thread safe
+class CompilerPool{
+    private:
+        struct Target{
+            std::unique_ptr<Emitter> emitter;
+            std::unique_ptr<Optimizer> optimizer;
+        };
+
+        std::mutex m_mutex;
+        std::map<std::pair<OptLevel, std::string>, std::vector<Target>> m_targets;
+        unsigned m_created = 0;
+
+    public:
+        // a warm emitter and optimizer for the configuration, new ones when none are free
+        void Acquire(OptLevel level, const std::string& cpu, std::unique_ptr<Emitter>& emitter, std::unique_ptr<Optimizer>& optimizer);
+
+        void Release(OptLevel level, const std::string& cpu, std::unique_ptr<Emitter> emitter, std::unique_ptr<Optimizer> optimizer);
+
+        // number of target machines built so far
+        unsigned GetCreatedCount();
+};
+
+// one generated module together with the target machine it was generated for
+struct CompiledUnit{
+    std::unique_ptr<Emitter> emitter;
+    std::unique_ptr<Optimizer> optimizer;
+    GeneratedModule generated;
+    // with the object cache every unit is compiled to an object right away, either by the
+    // backend or loaded from the cache. name is its member name in the output archive
+    std::string name;
+    std::unique_ptr<llvm::MemoryBuffer> object;
+};
+
+// runs one compilation from source text to its output. an instance owns all of its LLVM state
+// (contexts, modules and target machines), so independent instances can run concurrently on
+// different threads of the same process
+class CompilerInstance{
+    private:
+        Options m_options;
+        CompilerPool* m_pool = nullptr;
+        std::unique_ptr<ProgNode> m_prog;
+        std::vector<CompiledUnit> m_units;
+
+        // gives the unit an emitter and optimizer, warm ones from the pool when there is one
+        void AcquireTarget(CompiledUnit& unit);
+        // hands the emitters and optimizers of the units back to the pool
+        void ReleaseTargets(std::vector<CompiledUnit>& units);
+
+        bool CompileUnits();
+
+        // compiles every function into its own object, reusing cached objects of unchanged functions
+        bool CompileCached();
+
+    public:
+        // with a pool, target machines and optimization pipelines are taken from it and given back
+        // when the instance is destroyed
+        CompilerInstance(const Options& options, CompilerPool* pool = nullptr);
+        ~CompilerInstance();
+
+        // lexes, parses, analyzes, generates and optimizes the source. false on errors
+        bool Compile(const std::string& source);
+
+        // reads the input file of the options and compiles it
+        bool CompileFile();
+
+        // writes the compiled modules to the output of the options
+        bool Emit();
+
+        // the analyzed program of the last successful Compile, with generic functions instantiated
+        const std::unique_ptr<ProgNode>& GetProgram() const;
+
+        // hands the compiled module and its context over to the caller. only valid with one codegen unit
+        GeneratedModule TakeModule();
+
+        // hands every codegen unit over to the caller, in unit order
+        std::vector<GeneratedModule> TakeModules();
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "llvm/Support/raw_ostream.h"
+#include <ostream>
+
+// thrown by AbortCompilation, CompilerInstance turns it into a failed compile
+struct CompilationAborted{};
+
+// stops the compilation after an error has been reported. it throws instead of exiting, so a
+// broken source only fails its own compilation and long running processes like the compile
+// server survive it. the command line exits once the compile has failed
+[[noreturn]] void AbortCompilation();
+
+// where the compilation running on this thread reports errors and warnings, std::cerr unless
+// an ErrorStreamScope redirects it
+std::ostream& GetErrorStream();
+
+// the same stream for code that prints LLVM values and types
+llvm::raw_ostream& GetLLVMErrorStream();
+
+// sends the errors of the current thread to stream until the scope ends. the stream is only
+// written by this thread, the compile server captures the errors of each request with it
+class ErrorStreamScope{
+    private:
+        std::ostream* m_previous;
+
+    public:
+        ErrorStreamScope(std::ostream& stream);
+        ~ErrorStreamScope();
+
+        ErrorStreamScope(const ErrorStreamScope&) = delete;
+        ErrorStreamScope& operator=(const ErrorStreamScope&) = delete;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "options.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <memory>
+#include <string>
+
+#if LLVM_VERSION_MAJOR >= 18
+using CodeGenOptLevel = llvm::CodeGenOptLevel;
+#else
+using CodeGenOptLevel = llvm::CodeGenOpt::Level;
+#endif
+
+// registers the native target with LLVM, safe to call from any thread and more than once
+void InitializeTargets();
+
+// backend optimization level for an optimization level
+CodeGenOptLevel GetCodeGenOptLevel(OptLevel level);
+
+// owns the TargetMachine for the host triple and writes modules out as native code
+class Emitter{
+    private:
+        std::unique_ptr<llvm::TargetMachine> m_targetMachine;
+
+        // native object code or assembly
+        bool EmitCode(llvm::Module& module, llvm::raw_pwrite_stream& output, OutputType type);
+
+    public:
+        Emitter(OptLevel level, const std::string& cpu);
+
+        // null when the host target could not be created
+        llvm::TargetMachine* GetTargetMachine();
+
+        // writes the module as textual IR (stderr when the path is empty), bitcode, object code or
+        // assembly straight from the in-memory module
+        bool EmitFile(llvm::Module& module, const std::string& path, OutputType type);
+
+        // compiles the module to an object file in memory
+        bool EmitObject(llvm::Module& module, llvm::SmallVectorImpl<char>& object);
+};
@@ -8,25 +8,57 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Target/TargetMachine.h"
 #include <algorithm>
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 struct VarInfo{
+  // only variables that have to live in memory get an alloca, the rest are kept in SSA registers
   llvm::AllocaInst* alloca;
   bool isUnsigned;
+  llvm::Type* type;
+  std::string name;
+  // identifies the variable during SSA construction, shadowed variables have different ids
+  unsigned id;
+  // element type of arrays and slices, null for every other variable
+  llvm::Type* elementType = nullptr;
+};
+
+// a generated module together with the context that owns its types and constants.
+// the module is declared last so it is destroyed before its context
+struct GeneratedModule{
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+};
+
+// the part of a program that one module is generated for when code generation is split up
+struct CodegenUnit{
+  unsigned index;
+  // functions whose bodies are generated in this unit, every other function is only declared.
+  // globals are defined by unit 0 and declared by the others
+  std::set<const FunctionNode*> functions;
+};
+
+struct GlobalInfo{
+  llvm::GlobalVariable* global;
+  bool isUnsigned;
+  llvm::Type* elementType = nullptr;
 };
 
 struct TypedValue{
@@ -34,23 +66,221 @@ struct TypedValue{
   bool isUnsigned = false;
 };
 
+// an array or slice variable as a pointer to its first element and its number of elements.
+// a pointer variable is one too, its length is null
+struct SliceValue{
+  llvm::Value* pointer;
+  llvm::Value* length;
+  llvm::Type* elementType;
+  bool isUnsigned;
+  // elements of a @soa struct have a pointer to the first element of every field array
+  // instead, in the order of the fields of the struct type. pointer is null then
+  std::vector<llvm::Value*> fieldPointers = {};
+};
+
+struct StructFieldInfo{
+  // element of the LLVM struct type
+  unsigned index;
+  bool isUnsigned;
+};
+
+// how a struct is laid out in memory, see Generator::GenStruct
+struct StructInfo{
+  // a named type, its name is the name of the struct
+  llvm::StructType* type;
+  std::map<std::string, StructFieldInfo> fields;
+  // @align and @cacheline_pad raise the alignment above the one of the fields
+  llvm::Align alignment;
+  // arrays of the struct are a struct of one array per element of type
+  bool soa;
+  // a struct with atomic fields, directly or in a struct field, always lives in memory
+  bool hasAtomics = false;
+};
+
+// name of the tier entry of a function, see Generator::GenTierEntry
+std::string GetTierEntryName(const std::string& function);
+
 class Generator{
     private:
         std::unique_ptr<ProgNode> m_prog;
+        llvm::TargetMachine* m_targetMachine = nullptr;
+        const CodegenUnit* m_unit = nullptr;
+        bool m_tierEntries = false;
+
+        // every generator owns its context, so independent generators can run on different threads
+        std::unique_ptr<llvm::LLVMContext> m_context;
+        std::unique_ptr<llvm::IRBuilder<>> m_builder;
+        std::unique_ptr<llvm::Module> m_module;
+
+        std::map<std::string, GlobalInfo> m_globalValues;
+        std::map<std::string, StructInfo> m_structs;
+        std::map<std::string, const ProtoTypeNode *> m_functionProtos;
+        std::map<std::string, VarInfo> m_namedValues;
+        llvm::Function * m_currentFunc = nullptr;
+        const ProtoTypeNode * m_currentProto = nullptr;
+
+        // signed overflow traps instead of being undefined, see GenCheckedArithmetic
+        bool m_checkedArithmetic = false;
+        // shared by every overflow and bounds check of the current function, see GetTrapBlock
+        llvm::BasicBlock * m_trapBlock = nullptr;
+
+        // -ffast-math, every function is compiled as if it had a plain @fastmath
+        bool m_fastMath = false;
+
+        // type based alias analysis nodes of the module, see GetTBAATag
+        llvm::MDNode* m_tbaaRoot = nullptr;
+        std::map<llvm::Type*, llvm::MDNode*> m_tbaaTags;
+
+        // SSA construction state of the current function
+        std::map<unsigned, std::map<llvm::BasicBlock *, llvm::Value *>> m_currentDef;
+        std::map<llvm::BasicBlock *, std::vector<std::pair<VarInfo, llvm::PHINode *>>> m_incompletePhis;
+        std::set<llvm::BasicBlock *> m_sealedBlocks;
+        unsigned m_nextVariableId = 0;
+
+        // line tables, only created when debug info is enabled
+        std::string m_debugSourcePath;
+        std::unique_ptr<llvm::DIBuilder> m_debugBuilder;
+        llvm::DIFile* m_debugFile = nullptr;
+        llvm::DISubprogram* m_debugFunction = nullptr;
+
+        void InitializeModule();
 
     public:
         Generator() = default;
 
+        // modules are created with the triple and data layout of the target machine
+        // tierEntries also generates a tier entry for every function, used by the interpreter to call JIT code
+        Generator(llvm::TargetMachine* targetMachine, bool tierEntries = false) : m_targetMachine(targetMachine), m_tierEntries(tierEntries) {}
+
+        // emits a line table only compile unit for the source file, every function gets a
+        // DISubprogram and every statement and call the location of its first token
+        void EnableDebugInfo(const std::string& sourcePath);
+
+        // signed add, sub and mul trap on overflow instead of carrying nsw
+        void EnableCheckedArithmetic();
+
+        // float operations of every function get all fast-math flags
+        void EnableFastMath();
+
+        // location of the instructions generated from now on, ignored outside of functions with debug info
+        void SetDebugLocation(unsigned line, unsigned column);
+
         // --- ADDED/MODIFIED DECLARATIONS BELOW ---
         // New helper function to get LLVM Type
         llvm::Type* GetTypeFromToken(TokenType type); 
+        // also handles vec<T, lanes> types, arrays and slices
+        llvm::Type* GetTypeFromToken(const Token& type);
+
+        // element type of array and slice types, null for every other type
+        llvm::Type* GetElementType(const Token& type);
+
+        // { pointer to the first element, i64 length }, slices are passed and stored as this.
+        // slices of a @soa struct have a pointer to every field array instead of the first one
+        llvm::StructType* GetSliceType(llvm::Type* elementType);
+
+        // creates the LLVM type of a struct. fields are sorted by alignment unless the struct is
+        // @packed, and @align and @cacheline_pad add padding
+        void GenStruct(const StructNode& structNode);
+
+        // the layout of a struct type, null for every other type
+        const StructInfo* GetStructInfo(llvm::Type* type);
+
+        // the LLVM indices of the fields selected one after the other, starting at a value of
+        // the given type. type and isUnsigned become the ones of the last field
+        std::vector<unsigned> GetFieldPath(llvm::Type*& type, bool& isUnsigned, const std::vector<Token>& fields);
+
+        // address of a global or of a local that lives in memory, or of the field of it that
+        // fields selects. type and isUnsigned become the ones of what it points to
+        llvm::Value* GenVariablePointer(const std::string& name, llvm::Type*& type, bool& isUnsigned, const std::vector<Token>& fields);
+
+        // the !tbaa access tag of a value of the type, null for structs and arrays. every number
+        // and vector type is a type node of its own under one root, XD can't access memory as
+        // another type than the one it was stored as
+        llvm::MDNode* GetTBAATag(llvm::Type* type);
+        // loads and stores of XD values, they carry the access tag of their type
+        llvm::LoadInst* GenLoad(llvm::Type* type, llvm::Value* pointer);
+        llvm::StoreInst* GenStore(llvm::Value* value, llvm::Value* pointer);
         
+        // converts value to type, integers are extended by their own signedness. targetUnsigned
+        // selects the conversion of floats to integers. vectors are converted lane by lane and
+        // scalars converted to a vector type are broadcast to every lane
+        llvm::Value* ConvertToType(TypedValue value, llvm::Type* type, bool targetUnsigned = false);
+
+        // widens the operands of a binary operation to a common type
+        void UnifyOperands(TypedValue& lhs, TypedValue& rhs);
+
+        // on the fly SSA construction for variables that are not kept in memory, as described in
+        // "Simple and Efficient Construction of Static Single Assignment Form" (Braun et al.)
+        void WriteVariable(const VarInfo& variable, llvm::BasicBlock* block, llvm::Value* value);
+        llvm::Value* ReadVariable(const VarInfo& variable, llvm::BasicBlock* block);
+        llvm::Value* ReadVariableRecursive(const VarInfo& variable, llvm::BasicBlock* block);
+        llvm::Value* AddPhiOperands(const VarInfo& variable, llvm::PHINode* phi);
+        llvm::Value* TryRemoveTrivialPhi(llvm::PHINode* phi);
+        // marks a block whose predecessors are all known
+        void SealBlock(llvm::BasicBlock* block);
+
+        llvm::Function* GenPrototype(const std::unique_ptr<ProtoTypeNode>& prototype);
+
+        // void xd.tier.<name>(i64* arguments, i64* result) calls the function with its arguments
+        // read from the argument slots and stores the result in the result slot. this gives every
+        // function the same signature, so the interpreter can call it without knowing its type
+        void GenTierEntry(llvm::Function* function);
+
         TypedValue GenPrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr);
+
+        // a cold block that calls llvm.trap, created the first time a check of the current function needs it
+        llvm::BasicBlock* GetTrapBlock();
+
+        // result of an llvm.*.with.overflow intrinsic, branches to the trap block of the function when it overflowed
+        llvm::Value* GenCheckedArithmetic(llvm::Intrinsic::ID intrinsic, llvm::Value* lhs, llvm::Value* rhs);
+
+        TypedValue GenBinOp(BinOpType type, TypedValue lhs, TypedValue rhs);
+
+        // the elements of an array or slice variable. the length of an array is a constant
+        SliceValue GenSlice(const Token& identifier);
+        // the slice as a value of GetSliceType, which is how it is passed to functions
+        llvm::Value* PackSlice(const SliceValue& slice);
+        SliceValue UnpackSlice(llvm::Value* slice, llvm::Type* elementType, bool isUnsigned);
+        // the index as an i64. unless boundsCheck is cleared, an index that isn't below the
+        // length branches to the trap block. negative indices fail the same unsigned comparison
+        llvm::Value* GenIndex(const SliceValue& slice, const std::unique_ptr<ExprNode>& index, bool boundsCheck);
+        // address of slice[position] or of the field at path in it. a @soa element has no
+        // address, only its fields do
+        llvm::Value* GenElementPointer(const SliceValue& slice, llvm::Value* position, const std::vector<unsigned>& path);
+        // a whole @soa element is loaded from and stored to every field array
+        llvm::Value* GenGatherElement(const SliceValue& slice, llvm::Value* position);
+        void GenScatterElement(const SliceValue& slice, llvm::Value* position, llvm::Value* element);
+
+        // arguments are converted to the parameter types, the call gets the calling convention of the callee
+        TypedValue GenCall(const std::unique_ptr<CallExprNode>& call);
+
+        // the vector builtins are generated inline, see IsBuiltinFunction
+        TypedValue GenBuiltin(const std::unique_ptr<CallExprNode>& call);
+        // address of the atomic variable, element or field that the first argument of an atomic
+        // builtin names. type and isUnsigned become the ones of the atomic
+        llvm::Value* GenAtomicPointer(const std::unique_ptr<ExprNode>& expr, llvm::Type*& type, bool& isUnsigned);
+        // load, store, fetch_add, fetch_sub and cas as atomic instructions with the ordering of the call
+        TypedValue GenAtomic(const std::unique_ptr<CallExprNode>& call);
         
         TypedValue GenExpr(const std::unique_ptr<ExprNode>& expr);
 
+        // the expression as an i1 for a branch, numbers are true when they are not 0
+        llvm::Value* GenCondition(const std::unique_ptr<ExprNode>& expr);
+
+        // llvm.loop metadata for the hints of a loop, null when there are none
+        llvm::MDNode* GenLoopMetadata(const LoopHints& hints, const llvm::DebugLoc& location);
+
+        // folds a global initializer into an llvm::Constant, no code is emitted
+        TypedValue GenConstantExpr(const std::unique_ptr<ExprNode>& expr);
+
         
         void GenStmt(const std::unique_ptr<StmtNode>& stmt);
-        void Generate(const std::unique_ptr<ProgNode>& prog);
+        // generates the whole program, or only the given unit of it
+        void Generate(const std::unique_ptr<ProgNode>& prog, const CodegenUnit* unit = nullptr);
+
+        llvm::Module& GetModule();
+
+        // hands the module and its context over to the caller, the generator can't use them afterwards
+        GeneratedModule TakeModule();
 
 };
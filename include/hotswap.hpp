@@ -0,0 +1,79 @@
+#pragma once
+
+#include "options.hpp"
+#include "emitter.hpp"
+#include "generator.hpp"
+#include "optimizer.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#if LLVM_VERSION_MAJOR >= 17
+using StubAddress = llvm::orc::ExecutorAddr;
+#else
+using StubAddress = llvm::JITTargetAddress;
+#endif
+
+// the compiled body behind the stub of a function
+struct FunctionVersion{
+    // hash of the unoptimized IR of the function, together with the declarations it uses
+    size_t fingerprint;
+    unsigned version;
+};
+
+// a JIT session whose functions can be replaced while it runs. every function is compiled into
+// its own module as <name>.v<version>, and its symbol <name> is an indirect stub that jumps to
+// the current version. calls between XD functions and callers of Lookup all go through the stubs,
+// so Load only has to compile the functions that changed and repoint their stubs. old versions
+// are never freed, calls that are running when a stub is repointed finish on the old code
+class HotSwapJit{
+    private:
+        Options m_options;
+
+        // declared first so the stubs outlive the code that jumps through them
+        std::unique_ptr<llvm::orc::IndirectStubsManager> m_stubs;
+        std::unique_ptr<llvm::orc::LLJIT> m_jit;
+
+        std::unique_ptr<Emitter> m_emitter;
+        std::unique_ptr<Optimizer> m_optimizer;
+
+        std::map<std::string, FunctionVersion> m_functions;
+        // fingerprint of the globals, they are defined once and can't change afterwards
+        std::optional<size_t> m_globalsFingerprint;
+        std::vector<std::string> m_swapped;
+
+        std::mutex m_loadMutex;
+
+        bool LookupAddress(const std::string& name, StubAddress& address);
+        bool AddModule(GeneratedModule generated);
+        // the part of Load that compiles the source, compile errors throw CompilationAborted
+        bool Swap(const std::string& source);
+
+    public:
+        HotSwapJit(const Options& options);
+
+        // false when the JIT could not be created
+        bool IsValid();
+
+        // compiles the functions of the source that are new or changed since the last Load and
+        // repoints their stubs. nothing is swapped when the source has errors or its globals
+        // changed. safe to call while other threads run XD code
+        bool Load(const std::string& source);
+
+        // functions compiled by the last Load
+        const std::vector<std::string>& GetSwappedFunctions();
+
+        // address of the stub of a function. it stays the same across swaps, so callers can keep it.
+        // only main has the C calling convention, every other function uses fastcc and can't be
+        // called through a C function pointer
+        void* Lookup(const std::string& name);
+
+        // calls main and returns its result. -1 when main can't be found
+        int RunMain();
+};
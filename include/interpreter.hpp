@@ -0,0 +1,67 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "options.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// the tier entry of a function, see Generator::GenTierEntry
+using NativeEntry = void (*)(Slot* arguments, Slot* result);
+
+struct FunctionState{
+    // set by the background compiler, calls go to the JIT code from then on
+    std::atomic<NativeEntry> native = nullptr;
+    unsigned calls = 0;
+    unsigned backEdges = 0;
+    bool tierUpRequested = false;
+};
+
+// tier 0 of --tiered. runs bytecode with threaded dispatch and counts calls and loop back edges
+// per function. a function that reaches the threshold is compiled by the JIT on a background
+// thread while the interpreter keeps running it, the next call then goes to the compiled code.
+// frames that are already running stay in the interpreter
+class Interpreter{
+    private:
+        BytecodeProgram m_program;
+        Jit& m_jit;
+        unsigned m_threshold;
+        bool m_printStats;
+
+        std::unique_ptr<FunctionState[]> m_states;
+        // addresses of the globals in the JIT, shared with compiled code
+        std::vector<void*> m_globals;
+
+        // registers of all active frames. never resized, so frames can keep pointers into it
+        std::vector<Slot> m_stack;
+        size_t m_stackTop = 0;
+
+        std::thread m_compiler;
+        std::mutex m_queueMutex;
+        std::condition_variable m_queueReady;
+        std::deque<uint16_t> m_queue;
+        bool m_stopping = false;
+
+        Slot Call(uint16_t function, Slot* arguments);
+        Slot Execute(uint16_t function, Slot* arguments);
+        void RequestTierUp(uint16_t function);
+        // compiles the function and its tier entry on the calling thread
+        bool CompileNow(uint16_t function);
+        void CompilerLoop();
+        void PrintStats();
+
+    public:
+        Interpreter(BytecodeProgram program, Jit& jit, const Options& options);
+        ~Interpreter();
+
+        // false when a global could not be found in the JIT
+        bool IsValid();
+
+        // calls main and returns its result. -1 when main can't be found
+        int RunMain();
+};
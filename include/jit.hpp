@@ -0,0 +1,38 @@
+#pragma once
+
+#include "options.hpp"
+#include "generator.hpp"
+#include "optimizer.hpp"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include <memory>
+#include <mutex>
+#include <string>
+
+// runs XD programs in process with ORC's LLLazyJIT. modules are split into one partition per
+// function behind lazy reexports, so a function is only optimized and compiled the first time
+// it is called
+class Jit{
+    private:
+        std::unique_ptr<llvm::orc::LLLazyJIT> m_jit;
+
+        // the host the JIT compiles for, the optimizer uses its costs
+        std::unique_ptr<llvm::TargetMachine> m_targetMachine;
+
+        // partitions can be materialized on any thread that calls into uncompiled code
+        std::unique_ptr<Optimizer> m_optimizer;
+        std::mutex m_optimizerMutex;
+
+    public:
+        Jit(const Options& options);
+
+        // false when the JIT could not be created
+        bool IsValid();
+
+        bool AddModule(GeneratedModule generated);
+
+        // address of a symbol, compiling the function it belongs to if needed. nullptr when it can't be found
+        void* Lookup(const std::string& name);
+
+        // calls main and returns its result. -1 when main can't be found
+        int RunMain();
+};
@@ -18,17 +18,38 @@ enum class TokenType{
     STRING_LIT,
     EQUAL,
     SEMI,
+    COMMA,
     OPEN_PAREN,
     CLOSE_PAREN,
     OPEN_BRACKET,
     CLOSE_BRACKET,
+    // [ and ], around the length of an array type and the index of an element
+    OPEN_SQUARE,
+    CLOSE_SQUARE,
+    // selects a field of a struct: p.x
+    DOT,
+    // takes the address of a variable or an element: &a[i]
+    AMPERSAND,
+    // int, uint and float are also spelled i32, u32 and f32
     INT,
     UINT,
     FLOAT,
+    I8,
+    I16,
+    I64,
+    U8,
+    U16,
+    U64,
+    F64,
     CHAR,
     STRING,
     VOID,
+    VEC,
+    // atomic<T>, an integer that is only accessed with the atomic builtins
+    ATOMIC,
     FN,
+    STRUCT,
+    RESTRICT,
     ADD,
     SUB,
     MUL,
@@ -44,19 +65,54 @@ enum class TokenType{
     LESS_OR_EQUAL,
     GREATER_OR_EQUAL,
     RETURN,
+    WHILE,
+    FOR,
+    // starts a loop annotation. example: @unroll(4)
+    AT,
 };
 
 
 struct Token{
     TokenType type;
     std::optional<std::string> value;
+    // 1 based position of the first character, 0 for tokens that are not from the source
+    unsigned line = 0;
+    unsigned column = 0;
+    // number of elements of a vec<T, lanes> type, type is the element type then. 0 for every other token
+    unsigned lanes = 0;
+    // T[arrayLength] arrays and T[] slices, type (and lanes) describe their elements then
+    unsigned arrayLength = 0;
+    bool isSlice = false;
+    // T* pointers, type (and lanes) describe what they point to. a restrict pointer parameter
+    // is the only way the function reaches the memory it points to
+    bool isPointer = false;
+    bool isRestrict = false;
+    // atomic<T>, type is T then. arrays, slices and pointers can have atomic elements
+    bool isAtomic = false;
 };
 
 
+// the numeric types: int/i32, uint/u32, float/f32 and the other fixed width types
+bool IsNumericType(TokenType type);
+bool IsFloatType(TokenType type);
+bool IsUnsignedType(TokenType type);
+// width in bits, 0 for types that aren't numeric
+unsigned GetTypeBits(TokenType type);
+// name as it is written in the source, i32 is printed as int
+std::string GetTypeName(TokenType type);
+// the type of a literal suffix like u8 or f64, nullopt for an unknown suffix
+std::optional<TokenType> GetSuffixType(const std::string& suffix);
+
 class Lexer{
     private:
         std::string m_code;
         int m_index = 0;
+        unsigned m_line = 1;
+        unsigned m_column = 1;
+
+        // where the token that is being lexed starts
+        unsigned m_tokenLine = 1;
+        unsigned m_tokenColumn = 1;
 
         std::unordered_map<std::string, TokenType> m_TokenMap = {
             {"exit", TokenType::EXIT},
@@ -64,25 +120,47 @@ class Lexer{
             {"uint", TokenType::UINT},
             {"char", TokenType::CHAR},
             {"float", TokenType::FLOAT},
+            {"i8", TokenType::I8},
+            {"i16", TokenType::I16},
+            {"i32", TokenType::INT},
+            {"i64", TokenType::I64},
+            {"u8", TokenType::U8},
+            {"u16", TokenType::U16},
+            {"u32", TokenType::UINT},
+            {"u64", TokenType::U64},
+            {"f32", TokenType::FLOAT},
+            {"f64", TokenType::F64},
             {"void", TokenType::VOID},
+            {"vec", TokenType::VEC},
+            {"atomic", TokenType::ATOMIC},
             {"fn", TokenType::FN},
+            {"struct", TokenType::STRUCT},
+            {"restrict", TokenType::RESTRICT},
             {"return", TokenType::RETURN},
             {"if", TokenType::IF},
             {"else", TokenType::ELSE},
+            {"while", TokenType::WHILE},
+            {"for", TokenType::FOR},
             {"+", TokenType::ADD},
             {"-", TokenType::SUB},
             {"/", TokenType::DIV},
             {"*", TokenType::MUL},
             {";", TokenType::SEMI},
+            {",", TokenType::COMMA},
             {"=", TokenType::EQUAL},
             {"(", TokenType::OPEN_PAREN},
             {")", TokenType::CLOSE_PAREN},
             {"{", TokenType::OPEN_BRACKET},
             {"}", TokenType::CLOSE_BRACKET},
+            {"[", TokenType::OPEN_SQUARE},
+            {"]", TokenType::CLOSE_SQUARE},
+            {".", TokenType::DOT},
+            {"&", TokenType::AMPERSAND},
         };
 
         std::optional<char> peek(int offset);
         char eat();
+        Token MakeToken(TokenType type, std::optional<std::string> value);
 
     public:
         Lexer(const std::string& code);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "options.hpp"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Target/TargetMachine.h"
+
+// runs LLVM's default optimization pipeline for an optimization level over a module
+class Optimizer{
+    private:
+        OptLevel m_level;
+
+        // the pass builder owns callbacks used by the analysis managers, so it has to outlive them
+        llvm::PassBuilder m_passBuilder;
+        llvm::LoopAnalysisManager m_loopAnalysis;
+        llvm::FunctionAnalysisManager m_functionAnalysis;
+        llvm::CGSCCAnalysisManager m_cgsccAnalysis;
+        llvm::ModuleAnalysisManager m_moduleAnalysis;
+        llvm::ModulePassManager m_passes;
+
+    public:
+        // the target machine is optional, it gives the vectorizers the cost model of the target
+        Optimizer(OptLevel level, llvm::TargetMachine* targetMachine = nullptr);
+
+        void Optimize(llvm::Module& module);
+};
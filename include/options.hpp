@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+
+enum class OptLevel{
+    O0,
+    O1,
+    O2,
+    O3,
+    Os
+};
+
+enum class OutputType{
+    IR,
+    Bitcode,
+    Object,
+    Assembly
+};
+
+enum class Mode{
+    // compile ahead of time to an output file
+    Compile,
+    // compile in process with the JIT and run main
+    Run
+};
+
+struct Options{
+    Mode mode = Mode::Compile;
+    std::string inputPath;
+    // empty means the default for the output type
+    std::string outputPath;
+    OptLevel optLevel = OptLevel::O0;
+    OutputType outputType = OutputType::IR;
+    std::string cpu = "generic";
+    // worker threads for code generation, this never changes the output
+    unsigned threads = 1;
+    // number of modules the program is split into. every unit is generated, optimized and
+    // emitted on its own, units > 1 write one output per unit
+    unsigned codegenUnits = 1;
+    // with --run, start every function in the bytecode interpreter and move hot ones to the JIT
+    bool tiered = false;
+    // calls or loop iterations after which a function is compiled by the JIT
+    unsigned tierThreshold = 1000;
+    // print the calls and tier of every function when the program exits
+    bool tierStats = false;
+    // with --run, keep running and hot swap the functions that change in the source file
+    bool watch = false;
+    // with --run, tell perf about JIT compiled code through a perf map and jitdump
+    bool perf = false;
+    // emit DWARF line tables
+    bool debugInfo = false;
+    // signed integer overflow traps instead of being undefined behavior
+    bool checkedArithmetic = false;
+    // every function is compiled with all fast-math flags, like @fastmath
+    bool fastMath = false;
+    // with -c, reuse the objects of unchanged functions from this directory
+    std::string cacheDir;
+    unsigned cacheSizeMiB = 512;
+    bool cacheStats = false;
+    // keep running and compile the requests of --client processes
+    bool serve = false;
+    // send the compilation to a running --serve process instead of compiling in process
+    bool client = false;
+    // unix domain socket of the compile server, empty means the default for the user
+    std::string socketPath;
+};
+
+// true when objects are compiled per function through the object cache
+bool UsesObjectCache(const Options& options);
+
+// parses the command line into options. prints an error and returns false on invalid input
+bool ParseOptions(int argc, char * argv[], Options& options);
+
+void PrintUsage();
+
+// the -o path, or the input path with the extension of the output type. empty for IR on stderr
+std::string GetOutputPath(const Options& options);
+
+// output path of one codegen unit. example: foo.o -> foo.2.o
+std::string GetUnitOutputPath(const std::string& path, unsigned index);
@@ -4,6 +4,7 @@
 #include <variant>
 #include <optional>
 #include <memory>
+#include <set>
 
 enum class BinOpType{
     ADD,
@@ -21,12 +22,18 @@ enum class ConditionalOpType{
     GREATER_OR_EQUAL
 };
 
+// val holds the digits without the suffix. literals without a suffix take the type of the
+// expression they are used in, the analyzer writes that type into type
 struct IntLitNode{
     Token val;
+    TokenType type = TokenType::INT;
+    bool hasSuffix = false;
 };
 
 struct FloatLitNode{
     Token val;
+    TokenType type = TokenType::FLOAT;
+    bool hasSuffix = false;
 };
 
 struct CharLitNode{
@@ -43,8 +50,52 @@ struct IdentNode{
 
 struct ExprNode;
 
+struct CallExprNode{
+    Token callee;
+    // explicit type arguments for generic functions. example: sum<int>()
+    std::vector<Token> typeArgs;
+    std::vector<std::unique_ptr<ExprNode>> args;
+};
+
+// shuffle, select, extract, insert and the reduce_ functions for vectors, len for arrays and
+// slices and load, store, fetch_add, fetch_sub and cas for atomics. their names are reserved,
+// calls to them are generated inline
+bool IsBuiltinFunction(const std::string& name);
+
+// explicit conversion between numeric types, written like a call of the type. example: u8(x).
+// converting a scalar to a vector type broadcasts it to every lane: vec<float, 8>(x)
+struct CastExprNode{
+    Token type;
+    std::unique_ptr<ExprNode> expression;
+};
+
+// an element of an array or slice: a[index]. the analyzer clears boundsCheck when it proves
+// that the index is in range or the access is in @unchecked code
+// fields selects a field of an element of an array of structs: a[index].pos.x
+struct IndexExprNode{
+    Token identifier;
+    std::unique_ptr<ExprNode> index;
+    bool boundsCheck = true;
+    std::vector<Token> fields;
+};
+
+// a field of a struct variable, nested structs are selected one field after the other: p.pos.x
+struct FieldExprNode{
+    Token identifier;
+    std::vector<Token> fields;
+};
+
+// the address of a variable, an element or a field: &x, &a[index], &p.pos or &a[index].pos.
+// index is null when no element is selected
+struct AddressOfExprNode{
+    Token identifier;
+    std::unique_ptr<ExprNode> index;
+    bool boundsCheck = true;
+    std::vector<Token> fields;
+};
+
 struct PrimaryExprNode{
-    std::variant<std::unique_ptr<IntLitNode>, std::unique_ptr<FloatLitNode>, std::unique_ptr<IdentNode>, std::unique_ptr<ExprNode>> var;
+    std::variant<std::unique_ptr<IntLitNode>, std::unique_ptr<FloatLitNode>, std::unique_ptr<IdentNode>, std::unique_ptr<ExprNode>, std::unique_ptr<CallExprNode>, std::unique_ptr<CastExprNode>, std::unique_ptr<IndexExprNode>, std::unique_ptr<FieldExprNode>, std::unique_ptr<AddressOfExprNode>> var;
 };
 
 struct BinOpExpr{
@@ -67,16 +118,40 @@ struct ExprNode{
 // forward decleration
 struct StmtNode;
 
+struct ParamNode{
+    Token type;
+    Token identifier;
+};
+
 struct ProtoTypeNode{
     Token name;
+    // type parameters of generic functions. example: fn<T> T sum()
+    std::vector<Token> typeParams;
     Token returnType;
-    int argCounter;
-    std::vector<std::unique_ptr<StmtNode>> args;
+    std::vector<ParamNode> params;
+};
+
+// @fastmath(reassoc, contract, arcp) on a function, the float operations in its body get
+// these LLVM fast-math flags. @fastmath without a list sets all of them
+struct FastMathAttribute{
+    bool reassoc = false;
+    bool contract = false;
+    bool arcp = false;
+    bool nnan = false;
+    bool ninf = false;
+    bool nsz = false;
+    bool afn = false;
 };
 
 struct FunctionNode{
     std::unique_ptr<ProtoTypeNode> prototype;
     std::vector<std::unique_ptr<StmtNode>> body;
+    FastMathAttribute fastMath;
+    // @unchecked, no array access in the body is bounds checked
+    bool unchecked = false;
+    // variables whose address the body takes. a write through a pointer can change them at any
+    // point, so the analyzer knows nothing about their range
+    std::set<std::string> addressTaken;
 };
 
 struct CompoundStmtNode{
@@ -87,11 +162,23 @@ struct DeclerationStmtNode{
     Token type;
     Token identifier;
     std::optional<std::unique_ptr<ExprNode>> expression;
+    // set by the analyzer when a global variable is assigned to inside a function
+    bool isWritten = false;
+    // set by the analyzer when the address of the variable is taken, it has to live in memory then
+    bool isAddressTaken = false;
 };
 
 struct AssignmentNode{
     Token identifier;
     std::unique_ptr<ExprNode> expression;
+    // set for assignments to an element: a[index] = expression. a[index] += expression keeps
+    // its operator in compoundType, so the element is only looked up once
+    std::unique_ptr<ExprNode> index;
+    std::optional<BinOpType> compoundType;
+    bool boundsCheck = true;
+    // set for assignments to a field: p.x = expression or a[index].x = expression. they keep
+    // their compoundType too
+    std::vector<Token> fields;
 };
 
 struct IfStmtNode{
@@ -100,16 +187,81 @@ struct IfStmtNode{
    std::vector<std::unique_ptr<StmtNode>> elseBody;
 };
 
+// annotations written in front of a loop, emitted as llvm.loop metadata. 0 means no hint
+struct LoopHints{
+    // @vectorize or @vectorize(width)
+    bool vectorize = false;
+    unsigned vectorizeWidth = 0;
+    // @unroll or @unroll(count)
+    bool unroll = false;
+    unsigned unrollCount = 0;
+    // @nounroll
+    bool noUnroll = false;
+    // @unchecked, no array access in the loop is bounds checked. not part of the metadata
+    bool unchecked = false;
+};
+
+struct WhileStmtNode{
+    std::unique_ptr<ExprNode> condition;
+    std::vector<std::unique_ptr<StmtNode>> body;
+    LoopHints hints;
+};
+
+// for(init; condition; step) { body }, every part of the header is optional
+struct ForStmtNode{
+    // a decleration or an assignment, scoped to the loop
+    std::unique_ptr<StmtNode> init;
+    std::unique_ptr<ExprNode> condition;
+    std::unique_ptr<AssignmentNode> step;
+    std::vector<std::unique_ptr<StmtNode>> body;
+    LoopHints hints;
+};
+
 struct ReturnNode{
-    std::optional<std::variant<std::unique_ptr<ExprNode>, std::unique_ptr<IdentNode>>> retval;
+    // null for return;
+    std::unique_ptr<ExprNode> value;
+};
+
+// an expression evaluated for its side effects. only calls are parsed as statements
+struct ExprStmtNode{
+    std::unique_ptr<ExprNode> expression;
 };
 
 struct StmtNode{
-    std::variant<std::unique_ptr<FunctionNode>, std::unique_ptr<AssignmentNode>, std::unique_ptr<IfStmtNode>, std::unique_ptr<DeclerationStmtNode>, std::unique_ptr<CompoundStmtNode>> var;
+    // position of the first token of the statement
+    unsigned line = 0;
+    unsigned column = 0;
+    std::variant<std::unique_ptr<FunctionNode>, std::unique_ptr<AssignmentNode>, std::unique_ptr<IfStmtNode>, std::unique_ptr<DeclerationStmtNode>, std::unique_ptr<CompoundStmtNode>, std::unique_ptr<WhileStmtNode>, std::unique_ptr<ForStmtNode>, std::unique_ptr<ReturnNode>, std::unique_ptr<ExprStmtNode>> var;
 };
 
 
+// annotations in front of a struct, they only change how it is laid out in memory
+struct StructLayout{
+    // @packed, no padding between the fields and the fields stay in the order they are declared in
+    bool packed = false;
+    // @align(n), the struct starts at a multiple of n bytes and its size is padded to one
+    unsigned align = 0;
+    // @cacheline_pad, every field gets a cache line of its own
+    bool cachelinePad = false;
+    // @soa, arrays of the struct are stored as one array per field
+    bool soa = false;
+};
+
+struct StructFieldNode{
+    Token type;
+    Token identifier;
+};
+
+// struct Name { TYPE field; ... }. a struct type is written as its name, which is an IDENT token
+struct StructNode{
+    Token name;
+    std::vector<StructFieldNode> fields;
+    StructLayout layout;
+};
+
 struct ProgNode{
+    // structs are only declared at the top level, before they are used
+    std::vector<std::unique_ptr<StructNode>> structs;
     std::vector<std::unique_ptr<StmtNode>> stmts;
 };
 
@@ -120,17 +272,35 @@ class Parser{
         std::vector<Token> m_tokens;
         int m_index = 0; 
 
+        // names of the structs declared so far, mapped to whether they are @soa
         std::unordered_map<std::string, bool> m_userTypes;
 
+        // type parameters of the generic function currently being parsed
+        std::vector<std::string> m_typeParams;
+        // variables the function currently being parsed takes the address of
+        std::set<std::string> m_addressTaken;
+
         std::optional<Token> peek(int offset);
         Token eat();
         void TryEat(TokenType token);
+        bool IsTypeToken(const Token& token);
 
     public:
 
         Parser(std::vector<Token> tokens) : m_tokens(tokens) {}
 
         std::unique_ptr<PrimaryExprNode> ParsePrimaryExpr();
+        std::unique_ptr<CallExprNode> ParseCallExpr();
+        // TYPE '(' expression ')'
+        std::unique_ptr<CastExprNode> ParseCastExpr();
+        std::vector<Token> ParseTypeList();
+        // a type token, or vec '<' TYPE ',' INT_LIT '>' which is returned as its element type with lanes set.
+        // either can be followed by '[' INT_LIT ']' for an array, '[' ']' for a slice or '*' for a
+        // pointer, which can be 'restrict'
+        Token ParseType();
+        Token ParseVectorType();
+        // atomic<T>, T is an integer type
+        Token ParseAtomicType();
         std::unique_ptr<ExprNode> ParseFactor();
         std::unique_ptr<ExprNode> ParseTerm();
         std::unique_ptr<ExprNode> ParseExpr();
@@ -139,9 +309,25 @@ class Parser{
         std::unique_ptr<ProtoTypeNode> ParseProto();
         std::unique_ptr<FunctionNode> ParseFunc();
         std::unique_ptr<CompoundStmtNode> ParseCompoundStmt();
-        std::unique_ptr<AssignmentNode> ParseAssignmentStmt();
+        // '=' or a compound assignment like '+=', which becomes x = x + (expr). the step of a
+        // for loop has no ';'
+        std::unique_ptr<AssignmentNode> ParseAssignmentStmt(bool semicolon = true);
         std::unique_ptr<IfStmtNode> ParseIfStmt();
+        // the annotations in front of a function or a loop. @fastmath goes into fastMath, the
+        // others into the returned hints
+        LoopHints ParseAnnotations(std::optional<FastMathAttribute>& fastMath);
+        // @fastmath or @fastmath(flag, ...) in front of a function
+        FastMathAttribute ParseFastMathAttribute();
+        std::unique_ptr<WhileStmtNode> ParseWhileStmt();
+        std::unique_ptr<ForStmtNode> ParseForStmt();
         std::unique_ptr<DeclerationStmtNode> ParseDecleration();
+        // '.' IDENTIFIER ('.' IDENTIFIER)* after a variable or an element
+        std::vector<Token> ParseFields();
+        // the annotations in front of a struct. example: @align(64) @cacheline_pad
+        StructLayout ParseStructLayout();
+        std::unique_ptr<StructNode> ParseStruct();
+        // whether the next tokens are a struct, possibly after its annotations
+        bool IsStructAhead();
         std::unique_ptr<StmtNode> ParseStmt();
         std::unique_ptr<ProgNode> Parse();
 };
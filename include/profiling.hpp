@@ -0,0 +1,31 @@
+#pragma once
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/Layer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// writes the symbols of JIT compiled code to /tmp/perf-<pid>.map. perf reads this map for
+// samples in memory that doesn't belong to a file
+class PerfMapListener : public llvm::JITEventListener{
+    private:
+        std::unique_ptr<llvm::raw_fd_ostream> m_file;
+        // objects can be loaded on any thread that compiles code
+        std::mutex m_mutex;
+
+    public:
+        PerfMapListener();
+
+        void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+};
+
+// the perf map listener, plus LLVM's jitdump listener when LLVM was built with perf support.
+// created on first use and shared by every JIT of the process
+const std::vector<llvm::JITEventListener*>& GetProfilingListeners();
+
+// a RuntimeDyld object layer that reports every object it loads to the profiling listeners.
+// JITLink layers don't support JIT event listeners, so JITs that are profiled always use this one
+std::unique_ptr<llvm::orc::ObjectLayer> CreateProfiledObjectLayer(llvm::orc::ExecutionSession& session);
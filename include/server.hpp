@@ -0,0 +1,55 @@
+#pragma once
+
+#include "compiler.hpp"
+#include "options.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one compile request sent by a client. paths in the arguments are relative to cwd, source is
+// only sent when the source file is '-' (stdin of the client)
+struct CompileRequest{
+    std::string cwd;
+    std::vector<std::string> args;
+    std::string source;
+};
+
+struct CompileResponse{
+    int status = 1;
+    uint64_t latencyMicros = 0;
+    // IR that the compilation would have printed to stderr, the client prints it instead
+    std::string output;
+    // errors and warnings of the compilation, and why the request failed. printed by the client
+    std::string error;
+};
+
+// $XDG_RUNTIME_DIR/xd.sock, or /tmp/xd-<uid>/xd.sock in a directory only the user can enter
+std::string GetDefaultSocketPath();
+
+// compiles requests sent over a unix domain socket with the target machines and optimization
+// pipelines of earlier requests. every connection is served on its own thread, so requests run
+// concurrently, and every request is a CompilerInstance of its own
+class CompileServer{
+    private:
+        std::string m_socketPath;
+        int m_socket = -1;
+        CompilerPool m_pool;
+        std::mutex m_logMutex;
+
+        void ServeConnection(int connection);
+        CompileResponse Compile(const CompileRequest& request);
+
+    public:
+        CompileServer(const Options& options);
+        ~CompileServer();
+
+        // false when the socket can't be bound, for example when another server is already listening on it
+        bool IsValid();
+
+        // accepts connections until the process is killed
+        int Run();
+};
+
+// sends the command line to the server at options.socketPath and prints its output. returns
+// the exit code of the remote compilation
+int RunClient(const Options& options, int argc, char * argv[]);
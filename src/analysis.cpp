@@ -1,60 +1,1475 @@
 #include "analysis.hpp"
+#include "diagnostics.hpp"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/Support/Error.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <set>
 
-void Analyzer::AnalyzePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+// searches the scopes from the innermost to the outermost (global) scope
+SymbolInfo* Analyzer::LookupSymbol(const std::string& name){
+  for(auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++){
+    auto symbol = scope->find(name);
+
+    if(symbol != scope->end()){
+      return &symbol->second;
+    }
+  }
+
+  return nullptr;
+}
+
+// global initializers are evaluated at compile time, so they may only use literals,
+// other globals and operators on those
+bool Analyzer::IsConstantExpr(const std::unique_ptr<ExprNode>& expr){
+  struct ConstantExprVisitor{
+    Analyzer& self;
+
+    bool operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+      if(std::holds_alternative<std::unique_ptr<ExprNode>>(primaryExpr->var)){
+        return self.IsConstantExpr(std::get<std::unique_ptr<ExprNode>>(primaryExpr->var));
+      }
+
+      if(std::holds_alternative<std::unique_ptr<IdentNode>>(primaryExpr->var)){
+        auto& ident = std::get<std::unique_ptr<IdentNode>>(primaryExpr->var);
+        return self.m_scopes.front().contains(ident->val.value.value());
+      }
+
+      if(std::holds_alternative<std::unique_ptr<CallExprNode>>(primaryExpr->var) || std::holds_alternative<std::unique_ptr<IndexExprNode>>(primaryExpr->var)
+        || std::holds_alternative<std::unique_ptr<FieldExprNode>>(primaryExpr->var) || std::holds_alternative<std::unique_ptr<AddressOfExprNode>>(primaryExpr->var)){
+        return false;
+      }
+
+      if(std::holds_alternative<std::unique_ptr<CastExprNode>>(primaryExpr->var)){
+        return self.IsConstantExpr(std::get<std::unique_ptr<CastExprNode>>(primaryExpr->var)->expression);
+      }
+
+      return true;
+    }
+
+    bool operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+      return self.IsConstantExpr(binExpr->lhs) && self.IsConstantExpr(binExpr->rhs);
+    }
+
+    bool operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
+      return self.IsConstantExpr(conditionalExpr->lhs) && self.IsConstantExpr(conditionalExpr->rhs);
+    }
+  };
+
+  return std::visit(ConstantExprVisitor{*this}, expr->var);
+}
+
+// type parameters are replaced by the type they are bound to, every other token is copied
+Token Analyzer::CloneType(const Token& type, const TypeBindings& bindings){
+  Token clone = type;
+
+  if(type.type == TokenType::IDENT && bindings.contains(type.value.value())){
+    clone.type = bindings.at(type.value.value());
+    clone.value = std::nullopt;
+  }
+
+  return clone;
+}
+
+std::unique_ptr<PrimaryExprNode> Analyzer::ClonePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr, const TypeBindings& bindings){
+  struct PrimaryExprCloner{
+    Analyzer& self;
+    const TypeBindings& bindings;
+    std::unique_ptr<PrimaryExprNode> clone = std::make_unique<PrimaryExprNode>();
+
+    void operator()(const std::unique_ptr<IntLitNode>& intLit){
+      clone->var = std::make_unique<IntLitNode>(*intLit);
+    }
+
+    void operator()(const std::unique_ptr<FloatLitNode>& floatLit){
+      clone->var = std::make_unique<FloatLitNode>(*floatLit);
+    }
+
+    void operator()(const std::unique_ptr<IdentNode>& ident){
+      clone->var = std::make_unique<IdentNode>(*ident);
+    }
+
+    void operator()(const std::unique_ptr<ExprNode>& expr){
+      clone->var = self.CloneExpr(expr, bindings);
+    }
+
+    void operator()(const std::unique_ptr<CallExprNode>& call){
+      auto callClone = std::make_unique<CallExprNode>();
+      callClone->callee = call->callee;
+
+      for(const auto& typeArg : call->typeArgs){
+        callClone->typeArgs.push_back(self.CloneType(typeArg, bindings));
+      }
+
+      for(const auto& arg : call->args){
+        callClone->args.push_back(self.CloneExpr(arg, bindings));
+      }
+
+      clone->var = std::move(callClone);
+    }
+
+    void operator()(const std::unique_ptr<CastExprNode>& cast){
+      auto castClone = std::make_unique<CastExprNode>();
+      castClone->type = self.CloneType(cast->type, bindings);
+      castClone->expression = self.CloneExpr(cast->expression, bindings);
+      clone->var = std::move(castClone);
+    }
+
+    void operator()(const std::unique_ptr<IndexExprNode>& index){
+      auto indexClone = std::make_unique<IndexExprNode>();
+      indexClone->identifier = index->identifier;
+      indexClone->index = self.CloneExpr(index->index, bindings);
+      indexClone->fields = index->fields;
+      clone->var = std::move(indexClone);
+    }
+
+    void operator()(const std::unique_ptr<FieldExprNode>& field){
+      clone->var = std::make_unique<FieldExprNode>(*field);
+    }
+
+    void operator()(const std::unique_ptr<AddressOfExprNode>& addressOf){
+      auto addressOfClone = std::make_unique<AddressOfExprNode>();
+      addressOfClone->identifier = addressOf->identifier;
+      addressOfClone->index = addressOf->index ? self.CloneExpr(addressOf->index, bindings) : nullptr;
+      addressOfClone->fields = addressOf->fields;
+      clone->var = std::move(addressOfClone);
+    }
+  };
+
+  PrimaryExprCloner cloner = {*this, bindings};
+  std::visit(cloner, primaryExpr->var);
+  return std::move(cloner.clone);
+}
+
+std::unique_ptr<ExprNode> Analyzer::CloneExpr(const std::unique_ptr<ExprNode>& expr, const TypeBindings& bindings){
+  struct ExprCloner{
+    Analyzer& self;
+    const TypeBindings& bindings;
+    std::unique_ptr<ExprNode> clone = std::make_unique<ExprNode>();
+
+    void operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+      clone->var = self.ClonePrimaryExpr(primaryExpr, bindings);
+    }
+
+    void operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+      auto binClone = std::make_unique<BinOpExpr>();
+      binClone->type = binExpr->type;
+      binClone->lhs = self.CloneExpr(binExpr->lhs, bindings);
+      binClone->rhs = self.CloneExpr(binExpr->rhs, bindings);
+      clone->var = std::move(binClone);
+    }
+
+    void operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
+      auto conditionalClone = std::make_unique<ConditionalOpExpr>();
+      conditionalClone->type = conditionalExpr->type;
+      conditionalClone->lhs = self.CloneExpr(conditionalExpr->lhs, bindings);
+      conditionalClone->rhs = self.CloneExpr(conditionalExpr->rhs, bindings);
+      clone->var = std::move(conditionalClone);
+    }
+  };
+
+  ExprCloner cloner = {*this, bindings};
+  std::visit(cloner, expr->var);
+  return std::move(cloner.clone);
+}
+
+std::unique_ptr<FunctionNode> Analyzer::CloneFunction(const FunctionNode* function, const TypeBindings& bindings){
+  auto prototype = std::make_unique<ProtoTypeNode>();
+  prototype->name = function->prototype->name;
+  prototype->typeParams = function->prototype->typeParams;
+  prototype->returnType = CloneType(function->prototype->returnType, bindings);
+
+  for(const auto& param : function->prototype->params){
+    prototype->params.push_back({CloneType(param.type, bindings), param.identifier});
+  }
+
+  auto functionClone = std::make_unique<FunctionNode>();
+  functionClone->prototype = std::move(prototype);
+  functionClone->fastMath = function->fastMath;
+  functionClone->unchecked = function->unchecked;
+  functionClone->addressTaken = function->addressTaken;
+
+  for(const auto& stmt : function->body){
+    functionClone->body.push_back(CloneStmt(stmt, bindings));
+  }
+
+  return functionClone;
+}
+
+std::unique_ptr<StmtNode> Analyzer::CloneStmt(const std::unique_ptr<StmtNode>& stmt, const TypeBindings& bindings){
+  struct StmtCloner{
+    Analyzer& self;
+    const TypeBindings& bindings;
+    std::unique_ptr<StmtNode> clone = std::make_unique<StmtNode>();
+
+    void operator()(const std::unique_ptr<CompoundStmtNode>& compoundStmt){
+      auto compoundClone = std::make_unique<CompoundStmtNode>();
+
+      for(const auto& stmt : compoundStmt->body){
+        compoundClone->body.push_back(self.CloneStmt(stmt, bindings));
+      }
+
+      clone->var = std::move(compoundClone);
+    }
+
+    std::unique_ptr<AssignmentNode> CloneAssignment(const std::unique_ptr<AssignmentNode>& assignment){
+      auto assignmentClone = std::make_unique<AssignmentNode>();
+      assignmentClone->identifier = assignment->identifier;
+      assignmentClone->expression = self.CloneExpr(assignment->expression, bindings);
+      assignmentClone->compoundType = assignment->compoundType;
+      assignmentClone->fields = assignment->fields;
+
+      if(assignment->index){
+        assignmentClone->index = self.CloneExpr(assignment->index, bindings);
+      }
+
+      return assignmentClone;
+    }
+
+    void operator()(const std::unique_ptr<AssignmentNode>& assignment){
+      clone->var = CloneAssignment(assignment);
+    }
+
+    void operator()(const std::unique_ptr<IfStmtNode>& ifStmt){
+      auto ifClone = std::make_unique<IfStmtNode>();
+      ifClone->condition = self.CloneExpr(ifStmt->condition, bindings);
+
+      for(const auto& stmt : ifStmt->thenBody){
+        ifClone->thenBody.push_back(self.CloneStmt(stmt, bindings));
+      }
+
+      for(const auto& stmt : ifStmt->elseBody){
+        ifClone->elseBody.push_back(self.CloneStmt(stmt, bindings));
+      }
+
+      clone->var = std::move(ifClone);
+    }
+
+    void operator()(const std::unique_ptr<WhileStmtNode>& whileStmt){
+      auto whileClone = std::make_unique<WhileStmtNode>();
+      whileClone->condition = self.CloneExpr(whileStmt->condition, bindings);
+      whileClone->hints = whileStmt->hints;
+
+      for(const auto& stmt : whileStmt->body){
+        whileClone->body.push_back(self.CloneStmt(stmt, bindings));
+      }
+
+      clone->var = std::move(whileClone);
+    }
+
+    void operator()(const std::unique_ptr<ForStmtNode>& forStmt){
+      auto forClone = std::make_unique<ForStmtNode>();
+      forClone->hints = forStmt->hints;
+
+      if(forStmt->init){
+        forClone->init = self.CloneStmt(forStmt->init, bindings);
+      }
+
+      if(forStmt->condition){
+        forClone->condition = self.CloneExpr(forStmt->condition, bindings);
+      }
+
+      if(forStmt->step){
+        forClone->step = CloneAssignment(forStmt->step);
+      }
+
+      for(const auto& stmt : forStmt->body){
+        forClone->body.push_back(self.CloneStmt(stmt, bindings));
+      }
+
+      clone->var = std::move(forClone);
+    }
+
+    void operator()(const std::unique_ptr<ReturnNode>& returnStmt){
+      auto returnClone = std::make_unique<ReturnNode>();
+
+      if(returnStmt->value){
+        returnClone->value = self.CloneExpr(returnStmt->value, bindings);
+      }
+
+      clone->var = std::move(returnClone);
+    }
+
+    void operator()(const std::unique_ptr<ExprStmtNode>& exprStmt){
+      auto exprClone = std::make_unique<ExprStmtNode>();
+      exprClone->expression = self.CloneExpr(exprStmt->expression, bindings);
+      clone->var = std::move(exprClone);
+    }
+
+    void operator()(const std::unique_ptr<FunctionNode>& function){
+      clone->var = self.CloneFunction(function.get(), bindings);
+    }
+
+    void operator()(const std::unique_ptr<DeclerationStmtNode>& decleration){
+      auto declerationClone = std::make_unique<DeclerationStmtNode>();
+      declerationClone->type = self.CloneType(decleration->type, bindings);
+      declerationClone->identifier = decleration->identifier;
+
+      if(decleration->expression.has_value()){
+        declerationClone->expression = self.CloneExpr(decleration->expression.value(), bindings);
+      }
+
+      clone->var = std::move(declerationClone);
+    }
+  };
+
+  StmtCloner cloner = {*this, bindings};
+  std::visit(cloner, stmt->var);
+  cloner.clone->line = stmt->line;
+  cloner.clone->column = stmt->column;
+  return std::move(cloner.clone);
+}
+
+// monomorphizes a generic function for the given type arguments. every instantiation is created
+// once and shared by all of its call sites, it is analyzed later like any other function
+std::string Analyzer::Instantiate(FunctionNode* generic, const std::vector<TokenType>& typeArgs){
+  auto key = std::make_pair(static_cast<const FunctionNode*>(generic), typeArgs);
+
+  if(m_instantiations.find(key) != m_instantiations.end()){
+    return m_instantiations.at(key);
+  }
+
+  std::string name = generic->prototype->name.value.value() + "<";
+  TypeBindings bindings;
+
+  for(size_t i = 0; i < typeArgs.size(); i++){
+    bindings[generic->prototype->typeParams.at(i).value.value()] = typeArgs.at(i);
+    name += (i > 0 ? "," : "") + GetTypeName(typeArgs.at(i));
+  }
+
+  name += ">";
+  m_instantiations[key] = name;
+
+  auto function = CloneFunction(generic, bindings);
+  function->prototype->name.value = name;
+  function->prototype->typeParams.clear();
+
+  // calls are checked against the prototype of the instantiation
+  m_functions[name] = function.get();
+
+  auto instance = std::make_unique<StmtNode>();
+  instance->var = std::move(function);
+
+  m_instances.push_back(std::move(instance));
+
+  return name;
+}
+
+// unsigned values widen to unsigned or larger signed types, signed values to larger signed
+// types and floats to larger floats. everything else needs an explicit conversion
+static ExprType TypeOf(const Token& type){
+  std::string structName = type.type == TokenType::IDENT ? type.value.value() : "";
+  return {type.type, false, false, type.lanes, type.arrayLength, type.isSlice, structName, type.isPointer, type.isAtomic};
+}
+
+static bool IsAggregate(const ExprType& type){
+  return type.arrayLength != 0 || type.isSlice;
+}
+
+// a single struct, not an array or slice of them or a pointer to one
+static bool IsStruct(const ExprType& type){
+  return type.structName.empty() == false && IsAggregate(type) == false && type.isPointer == false;
+}
+
+static std::string TypeName(const ExprType& type){
+  std::string name = type.structName.empty() == false ? type.structName
+    : type.lanes != 0 ? "vec<" + GetTypeName(type.type) + ", " + std::to_string(type.lanes) + ">" : GetTypeName(type.type);
+
+  if(type.isAtomic){
+    name = "atomic<" + name + ">";
+  }
+
+  if(type.isSlice){
+    return name + "[]";
+  }
+
+  if(type.isPointer){
+    return name + "*";
+  }
+
+  return type.arrayLength != 0 ? name + "[" + std::to_string(type.arrayLength) + "]" : name;
+}
+
+// whether the expression is a call of len
+static bool IsLengthCall(const std::unique_ptr<ExprNode>& expr){
+  if(std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(expr->var) == false){
+    return false;
+  }
+
+  const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(expr->var);
+
+  return std::holds_alternative<std::unique_ptr<CallExprNode>>(primaryExpr->var)
+    && std::get<std::unique_ptr<CallExprNode>>(primaryExpr->var)->callee.value.value() == "len";
+}
+
+// name of the variable when the expression is nothing but a variable
+static std::optional<std::string> GetIdentifier(const std::unique_ptr<ExprNode>& expr){
+  if(std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(expr->var) == false){
+    return std::nullopt;
+  }
+
+  const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(expr->var);
+
+  if(std::holds_alternative<std::unique_ptr<IdentNode>>(primaryExpr->var) == false){
+    return std::nullopt;
+  }
+
+  return std::get<std::unique_ptr<IdentNode>>(primaryExpr->var)->val.value.value();
+}
+
+// value of an integer literal, nullopt for every other expression
+static std::optional<uint64_t> GetIntLiteral(const std::unique_ptr<ExprNode>& expr){
+  if(std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(expr->var) == false){
+    return std::nullopt;
+  }
+
+  const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(expr->var);
+
+  if(std::holds_alternative<std::unique_ptr<IntLitNode>>(primaryExpr->var) == false){
+    return std::nullopt;
+  }
+
+  const std::string& digits = std::get<std::unique_ptr<IntLitNode>>(primaryExpr->var)->val.value.value();
+  uint64_t value = 0;
+  auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+
+  return error == std::errc() ? std::optional<uint64_t>(value) : std::nullopt;
+}
+
+static bool IsWidening(TokenType from, TokenType to){
+  if(GetTypeBits(to) <= GetTypeBits(from)){
+    return false;
+  }
+
+  if(IsFloatType(from) || IsFloatType(to)){
+    return IsFloatType(from) && IsFloatType(to);
+  }
+
+  return IsUnsignedType(from) || IsUnsignedType(to) == false;
+}
+
+static bool LiteralFits(const std::string& digits, TokenType type){
+  // a float literal fits unless it rounds to infinity, literals that underflow become 0
+  if(IsFloatType(type)){
+    llvm::APFloat value(type == TokenType::F64 ? llvm::APFloat::IEEEdouble() : llvm::APFloat::IEEEsingle());
+    auto status = value.convertFromString(digits, llvm::APFloat::rmNearestTiesToEven);
+
+    if(!status){
+      llvm::consumeError(status.takeError());
+      return false;
+    }
+
+    return value.isInfinity() == false;
+  }
+
+  unsigned long long value = 0;
+  auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+
+  if(error != std::errc()){
+    return false;
+  }
+
+  unsigned bits = GetTypeBits(type) - (IsUnsignedType(type) ? 0 : 1);
+  return bits >= 64 || value <= (1ull << bits) - 1;
+}
+
+// whether every integer literal without a suffix in the expression fits in the type
+static bool LiteralsFit(const std::unique_ptr<ExprNode>& expr, TokenType type){
+  struct FitChecker{
+    TokenType type;
+
+    bool operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+      if(std::holds_alternative<std::unique_ptr<IntLitNode>>(primaryExpr->var)){
+        const auto& intLit = std::get<std::unique_ptr<IntLitNode>>(primaryExpr->var);
+        return intLit->hasSuffix || LiteralFits(intLit->val.value.value(), type);
+      }
+
+      if(std::holds_alternative<std::unique_ptr<ExprNode>>(primaryExpr->var)){
+        return LiteralsFit(std::get<std::unique_ptr<ExprNode>>(primaryExpr->var), type);
+      }
+
+      return true;
+    }
+
+    bool operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+      return LiteralsFit(binExpr->lhs, type) && LiteralsFit(binExpr->rhs, type);
+    }
+
+    bool operator()(const std::unique_ptr<ConditionalOpExpr>&){
+      return true;
+    }
+  };
+
+  return std::visit(FitChecker{type}, expr->var);
+}
+
+void Analyzer::ResolveLiterals(const std::unique_ptr<ExprNode>& expr, TokenType type){
+  struct LiteralResolver{
+    Analyzer& self;
+    TokenType type;
+
+    void operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+      if(std::holds_alternative<std::unique_ptr<IntLitNode>>(primaryExpr->var)){
+        auto& intLit = std::get<std::unique_ptr<IntLitNode>>(primaryExpr->var);
+
+        if(intLit->hasSuffix == false){
+          if(LiteralFits(intLit->val.value.value(), type) == false){
+            self.m_errors.push_back("error: literal " + intLit->val.value.value() + " doesn't fit in " + GetTypeName(type) + "\n");
+          }
+
+          intLit->type = type;
+        }
+      }
+      else if(std::holds_alternative<std::unique_ptr<FloatLitNode>>(primaryExpr->var)){
+        auto& floatLit = std::get<std::unique_ptr<FloatLitNode>>(primaryExpr->var);
+
+        if(floatLit->hasSuffix == false && IsFloatType(type)){
+          if(LiteralFits(floatLit->val.value.value(), type) == false){
+            self.m_errors.push_back("error: literal " + floatLit->val.value.value() + " doesn't fit in " + GetTypeName(type) + "\n");
+          }
+
+          floatLit->type = type;
+        }
+      }
+      else if(std::holds_alternative<std::unique_ptr<ExprNode>>(primaryExpr->var)){
+        self.ResolveLiterals(std::get<std::unique_ptr<ExprNode>>(primaryExpr->var), type);
+      }
+    }
+
+    void operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+      self.ResolveLiterals(binExpr->lhs, type);
+      self.ResolveLiterals(binExpr->rhs, type);
+    }
+
+    // the operands of comparisons are resolved when the comparison is analyzed
+    void operator()(const std::unique_ptr<ConditionalOpExpr>&){}
+  };
+
+  std::visit(LiteralResolver{*this, type}, expr->var);
+}
+
+void Analyzer::ResolveDefault(const std::unique_ptr<ExprNode>& expr, const ExprType& type){
+  if(type.literal){
+    ResolveLiterals(expr, type.type);
+  }
+}
+
+void Analyzer::CheckConversion(const std::unique_ptr<ExprNode>& expr, const ExprType& type, const ExprType& targetType, const std::string& where){
+  TokenType target = targetType.type;
+
+  if(type.error || (IsNumericType(target) == false && targetType.structName.empty())){
+    return;
+  }
+
+  if(type.type == TokenType::VOID){
+    m_errors.push_back("error: void value used as " + where + "\n");
+    return;
+  }
+
+  // a pointer only converts to a pointer to the same type
+  if(type.isPointer || targetType.isPointer){
+    bool sameTarget = type.type == target && type.lanes == targetType.lanes && type.structName == targetType.structName && type.isAtomic == targetType.isAtomic;
+
+    if(type.isPointer != targetType.isPointer || sameTarget == false){
+      m_errors.push_back("error: can't convert " + TypeName(type) + " to " + TypeName(targetType) + " in " + where + "\n");
+    }
+    return;
+  }
+
+  // an array becomes a slice of all of its elements, nothing else converts to or from them
+  if(IsAggregate(type) || IsAggregate(targetType)){
+    bool sameElements = type.type == target && type.lanes == targetType.lanes && type.structName == targetType.structName && type.isAtomic == targetType.isAtomic;
+
+    if(targetType.isSlice == false || IsAggregate(type) == false || sameElements == false){
+      m_errors.push_back("error: can't convert " + TypeName(type) + " to " + TypeName(targetType) + " in " + where + "\n");
+    }
+    return;
+  }
+
+  // a struct only converts to itself
+  if(IsStruct(type) || IsStruct(targetType)){
+    if(type.structName != targetType.structName){
+      m_errors.push_back("error: can't convert " + TypeName(type) + " to " + TypeName(targetType) + " in " + where + "\n");
+    }
+    return;
+  }
+
+  // a vector only converts to its own type implicitly, a scalar converts to a vector by
+  // being broadcast to every lane
+  if(type.lanes != 0){
+    if(type.lanes != targetType.lanes || type.type != target){
+      m_errors.push_back("error: can't convert " + TypeName(type) + " to " + TypeName(targetType) + " implicitly in " + where
+        + (type.lanes == targetType.lanes ? ", use " + TypeName(targetType) + "(...)\n" : "\n"));
+    }
+    return;
+  }
+
+  if(type.literal){
+    if(IsFloatType(type.type) && IsFloatType(target) == false){
+      m_errors.push_back("error: float literal can't be converted to " + GetTypeName(target) + " implicitly in " + where + "\n");
+      return;
+    }
+
+    ResolveLiterals(expr, target);
+    return;
+  }
+
+  // integers stored into floats are converted implicitly
+  if(type.type == target || IsWidening(type.type, target) || (IsFloatType(type.type) == false && IsFloatType(target))){
+    return;
+  }
+
+  m_errors.push_back("error: can't convert " + GetTypeName(type.type) + " to " + GetTypeName(target) + " implicitly in " + where
+    + ", use " + GetTypeName(target) + "(...)\n");
+}
+
+ExprType Analyzer::UnifyOperands(const std::unique_ptr<ExprNode>& lhs, const ExprType& lhsType, const std::unique_ptr<ExprNode>& rhs, const ExprType& rhsType){
+  if(lhsType.error || rhsType.error){
+    return {TokenType::VOID, false, true};
+  }
+
+  if(lhsType.type == TokenType::VOID || rhsType.type == TokenType::VOID){
+    m_errors.push_back("error: void value used in an expression\n");
+    return {TokenType::VOID, false, true};
+  }
+
+  if(IsAggregate(lhsType) || IsAggregate(rhsType)){
+    m_errors.push_back("error: " + TypeName(IsAggregate(lhsType) ? lhsType : rhsType) + " used in an expression, index it to use its elements\n");
+    return {TokenType::VOID, false, true};
+  }
+
+  if(IsStruct(lhsType) || IsStruct(rhsType)){
+    m_errors.push_back("error: struct " + TypeName(IsStruct(lhsType) ? lhsType : rhsType) + " used in an expression, use its fields\n");
+    return {TokenType::VOID, false, true};
+  }
+
+  // there is no pointer arithmetic, &p[i] is the pointer i elements further
+  if(lhsType.isPointer || rhsType.isPointer){
+    m_errors.push_back("error: pointer " + TypeName(lhsType.isPointer ? lhsType : rhsType) + " used in an expression, index it to use what it points to\n");
+    return {TokenType::VOID, false, true};
+  }
+
+  // lane-wise operation, a scalar operand is broadcast to every lane
+  if(lhsType.lanes != 0 || rhsType.lanes != 0){
+    if(lhsType.lanes != 0 && rhsType.lanes != 0){
+      if(lhsType.lanes != rhsType.lanes || lhsType.type != rhsType.type){
+        m_errors.push_back("error: operands of type " + TypeName(lhsType) + " and " + TypeName(rhsType) + " need an explicit conversion\n");
+        return {lhsType.type, false, true, lhsType.lanes};
+      }
+      return lhsType;
+    }
+
+    bool isLeftVector = lhsType.lanes != 0;
+    const ExprType& vector = isLeftVector ? lhsType : rhsType;
+
+    CheckConversion(isLeftVector ? rhs : lhs, isLeftVector ? rhsType : lhsType, {vector.type}, "the scalar operand of a " + TypeName(vector) + " operation");
+    return vector;
+  }
+
+  // a length is never negative and fits in 31 bits, so like a literal it takes the type of an
+  // integer operand it fits in. i < len(a) works for uint and u64 indices too
+  if(IsLengthCall(lhs) != IsLengthCall(rhs)){
+    const ExprType& other = IsLengthCall(lhs) ? rhsType : lhsType;
+
+    if(other.literal == false && IsFloatType(other.type) == false && GetTypeBits(other.type) >= 32){
+      return other;
+    }
+  }
+
+  if(lhsType.literal && rhsType.literal){
+    bool isFloat = IsFloatType(lhsType.type) || IsFloatType(rhsType.type);
+    return {isFloat ? TokenType::FLOAT : TokenType::INT, true};
+  }
+
+  // a literal takes the type of the other operand
+  if(lhsType.literal || rhsType.literal){
+    const ExprType& literal = lhsType.literal ? lhsType : rhsType;
+    const ExprType& typed = lhsType.literal ? rhsType : lhsType;
+
+    if(IsFloatType(literal.type) && IsFloatType(typed.type) == false){
+      m_errors.push_back("error: float literal used with an operand of type " + GetTypeName(typed.type) + "\n");
+      return {typed.type, false, true};
+    }
+
+    ResolveLiterals(lhsType.literal ? lhs : rhs, typed.type);
+    return typed;
+  }
+
+  if(lhsType.type == rhsType.type || IsWidening(rhsType.type, lhsType.type)){
+    return lhsType;
+  }
+
+  if(IsWidening(lhsType.type, rhsType.type)){
+    return rhsType;
+  }
+
+  m_errors.push_back("error: operands of type " + TypeName(lhsType) + " and " + TypeName(rhsType) + " need an explicit conversion\n");
+  return {lhsType.type, false, true};
+}
+
+ExprType Analyzer::AnalyzeBuiltin(const std::unique_ptr<CallExprNode>& call){
+  std::string name = call->callee.value.value();
+  std::vector<ExprType> args;
+
+  if(name == "load" || name == "store" || name == "fetch_add" || name == "fetch_sub" || name == "cas"){
+    return AnalyzeAtomic(call);
+  }
+
+  for(const auto& arg : call->args){
+    args.push_back(AnalyzeExpr(arg));
+
+    if(args.back().error){
+      return args.back();
+    }
+  }
+
+  auto error = [&](const std::string& message){
+    m_errors.push_back("error: " + message + "\n");
+    return ExprType{TokenType::VOID, false, true};
+  };
+
+  if(name == "len"){
+    if(args.size() != 1 || IsAggregate(args[0]) == false || GetIdentifier(call->args[0]).has_value() == false){
+      return error("len expects an array or a slice");
+    }
+
+    return {TokenType::INT};
+  }
+
+  for(const ExprType& arg : args){
+    if(IsAggregate(arg)){
+      return error(name + " was given " + TypeName(arg) + ", index it to use its elements");
+    }
+
+    if(IsStruct(arg)){
+      return error(name + " was given struct " + TypeName(arg) + ", use its fields");
+    }
+
+    if(arg.isPointer){
+      return error(name + " was given pointer " + TypeName(arg) + ", index it to use what it points to");
+    }
+  }
+
+  size_t expected = name.starts_with("reduce_") ? 1 : name == "extract" ? 2 : name == "shuffle" ? 0 : 3;
+
+  if(expected != 0 && args.size() != expected){
+    return error(name + " expects " + std::to_string(expected) + " arguments but was given " + std::to_string(args.size()));
+  }
+
+  // every builtin takes a vector first, select takes its mask
+  if(args.empty() || args[0].lanes == 0){
+    return error(name + " expects a vector as its first argument");
+  }
+
+  const ExprType& vector = args[0];
+
+  // lane indices are integers, constant ones have to be in range
+  auto checkIndex = [&](size_t arg, unsigned lanes){
+    if(args[arg].lanes != 0 || IsFloatType(args[arg].type) || args[arg].type == TokenType::VOID){
+      error("lane index of " + name + " has to be an integer");
+      return;
+    }
+
+    ResolveDefault(call->args[arg], args[arg]);
+    std::optional<uint64_t> index = GetIntLiteral(call->args[arg]);
+
+    if(index.has_value() && index.value() >= lanes){
+      error("lane " + std::to_string(index.value()) + " is out of range in " + name);
+    }
+  };
+
+  if(name.starts_with("reduce_")){
+    return {vector.type};
+  }
+
+  if(name == "extract"){
+    checkIndex(1, vector.lanes);
+    return {vector.type};
+  }
+
+  if(name == "insert"){
+    checkIndex(1, vector.lanes);
+    CheckConversion(call->args[2], args[2], {vector.type}, "the value inserted by insert");
+    return vector;
+  }
+
+  if(name == "select"){
+    if(IsFloatType(vector.type)){
+      return error("the mask of select has to be an integer vector like the result of a comparison");
+    }
+
+    ExprType result = UnifyOperands(call->args[1], args[1], call->args[2], args[2]);
+
+    if(result.error == false && result.lanes != vector.lanes){
+      return error("select expects two vectors with as many lanes as its mask");
+    }
+
+    return result;
+  }
+
+  // shuffle(a, b, lanes...) picks lanes of a and b, a's are numbered first
+  if(args.size() < 3 || args.size() - 2 > 1024){
+    return error("shuffle expects two vectors and between 1 and 1024 lane indices");
+  }
+
+  if(args[1].lanes != vector.lanes || args[1].type != vector.type){
+    return error("shuffle expects two vectors of the same type, it was given " + TypeName(vector) + " and " + TypeName(args[1]));
+  }
+
+  for(size_t i = 2; i < args.size(); i++){
+    if(GetIntLiteral(call->args[i]).has_value() == false){
+      return error("the lane indices of shuffle have to be integer literals");
+    }
+
+    checkIndex(i, vector.lanes * 2);
+  }
+
+  return {vector.type, false, false, unsigned(args.size() - 2)};
+}
+
+bool Analyzer::IsAtomicValue(const ExprType& type){
+  if(IsAggregate(type) || type.isPointer){
+    return false;
+  }
+
+  if(type.isAtomic){
+    return true;
+  }
+
+  if(IsStruct(type) == false || m_structs.contains(type.structName) == false){
+    return false;
+  }
+
+  const auto& fields = m_structs.at(type.structName)->fields;
+  return std::any_of(fields.begin(), fields.end(), [&](const StructFieldNode& field){ return IsAtomicValue(TypeOf(field.type)); });
+}
+
+// load(a, order), store(a, value, order), fetch_add(a, value, order), fetch_sub(a, value, order)
+// and cas(a, expected, desired, order). a names an atomic variable, element or field, it is never
+// read like a value. order is one of relaxed, acquire, release, acq_rel and seq_cst
+ExprType Analyzer::AnalyzeAtomic(const std::unique_ptr<CallExprNode>& call){
+  std::string name = call->callee.value.value();
+
+  auto error = [&](const std::string& message){
+    m_errors.push_back("error: " + message + "\n");
+    return ExprType{TokenType::VOID, false, true};
+  };
+
+  size_t expected = name == "load" ? 2 : name == "cas" ? 4 : 3;
+
+  if(call->args.size() != expected){
+    return error(name + " expects " + std::to_string(expected) + " arguments but was given " + std::to_string(call->args.size()));
+  }
+
+  ExprType atomic = {TokenType::VOID, false, true};
+  const auto& place = call->args.front();
+
+  if(std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(place->var)){
+    const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(place->var);
+
+    if(std::holds_alternative<std::unique_ptr<IndexExprNode>>(primaryExpr->var)){
+      const auto& index = std::get<std::unique_ptr<IndexExprNode>>(primaryExpr->var);
+      atomic = AnalyzeFields(AnalyzeIndex(index->identifier, index->index, index->boundsCheck), index->fields, index->identifier.value.value() + "[]");
+    }
+    else if(std::holds_alternative<std::unique_ptr<IdentNode>>(primaryExpr->var) || std::holds_alternative<std::unique_ptr<FieldExprNode>>(primaryExpr->var)){
+      bool isField = std::holds_alternative<std::unique_ptr<FieldExprNode>>(primaryExpr->var);
+      std::string variableName = isField ? std::get<std::unique_ptr<FieldExprNode>>(primaryExpr->var)->identifier.value.value()
+        : std::get<std::unique_ptr<IdentNode>>(primaryExpr->var)->val.value.value();
+      SymbolInfo* symbol = LookupSymbol(variableName);
+
+      if(symbol == nullptr){
+        return error("variable '" + variableName + "' was not declared in this scope");
+      }
+
+      atomic = isField ? AnalyzeFields(symbol->type, std::get<std::unique_ptr<FieldExprNode>>(primaryExpr->var)->fields, variableName) : symbol->type;
+    }
+    else{
+      return error(name + " expects an atomic variable, element or field as its first argument");
+    }
+  }
+  else{
+    return error(name + " expects an atomic variable, element or field as its first argument");
+  }
+
+  if(atomic.error){
+    return atomic;
+  }
+
+  if(atomic.isAtomic == false || IsAggregate(atomic) || atomic.isPointer){
+    return error(name + " expects an atomic variable, element or field as its first argument, it was given " + TypeName(atomic));
+  }
+
+  // a load can't release and a store can't acquire, the C++ memory model has the same rule
+  std::optional<std::string> order = GetIdentifier(call->args.back());
+  static const std::set<std::string> orders = {"relaxed", "acquire", "release", "acq_rel", "seq_cst"};
+
+  if(order.has_value() == false || orders.contains(order.value()) == false){
+    return error("the last argument of " + name + " has to be relaxed, acquire, release, acq_rel or seq_cst");
+  }
+
+  if((name == "load" && (order == "release" || order == "acq_rel")) || (name == "store" && (order == "acquire" || order == "acq_rel"))){
+    return error(name + " can't be " + order.value() + ", " + (name == "load" ? "use relaxed, acquire or seq_cst" : "use relaxed, release or seq_cst"));
+  }
+
+  ExprType value = {atomic.type};
+
+  for(size_t i = 1; i + 1 < call->args.size(); i++){
+    ExprType type = AnalyzeExpr(call->args[i]);
+    CheckConversion(call->args[i], type, value, "argument " + std::to_string(i + 1) + " of " + name);
+  }
+
+  if(name == "store"){
+    return {TokenType::VOID};
+  }
+
+  // cas is 1 when it replaced expected with desired and 0 when the atomic held another value
+  return name == "cas" ? ExprType{TokenType::INT} : value;
+}
+
+// whether the statements assign to or declare the variable, either would invalidate what is known about it
+static bool WritesVariable(const std::vector<std::unique_ptr<StmtNode>>& body, const std::string& name);
+
+static bool WritesVariable(const std::unique_ptr<StmtNode>& stmt, const std::string& name){
+  struct WriteFinder{
+    const std::string& name;
+
+    bool operator()(const std::unique_ptr<CompoundStmtNode>& compoundStmt){
+      return WritesVariable(compoundStmt->body, name);
+    }
+
+    // a[i] = x changes an element, not a
+    bool operator()(const std::unique_ptr<AssignmentNode>& assignment){
+      return assignment->index == nullptr && assignment->identifier.value == name;
+    }
+
+    bool operator()(const std::unique_ptr<IfStmtNode>& ifStmt){
+      return WritesVariable(ifStmt->thenBody, name) || WritesVariable(ifStmt->elseBody, name);
+    }
+
+    bool operator()(const std::unique_ptr<WhileStmtNode>& whileStmt){
+      return WritesVariable(whileStmt->body, name);
+    }
+
+    bool operator()(const std::unique_ptr<ForStmtNode>& forStmt){
+      return (forStmt->init && WritesVariable(forStmt->init, name)) || (forStmt->step && (*this)(forStmt->step)) || WritesVariable(forStmt->body, name);
+    }
+
+    bool operator()(const std::unique_ptr<DeclerationStmtNode>& decleration){
+      return decleration->identifier.value == name;
+    }
+
+    bool operator()(const std::unique_ptr<FunctionNode>&){ return false; }
+    bool operator()(const std::unique_ptr<ReturnNode>&){ return false; }
+    bool operator()(const std::unique_ptr<ExprStmtNode>&){ return false; }
+  };
+
+  return std::visit(WriteFinder{name}, stmt->var);
+}
+
+static bool WritesVariable(const std::vector<std::unique_ptr<StmtNode>>& body, const std::string& name){
+  return std::any_of(body.begin(), body.end(), [&](const std::unique_ptr<StmtNode>& stmt){ return WritesVariable(stmt, name); });
+}
+
+std::optional<RangeFact> Analyzer::GetRangeFact(const std::unique_ptr<ExprNode>& condition){
+  if(std::holds_alternative<std::unique_ptr<ConditionalOpExpr>>(condition->var) == false){
+    return std::nullopt;
+  }
+
+  const auto& comparison = std::get<std::unique_ptr<ConditionalOpExpr>>(condition->var);
+  bool inclusive = comparison->type == ConditionalOpType::LESS_OR_EQUAL || comparison->type == ConditionalOpType::GREATER_OR_EQUAL;
+  bool isLess = comparison->type == ConditionalOpType::LESS_THAN || comparison->type == ConditionalOpType::LESS_OR_EQUAL;
+  bool isGreater = comparison->type == ConditionalOpType::GREATER_THAN || comparison->type == ConditionalOpType::GREATER_OR_EQUAL;
+
+  if(isLess == false && isGreater == false){
+    return std::nullopt;
+  }
+
+  // len(a) > i is i < len(a)
+  const std::unique_ptr<ExprNode>& variable = isLess ? comparison->lhs : comparison->rhs;
+  const std::unique_ptr<ExprNode>& bound = isLess ? comparison->rhs : comparison->lhs;
+
+  std::optional<std::string> name = GetIdentifier(variable);
+  SymbolInfo* symbol = name.has_value() ? LookupSymbol(name.value()) : nullptr;
+
+  if(symbol == nullptr || IsNumericType(symbol->type.type) == false || IsFloatType(symbol->type.type) || symbol->type.lanes != 0 || IsAggregate(symbol->type)
+    || symbol->type.isPointer){
+    return std::nullopt;
+  }
+
+  // a write through a pointer counts as a write to the variable, and it can happen anywhere in the function
+  if(m_addressTaken != nullptr && m_addressTaken->contains(name.value())){
+    return std::nullopt;
+  }
+
+  if(std::optional<uint64_t> constant = GetIntLiteral(bound)){
+    if(inclusive && constant.value() == UINT64_MAX){
+      return std::nullopt;
+    }
+
+    return RangeFact{name.value(), constant.value() + inclusive, ""};
+  }
+
+  if(inclusive || std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(bound->var) == false){
+    return std::nullopt;
+  }
+
+  const PrimaryExprNode* primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(bound->var).get();
+
+  // u32(len(a)) and i64(len(a)) keep the length, narrower types could cut it off
+  if(std::holds_alternative<std::unique_ptr<CastExprNode>>(primaryExpr->var)){
+    const auto& cast = std::get<std::unique_ptr<CastExprNode>>(primaryExpr->var);
+
+    if(IsFloatType(cast->type.type) || GetTypeBits(cast->type.type) < 32 || cast->type.lanes != 0
+      || std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(cast->expression->var) == false){
+      return std::nullopt;
+    }
+
+    primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(cast->expression->var).get();
+  }
+
+  if(std::holds_alternative<std::unique_ptr<CallExprNode>>(primaryExpr->var) == false){
+    return std::nullopt;
+  }
+
+  const auto& call = std::get<std::unique_ptr<CallExprNode>>(primaryExpr->var);
+
+  if(call->callee.value != "len" || call->args.size() != 1 || GetIdentifier(call->args[0]).has_value() == false){
+    return std::nullopt;
+  }
+
+  return RangeFact{name.value(), std::nullopt, GetIdentifier(call->args[0]).value()};
+}
+
+// for(T i = start; i < bound; i = i + step) with literals start and step. i starts out at 0 or
+// more and only grows, so 0 <= i < bound holds in the body unless the body writes to i or to the
+// array or slice whose length is the bound
+std::optional<RangeFact> Analyzer::GetLoopFact(const std::unique_ptr<ForStmtNode>& forStmt){
+  if(!forStmt->init || !forStmt->condition || !forStmt->step || std::holds_alternative<std::unique_ptr<DeclerationStmtNode>>(forStmt->init->var) == false){
+    return std::nullopt;
+  }
+
+  const auto& decleration = std::get<std::unique_ptr<DeclerationStmtNode>>(forStmt->init->var);
+  std::string variable = decleration->identifier.value.value();
+  TokenType type = decleration->type.type;
+
+  if(decleration->expression.has_value() == false || GetIntLiteral(decleration->expression.value()).has_value() == false){
+    return std::nullopt;
+  }
+
+  std::optional<RangeFact> fact = GetRangeFact(forStmt->condition);
+
+  if(fact.has_value() == false || fact->variable != variable){
+    return std::nullopt;
+  }
+
+  const auto& step = forStmt->step;
+
+  if(step->index || step->identifier.value != variable || std::holds_alternative<std::unique_ptr<BinOpExpr>>(step->expression->var) == false){
+    return std::nullopt;
+  }
+
+  const auto& increment = std::get<std::unique_ptr<BinOpExpr>>(step->expression->var);
+  bool isLeftVariable = GetIdentifier(increment->lhs) == variable;
+  std::optional<uint64_t> amount = GetIntLiteral(isLeftVariable ? increment->rhs : increment->lhs);
+
+  if(increment->type != BinOpType::ADD || (isLeftVariable == false && GetIdentifier(increment->rhs) != variable) || amount.value_or(0) == 0){
+    return std::nullopt;
+  }
+
+  // the step must not wrap i around. a constant bound leaves i at most bound - 1 + step, len()
+  // is an int so a step of 1 can't leave types of at least 32 bits
+  if(fact->bound.has_value()){
+    unsigned bits = GetTypeBits(type) - (IsUnsignedType(type) ? 0 : 1);
+    uint64_t max = bits >= 64 ? UINT64_MAX : (1ull << bits) - 1;
+
+    if(fact->bound.value() > 0 && (amount.value() > max || fact->bound.value() - 1 > max - amount.value())){
+      return std::nullopt;
+    }
+  }
+  else if(amount.value() != 1 || GetTypeBits(type) < 32){
+    return std::nullopt;
+  }
+
+  if(WritesVariable(forStmt->body, variable) || (fact->lengthOf.empty() == false && WritesVariable(forStmt->body, fact->lengthOf))){
+    return std::nullopt;
+  }
+
+  return fact;
+}
+
+ExprType Analyzer::AnalyzeIndex(const Token& array, const std::unique_ptr<ExprNode>& index, bool& boundsCheck){
+  std::string name = array.value.value();
+  SymbolInfo* symbol = LookupSymbol(name);
+  ExprType indexType = AnalyzeExpr(index);
+
+  if(symbol == nullptr){
+    m_errors.push_back("error: variable '" + name + "' was not declared in this scope \n");
+    return {TokenType::VOID, false, true};
+  }
+
+  const ExprType& arrayType = symbol->type;
+
+  if(IsAggregate(arrayType) == false && arrayType.isPointer == false){
+    m_errors.push_back("error: '" + name + "' of type " + TypeName(arrayType) + " can't be indexed, only arrays, slices and pointers can\n");
+    return {TokenType::VOID, false, true};
+  }
+
+  if(indexType.error == false && (indexType.type == TokenType::VOID || IsFloatType(indexType.type) || indexType.lanes != 0 || IsAggregate(indexType))){
+    m_errors.push_back("error: index of '" + name + "' has to be an integer, it is " + TypeName(indexType) + "\n");
+  }
+
+  ResolveDefault(index, indexType);
+
+  std::optional<uint64_t> constant = GetIntLiteral(index);
+  std::optional<std::string> variable = GetIdentifier(index);
+  bool inRange = false;
+
+  if(constant.has_value() && arrayType.arrayLength != 0){
+    if(constant.value() >= arrayType.arrayLength){
+      m_errors.push_back("error: index " + std::to_string(constant.value()) + " is out of range for '" + name + "' of type " + TypeName(arrayType) + "\n");
+    }
+
+    inRange = true;
+  }
+
+  for(const RangeFact& fact : m_rangeFacts){
+    if(variable == fact.variable){
+      inRange |= fact.lengthOf == name || (fact.bound.has_value() && fact.bound.value() <= arrayType.arrayLength);
+    }
+  }
+
+  // a pointer doesn't know how many elements it points to, so p[i] is never checked
+  boundsCheck = inRange == false && m_unchecked == 0 && arrayType.isPointer == false;
+
+  return {arrayType.type, false, false, arrayType.lanes, 0, false, arrayType.structName, false, arrayType.isAtomic};
+}
+
+ExprType Analyzer::AnalyzeFields(ExprType type, const std::vector<Token>& fields, const std::string& name){
+  std::string path = name;
+
+  for(const Token& field : fields){
+    if(type.error){
+      return type;
+    }
+
+    if(IsStruct(type) == false){
+      m_errors.push_back("error: '" + path + "' of type " + TypeName(type) + " has no fields\n");
+      return {TokenType::VOID, false, true};
+    }
+
+    const auto& structFields = m_structs.at(type.structName)->fields;
+    auto found = std::find_if(structFields.begin(), structFields.end(), [&](const StructFieldNode& structField){ return structField.identifier.value == field.value; });
+
+    if(found == structFields.end()){
+      m_errors.push_back("error: struct " + type.structName + " has no field '" + field.value.value() + "'\n");
+      return {TokenType::VOID, false, true};
+    }
+
+    type = TypeOf(found->type);
+    path += "." + field.value.value();
+  }
+
+  return type;
+}
+
+void Analyzer::AnalyzeStruct(const StructNode& structNode){
+  std::string name = structNode.name.value.value();
+  std::set<std::string> fieldNames;
+
+  for(const StructFieldNode& field : structNode.fields){
+    std::string fieldName = field.identifier.value.value();
+
+    if(fieldNames.insert(fieldName).second == false){
+      m_errors.push_back("error: duplicate field " + fieldName + " in struct " + name + "\n");
+    }
+
+    // the layout of a struct has a fixed size, a slice would only point to the elements and an
+    // array field would make every copy of the struct copy the array
+    if(IsAggregate(TypeOf(field.type))){
+      m_errors.push_back("error: field " + fieldName + " of struct " + name + " can't be an array or a slice\n");
+    }
+
+    if(field.type.isPointer){
+      m_errors.push_back("error: field " + fieldName + " of struct " + name + " can't be a pointer\n");
+    }
+
+    // LLVM only makes aligned atomic accesses lock free
+    if(structNode.layout.packed && IsAtomicValue(TypeOf(field.type))){
+      m_errors.push_back("error: field " + fieldName + " of @packed struct " + name + " can't be atomic, it may not be aligned\n");
+    }
+  }
+
+  m_structs[name] = &structNode;
+}
+
+ExprType Analyzer::AnalyzePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
   struct PrimaryExprVisitor{
     Analyzer& self;
 
-    void operator()(const std::unique_ptr<IntLitNode>& intLit){
-      return;
+    ExprType operator()(const std::unique_ptr<IntLitNode>& intLit){
+      if(intLit->hasSuffix && LiteralFits(intLit->val.value.value(), intLit->type) == false){
+        self.m_errors.push_back("error: literal " + intLit->val.value.value() + " doesn't fit in " + GetTypeName(intLit->type) + "\n");
+      }
 
+      return {intLit->type, intLit->hasSuffix == false};
     }
 
-    void operator()(const std::unique_ptr<FloatLitNode>& floatLit){
-      return;
+    ExprType operator()(const std::unique_ptr<FloatLitNode>& floatLit){
+      if(floatLit->hasSuffix && LiteralFits(floatLit->val.value.value(), floatLit->type) == false){
+        self.m_errors.push_back("error: literal " + floatLit->val.value.value() + " doesn't fit in " + GetTypeName(floatLit->type) + "\n");
+      }
+
+      return {floatLit->type, floatLit->hasSuffix == false};
     }
 
-    void operator()(const std::unique_ptr<IdentNode>& ident){
+    ExprType operator()(const std::unique_ptr<IdentNode>& ident){
       std::string variableName = ident->val.value.value();
+      SymbolInfo* symbol = self.LookupSymbol(variableName);
 
-      
-      if(self.m_scopes.back().find(variableName) == self.m_scopes.back().end()){
+      if(symbol == nullptr){
         self.m_errors.push_back("error: varibale '" + variableName + "' was not declared in this scope \n");
+        return {TokenType::VOID, false, true};
       }
 
-      return;
+      return CheckAtomicAccess(symbol->type, variableName);
     }
 
-    void operator()(const std::unique_ptr<ExprNode>& expr){
-      return;
+    // atomics are only accessed with the atomic builtins, a plain read would race with them
+    ExprType CheckAtomicAccess(const ExprType& type, const std::string& name){
+      if(type.error || self.IsAtomicValue(type) == false){
+        return type;
+      }
+
+      if(type.isAtomic){
+        self.m_errors.push_back("error: '" + name + "' is " + TypeName(type) + ", read it with load, fetch_add, fetch_sub or cas\n");
+      } else {
+        self.m_errors.push_back("error: struct '" + name + "' of type " + TypeName(type) + " has atomic fields and can't be copied, use its fields\n");
+      }
+
+      return {TokenType::VOID, false, true};
+    }
+
+    ExprType operator()(const std::unique_ptr<IndexExprNode>& index){
+      ExprType element = self.AnalyzeIndex(index->identifier, index->index, index->boundsCheck);
+      std::string name = index->identifier.value.value() + "[]";
+      return CheckAtomicAccess(self.AnalyzeFields(element, index->fields, name), name);
+    }
+
+    ExprType operator()(const std::unique_ptr<FieldExprNode>& field){
+      std::string variableName = field->identifier.value.value();
+      SymbolInfo* symbol = self.LookupSymbol(variableName);
+
+      if(symbol == nullptr){
+        self.m_errors.push_back("error: variable '" + variableName + "' was not declared in this scope \n");
+        return {TokenType::VOID, false, true};
+      }
+
+      std::string path = variableName;
+
+      for(const Token& fieldName : field->fields){
+        path += "." + fieldName.value.value();
+      }
+
+      return CheckAtomicAccess(self.AnalyzeFields(symbol->type, field->fields, variableName), path);
+    }
+
+    ExprType operator()(const std::unique_ptr<AddressOfExprNode>& addressOf){
+      std::string variableName = addressOf->identifier.value.value();
+      SymbolInfo* symbol = self.LookupSymbol(variableName);
+
+      if(symbol == nullptr){
+        self.m_errors.push_back("error: variable '" + variableName + "' was not declared in this scope \n");
+        return {TokenType::VOID, false, true};
+      }
+
+      ExprType type = symbol->type;
+      std::string path = variableName;
+
+      if(addressOf->index){
+        type = self.AnalyzeIndex(addressOf->identifier, addressOf->index, addressOf->boundsCheck);
+        path += "[]";
+
+        // the fields of a @soa element are in different arrays
+        if(type.error == false && addressOf->fields.empty() && symbol->type.isPointer == false && IsStruct(type) && self.m_structs.at(type.structName)->layout.soa){
+          self.m_errors.push_back("error: an element of @soa struct " + type.structName + " has no address, take the address of one of its fields\n");
+          return {TokenType::VOID, false, true};
+        }
+      }
+      // parameters are values without a place in memory
+      else if(symbol->decleration == nullptr){
+        self.m_errors.push_back("error: can't take the address of parameter '" + variableName + "', copy it into a local variable first\n");
+        return {TokenType::VOID, false, true};
+      }
+      else if(IsAggregate(type)){
+        self.m_errors.push_back("error: can't take the address of " + TypeName(type) + " '" + variableName + "', take the address of an element: &"
+          + variableName + "[0]\n");
+        return {TokenType::VOID, false, true};
+      }
+      else{
+        symbol->decleration->isAddressTaken = true;
+
+        // the pointer can be written through, so the global can't be read only data
+        auto global = self.m_scopes.front().find(variableName);
+
+        if(global != self.m_scopes.front().end() && &global->second == symbol){
+          symbol->decleration->isWritten = true;
+        }
+      }
+
+      type = self.AnalyzeFields(type, addressOf->fields, path);
+
+      if(type.error){
+        return type;
+      }
+
+      if(type.isPointer){
+        self.m_errors.push_back("error: can't take the address of pointer '" + variableName + "', pointers can't point to pointers\n");
+        return {TokenType::VOID, false, true};
+      }
+
+      type.isPointer = true;
+      return type;
+    }
+
+    ExprType operator()(const std::unique_ptr<ExprNode>& expr){
+      return self.AnalyzeExpr(expr);
+    }
+
+    ExprType operator()(const std::unique_ptr<CastExprNode>& cast){
+      ExprType operand = self.AnalyzeExpr(cast->expression);
+      TokenType type = cast->type.type;
+
+      if(IsNumericType(type) == false){
+        self.m_errors.push_back("error: conversion to a type that isn't numeric\n");
+        return {TokenType::VOID, false, true};
+      }
+
+      if(IsAggregate(TypeOf(cast->type)) || IsAggregate(operand) || IsStruct(operand) || cast->type.isPointer || operand.isPointer || cast->type.isAtomic){
+        self.m_errors.push_back("error: " + TypeName(operand) + " can't be converted to " + TypeName(TypeOf(cast->type)) + "\n");
+        return {TokenType::VOID, false, true};
+      }
+
+      if(operand.error == false && operand.type == TokenType::VOID){
+        self.m_errors.push_back("error: void value can't be converted to " + TypeName(TypeOf(cast->type)) + "\n");
+      }
+
+      // vectors are converted lane by lane
+      if(operand.lanes != 0 && operand.lanes != cast->type.lanes){
+        self.m_errors.push_back("error: " + TypeName(operand) + " can't be converted to " + TypeName(TypeOf(cast->type)) + "\n");
+      }
+
+      // integer literals get their default type and are then converted, so i8(0 - 128) and
+      // i16(70000) truncate like the conversion of a variable does. a float literal converted to
+      // a float type is created with that type, so f64(0.1) keeps its precision
+      if(operand.literal && IsFloatType(operand.type) && IsFloatType(type)){
+        self.ResolveLiterals(cast->expression, type);
+      }
+      else if(operand.literal && IsFloatType(operand.type) == false){
+        TokenType literalType = LiteralsFit(cast->expression, TokenType::INT) ? TokenType::INT
+          : LiteralsFit(cast->expression, TokenType::I64) ? TokenType::I64 : TokenType::U64;
+        self.ResolveLiterals(cast->expression, literalType);
+      } else {
+        self.ResolveDefault(cast->expression, operand);
+      }
 
+      return TypeOf(cast->type);
     }
 
+    ExprType operator()(const std::unique_ptr<CallExprNode>& call){
+      std::string functionName = call->callee.value.value();
+
+      if(IsBuiltinFunction(functionName)){
+        return self.AnalyzeBuiltin(call);
+      }
+
+      if(self.m_functions.find(functionName) == self.m_functions.end()){
+        self.m_errors.push_back("error: function '" + functionName + "' was not declared\n");
+        return {TokenType::VOID, false, true};
+      }
+
+      FunctionNode* function = self.m_functions.at(functionName);
+      const auto& typeParams = function->prototype->typeParams;
+
+      std::vector<ExprType> argTypes;
+
+      for(const auto& arg : call->args){
+        argTypes.push_back(self.AnalyzeExpr(arg));
+      }
+
+      if(call->args.size() != function->prototype->params.size()){
+        self.m_errors.push_back("error: function '" + functionName + "' expects " + std::to_string(function->prototype->params.size())
+          + " arguments but was given " + std::to_string(call->args.size()) + "\n");
+        return {TokenType::VOID, false, true};
+      }
+
+      if(typeParams.empty()){
+        if(call->typeArgs.empty() == false){
+          self.m_errors.push_back("error: function '" + functionName + "' is not generic but was given type arguments\n");
+        }
+      }
+      else{
+        if(call->typeArgs.size() != typeParams.size()){
+          self.m_errors.push_back("error: generic function '" + functionName + "' expects " + std::to_string(typeParams.size()) + " type arguments\n");
+          return {TokenType::VOID, false, true};
+        }
+
+        std::vector<TokenType> typeArgs;
 
+        for(const auto& typeArg : call->typeArgs){
+          if(IsNumericType(typeArg.type) == false){
+            self.m_errors.push_back("error: invalid type argument in call to generic function '" + functionName + "'\n");
+            return {TokenType::VOID, false, true};
+          }
+          typeArgs.push_back(typeArg.type);
+        }
+
+        // the call now refers to the monomorphized function
+        call->callee.value = self.Instantiate(function, typeArgs);
+        call->typeArgs.clear();
+        function = self.m_functions.at(call->callee.value.value());
+      }
+
+      for(size_t i = 0; i < call->args.size(); i++){
+        self.CheckConversion(call->args[i], argTypes[i], TypeOf(function->prototype->params[i].type),
+          "argument " + std::to_string(i + 1) + " of '" + functionName + "'");
+      }
+
+      return TypeOf(function->prototype->returnType);
+    }
   };
 
-  std::visit(PrimaryExprVisitor{*this}, primaryExpr->var);
+  return std::visit(PrimaryExprVisitor{*this}, primaryExpr->var);
 }
 
-void Analyzer::AnalyzeExpr(const std::unique_ptr<ExprNode>& expr){
+ExprType Analyzer::AnalyzeExpr(const std::unique_ptr<ExprNode>& expr){
   struct ExprVisitor{
     Analyzer& self;
 
-      void operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
-        self.AnalyzePrimaryExpr(primaryExpr);
-        return;
+      ExprType operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+        return self.AnalyzePrimaryExpr(primaryExpr);
       }
 
-      void operator()(const std::unique_ptr<BinOpExpr>& binExpr){
-        return;
+      ExprType operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+        ExprType lhs = self.AnalyzeExpr(binExpr->lhs);
+        ExprType rhs = self.AnalyzeExpr(binExpr->rhs);
+        return self.UnifyOperands(binExpr->lhs, lhs, binExpr->rhs, rhs);
       }
 
-      void operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
-        return;
+      // comparisons are int, 1 when they hold and 0 otherwise
+      ExprType operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
+        ExprType lhs = self.AnalyzeExpr(conditionalExpr->lhs);
+        ExprType rhs = self.AnalyzeExpr(conditionalExpr->rhs);
+        ExprType operands = self.UnifyOperands(conditionalExpr->lhs, lhs, conditionalExpr->rhs, rhs);
+
+        self.ResolveDefault(conditionalExpr->lhs, operands);
+        self.ResolveDefault(conditionalExpr->rhs, operands);
+
+        return {TokenType::INT, false, operands.error, operands.lanes};
       }
   };
 
-  std::visit(ExprVisitor{*this}, expr->var);
-
+  return std::visit(ExprVisitor{*this}, expr->var);
 }
 
 void Analyzer::AnalyzeStmt(const std::unique_ptr<StmtNode>& stmt){
@@ -76,27 +1491,142 @@ void Analyzer::AnalyzeStmt(const std::unique_ptr<StmtNode>& stmt){
     // handles type checking and checks if variables exist and if its initialized
     void operator()(const std::unique_ptr<AssignmentNode>& assignment){
       auto variableName = assignment->identifier.value.value();
-      bool isDeclared = false;
 
-      for(const auto& scope : self.m_scopes){
-        if(scope.find(variableName) != scope.end()){
-          isDeclared = true;
+      // a[i] = x and a[i] += x, x has to convert to the element type either way
+      if(assignment->index){
+        ExprType element = self.AnalyzeIndex(assignment->identifier, assignment->index, assignment->boundsCheck);
+        element = self.AnalyzeFields(element, assignment->fields, variableName + "[]");
+        ExprType type = self.AnalyzeExpr(assignment->expression);
+
+        if(element.error == false && CheckAtomicTarget(element, variableName + "[]")){
+          CheckCompound(assignment, element);
+          self.CheckConversion(assignment->expression, type, element, "assignment to an element of '" + variableName + "'");
         }
 
+        return;
       }
 
-      if(isDeclared == false){
+      SymbolInfo* symbol = self.LookupSymbol(variableName);
+
+      if(symbol == nullptr){
         self.m_errors.push_back("error: variable '" + variableName + "' was not declared in this scope \n");
       }
 
+      // globals that are never written to can be emitted as read only data
+      else{
+        auto global = self.m_scopes.front().find(variableName);
+
+        if(global != self.m_scopes.front().end() && &global->second == symbol){
+          symbol->decleration->isWritten = true;
+        }
+      }
+
+      // x += y is parsed as x = x + y, which would read the atomic a second time
+      if(symbol != nullptr && assignment->fields.empty() && CheckAtomicTarget(symbol->type, variableName) == false){
+        return;
+      }
 
       // checks the expression to the right of the '=' operator
-      self.AnalyzeExpr(assignment->expression);
+      ExprType type = self.AnalyzeExpr(assignment->expression);
+
+      // p.x = x and p.x += x
+      if(symbol != nullptr && assignment->fields.empty() == false){
+        ExprType field = self.AnalyzeFields(symbol->type, assignment->fields, variableName);
+
+        std::string path = variableName;
+
+        for(const Token& fieldName : assignment->fields){
+          path += "." + fieldName.value.value();
+        }
+
+        if(field.error == false && CheckAtomicTarget(field, path)){
+          CheckCompound(assignment, field);
+          self.CheckConversion(assignment->expression, type, field, "assignment to a field of '" + variableName + "'");
+        }
+      }
+      else if(symbol != nullptr && symbol->type.arrayLength != 0){
+        self.m_errors.push_back("error: array '" + variableName + "' can't be assigned, assign its elements instead\n");
+      }
+      else if(symbol != nullptr){
+        self.CheckConversion(assignment->expression, type, symbol->type, "assignment to '" + variableName + "'");
+      }
 
       return;
     }
 
+    // atomics are only written with store, fetch_add, fetch_sub and cas
+    bool CheckAtomicTarget(const ExprType& target, const std::string& name){
+      if(self.IsAtomicValue(target) == false){
+        return true;
+      }
+
+      if(target.isAtomic){
+        self.m_errors.push_back("error: '" + name + "' is " + TypeName(target) + ", write it with store, fetch_add, fetch_sub or cas\n");
+      } else {
+        self.m_errors.push_back("error: struct '" + name + "' of type " + TypeName(target) + " has atomic fields and can't be assigned, use its fields\n");
+      }
+
+      return false;
+    }
+
+    // a compound assignment computes with the old value, which a struct can't do
+    void CheckCompound(const std::unique_ptr<AssignmentNode>& assignment, const ExprType& target){
+      if(assignment->compoundType.has_value() && IsStruct(target)){
+        self.m_errors.push_back("error: struct " + TypeName(target) + " can't be used with a compound assignment, use its fields\n");
+      }
+    }
+
+    // any number can be a condition, it holds when it isn't 0
+    void AnalyzeCondition(const std::unique_ptr<ExprNode>& condition){
+      ExprType type = self.AnalyzeExpr(condition);
+
+      if(type.error == false && type.type == TokenType::VOID){
+        self.m_errors.push_back("error: void value used as a condition\n");
+      }
+
+      if(IsAggregate(type) || IsStruct(type) || type.isPointer){
+        self.m_errors.push_back("error: " + TypeName(type) + " used as a condition\n");
+      }
+      else if(type.lanes != 0){
+        self.m_errors.push_back("error: " + TypeName(type) + " used as a condition, reduce it to a scalar first\n");
+      }
+
+      self.ResolveDefault(condition, type);
+    }
+
+    // if(i < len(a)) gives the then body a fact about i when i can't be negative, because it is
+    // unsigned or a loop already knows that. i must be local, a call could change a global
+    std::optional<RangeFact> GetIfFact(const std::unique_ptr<IfStmtNode>& ifstmt){
+      std::optional<RangeFact> fact = self.GetRangeFact(ifstmt->condition);
+
+      if(fact.has_value() == false){
+        return std::nullopt;
+      }
+
+      SymbolInfo* symbol = self.LookupSymbol(fact->variable);
+      auto global = self.m_scopes.front().find(fact->variable);
+      bool isGlobal = global != self.m_scopes.front().end() && &global->second == symbol;
+
+      bool isNonNegative = IsUnsignedType(symbol->type.type) || std::any_of(self.m_rangeFacts.begin(), self.m_rangeFacts.end(),
+        [&](const RangeFact& outer){ return outer.variable == fact->variable; });
+
+      if(isGlobal || isNonNegative == false || WritesVariable(ifstmt->thenBody, fact->variable)
+        || (fact->lengthOf.empty() == false && WritesVariable(ifstmt->thenBody, fact->lengthOf))){
+        return std::nullopt;
+      }
+
+      return fact;
+    }
+
     void operator()(const std::unique_ptr<IfStmtNode>& ifstmt){
+      AnalyzeCondition(ifstmt->condition);
+
+      std::optional<RangeFact> fact = GetIfFact(ifstmt);
+
+      if(fact.has_value()){
+        self.m_rangeFacts.push_back(fact.value());
+      }
+
       self.m_scopes.push_back({});
 
       for(const auto& stmt : ifstmt->thenBody){
@@ -105,21 +1635,175 @@ void Analyzer::AnalyzeStmt(const std::unique_ptr<StmtNode>& stmt){
 
       self.m_scopes.pop_back();
 
+      if(fact.has_value()){
+        self.m_rangeFacts.pop_back();
+      }
+
+      self.m_scopes.push_back({});
+
+      for(const auto& stmt : ifstmt->elseBody){
+        self.AnalyzeStmt(stmt);
+      }
+
+      self.m_scopes.pop_back();
+
+      return;
+    }
+
+    void operator()(const std::unique_ptr<WhileStmtNode>& whileStmt){
+      self.m_unchecked += whileStmt->hints.unchecked;
+
+      AnalyzeCondition(whileStmt->condition);
+
+      self.m_scopes.push_back({});
+
+      for(const auto& stmt : whileStmt->body){
+        self.AnalyzeStmt(stmt);
+      }
+
+      self.m_scopes.pop_back();
+      self.m_unchecked -= whileStmt->hints.unchecked;
+
+      return;
+    }
+
+    // the variables declared by init are only visible inside the loop
+    void operator()(const std::unique_ptr<ForStmtNode>& forStmt){
+      self.m_unchecked += forStmt->hints.unchecked;
+      self.m_scopes.push_back({});
+
+      if(forStmt->init){
+        self.AnalyzeStmt(forStmt->init);
+      }
+
+      if(forStmt->condition){
+        AnalyzeCondition(forStmt->condition);
+      }
+
+      if(forStmt->step){
+        (*this)(forStmt->step);
+      }
+
+      // the condition and step are analyzed first, so the literals of the loop header have their types
+      std::optional<RangeFact> fact = self.GetLoopFact(forStmt);
+
+      if(fact.has_value()){
+        self.m_rangeFacts.push_back(fact.value());
+      }
+
+      self.m_scopes.push_back({});
+
+      for(const auto& stmt : forStmt->body){
+        self.AnalyzeStmt(stmt);
+      }
+
+      self.m_scopes.pop_back();
+      self.m_scopes.pop_back();
+
+      if(fact.has_value()){
+        self.m_rangeFacts.pop_back();
+      }
+
+      self.m_unchecked -= forStmt->hints.unchecked;
+
       return;
     }
 
     void operator()(const std::unique_ptr<FunctionNode>& function){
+      // generic functions are only analyzed once they are instantiated with concrete types
+      if(function->prototype->typeParams.empty() == false){
+        return;
+      }
+
+      if(function->prototype->name.value.value() == "main" && function->prototype->params.empty() == false){
+        self.m_errors.push_back("error: main can't take parameters\n");
+      }
+
+      // the parameters are the outermost local scope, the body can't redeclare them
       self.m_scopes.push_back({});
 
+      for(const auto& param : function->prototype->params){
+        std::string paramName = param.identifier.value.value();
+
+        if(self.m_scopes.back().contains(paramName)){
+          self.m_errors.push_back("error: duplicate parameter " + paramName + " in function " + function->prototype->name.value.value() + "\n");
+        }
+
+        // arrays are only passed as slices, so calls never copy them
+        if(param.type.arrayLength != 0){
+          self.m_errors.push_back("error: parameter " + paramName + " of function " + function->prototype->name.value.value() + " is an array, take a slice "
+            + TypeName({param.type.type, false, false, param.type.lanes, 0, true, TypeOf(param.type).structName}) + " instead\n");
+        }
+
+        // a copy of an atomic isn't shared with anyone, functions take a pointer to it instead
+        if(self.IsAtomicValue(TypeOf(param.type))){
+          self.m_errors.push_back("error: parameter " + paramName + " of function " + function->prototype->name.value.value() + " is " + TypeName(TypeOf(param.type))
+            + ", pass a pointer to it instead\n");
+        }
+
+        self.m_scopes.back().insert({paramName, {TypeOf(param.type), true, nullptr}});
+      }
+
+      if(self.IsAtomicValue(TypeOf(function->prototype->returnType))){
+        self.m_errors.push_back("error: function " + function->prototype->name.value.value() + " can't return " + TypeName(TypeOf(function->prototype->returnType)) + "\n");
+      }
+
+      if(IsAggregate(TypeOf(function->prototype->returnType))){
+        self.m_errors.push_back("error: function " + function->prototype->name.value.value() + " can't return an array or a slice\n");
+      }
+
+      if(function->prototype->returnType.isRestrict){
+        self.m_errors.push_back("error: restrict only applies to pointer parameters, not to the return type of " + function->prototype->name.value.value() + "\n");
+      }
+
+      const ProtoTypeNode* outerFunction = self.m_currentFunction;
+      const std::set<std::string>* outerAddressTaken = self.m_addressTaken;
+      self.m_currentFunction = function->prototype.get();
+      self.m_addressTaken = &function->addressTaken;
+      self.m_unchecked += function->unchecked;
+
       for(const auto& stmt : function->body){
         self.AnalyzeStmt(stmt);
       }
 
+      self.m_unchecked -= function->unchecked;
+      self.m_currentFunction = outerFunction;
+      self.m_addressTaken = outerAddressTaken;
       self.m_scopes.pop_back();
 
       return;
     }
 
+    void operator()(const std::unique_ptr<ReturnNode>& returnStmt){
+      if(self.m_currentFunction == nullptr){
+        self.m_errors.push_back("error: return outside of a function\n");
+        return;
+      }
+
+      bool returnsVoid = self.m_currentFunction->returnType.type == TokenType::VOID;
+      std::string functionName = self.m_currentFunction->name.value.value();
+
+      if(returnStmt->value){
+        ExprType type = self.AnalyzeExpr(returnStmt->value);
+
+        if(returnsVoid){
+          self.m_errors.push_back("error: void function '" + functionName + "' can't return a value\n");
+        } else {
+          self.CheckConversion(returnStmt->value, type, TypeOf(self.m_currentFunction->returnType), "return value of '" + functionName + "'");
+        }
+      }
+      else if(returnsVoid == false){
+        self.m_errors.push_back("error: function '" + functionName + "' must return a value\n");
+      }
+
+      return;
+    }
+
+    void operator()(const std::unique_ptr<ExprStmtNode>& exprStmt){
+      self.ResolveDefault(exprStmt->expression, self.AnalyzeExpr(exprStmt->expression));
+      return;
+    }
+
     void operator()(const std::unique_ptr<DeclerationStmtNode>& decleration){
       // check map if decleration already exists if not add it to symbols
       auto variableName = decleration->identifier.value.value();
@@ -128,12 +1812,52 @@ void Analyzer::AnalyzeStmt(const std::unique_ptr<StmtNode>& stmt){
         self.m_errors.push_back("error: redecleration of variable " + variableName + '\n');
         
       }else{
-        self.m_scopes.back().insert({variableName, {decleration->type.type, true}});
+        self.m_scopes.back().insert({variableName, {TypeOf(decleration->type), true, decleration.get()}});
+      }
+
+      bool isGlobal = self.m_scopes.size() == 1;
+
+      if(isGlobal && decleration->type.isSlice){
+        self.m_errors.push_back("error: slice '" + variableName + "' can't be a global variable\n");
+      }
+
+      // a pointer stored in a global would outlive the local it points to
+      if(isGlobal && decleration->type.isPointer){
+        self.m_errors.push_back("error: pointer '" + variableName + "' can't be a global variable\n");
+      }
+
+      if(decleration->type.isRestrict){
+        self.m_errors.push_back("error: restrict only applies to pointer parameters, not to variable '" + variableName + "'\n");
+      }
+
+      // the elements can be written through a slice, so a global array never becomes read only data.
+      // neither does an atomic, other threads write it
+      if(isGlobal && (decleration->type.arrayLength != 0 || self.IsAtomicValue(TypeOf(decleration->type)))){
+        decleration->isWritten = true;
+      }
+
+      if(decleration->type.arrayLength != 0 && decleration->expression.has_value()){
+        self.m_errors.push_back("error: array '" + variableName + "' can't have an initializer, its elements start out as 0\n");
+        return;
       }
 
       // does checking on the expression to the right of the '=' operator
       if(decleration->expression.has_value()){
-        self.AnalyzeExpr(decleration->expression.value());
+        ExprType type = self.AnalyzeExpr(decleration->expression.value());
+        self.CheckConversion(decleration->expression.value(), type, TypeOf(decleration->type), "initializer of '" + variableName + "'");
+
+        if(self.m_scopes.size() == 1 && self.IsConstantExpr(decleration->expression.value()) == false){
+          self.m_errors.push_back("error: initializer of global variable '" + variableName + "' is not a constant expression\n");
+        }
+
+        // global initializers are folded by the generator, which only folds scalars
+        if(self.m_scopes.size() == 1 && decleration->type.lanes != 0){
+          self.m_errors.push_back("error: global vector '" + variableName + "' can't have an initializer, it starts out as 0\n");
+        }
+
+        if(self.m_scopes.size() == 1 && IsStruct(TypeOf(decleration->type))){
+          self.m_errors.push_back("error: global struct '" + variableName + "' can't have an initializer, its fields start out as 0\n");
+        }
       }
 
       return;
@@ -147,13 +1871,48 @@ void Analyzer::AnalyzeStmt(const std::unique_ptr<StmtNode>& stmt){
 }
 
 bool Analyzer::Analyze(const std::unique_ptr<ProgNode>& prog){
+  // global scope
+  m_scopes.push_back({});
+
+  for(const auto& structNode : prog->structs){
+    AnalyzeStruct(*structNode);
+  }
+
+  // functions can be called before they are defined
+  for(const auto& stmt : prog->stmts){
+    if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var)){
+      FunctionNode* function = std::get<std::unique_ptr<FunctionNode>>(stmt->var).get();
+      std::string functionName = function->prototype->name.value.value();
+
+      if(m_functions.find(functionName) != m_functions.end()){
+        m_errors.push_back("error: redefinition of function " + functionName + '\n');
+      }
+
+      if(IsBuiltinFunction(functionName)){
+        m_errors.push_back("error: " + functionName + " is a builtin function and can't be redefined\n");
+      }
+      m_functions[functionName] = function;
+    }
+  }
+
   for(const auto& stmt : prog->stmts){
     AnalyzeStmt(stmt);
   }
 
+  // instantiations can instantiate other generic functions, so keep going until no new ones show up
+  while(m_instances.empty() == false){
+    auto instances = std::move(m_instances);
+    m_instances.clear();
+
+    for(auto& instance : instances){
+      AnalyzeStmt(instance);
+      prog->stmts.push_back(std::move(instance));
+    }
+  }
+
   if(m_errors.size() > 0){
     for(const auto& error: m_errors){
-      std::cerr << error;
+      GetErrorStream() << error;
     }
     
     return false;
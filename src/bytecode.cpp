@@ -0,0 +1,593 @@
+#include "bytecode.hpp"
+#include "llvm/ADT/APFloat.h"
+#include <limits>
+
+std::optional<ValueKind> GetValueKind(TokenType type){
+    switch(type){
+        case TokenType::INT:
+            return ValueKind::I32;
+        case TokenType::UINT:
+            return ValueKind::U32;
+        case TokenType::FLOAT:
+            return ValueKind::F32;
+        case TokenType::VOID:
+            return ValueKind::VOID;
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<ValueKind> GetValueKind(const Token& type){
+    if(type.lanes != 0 || type.arrayLength != 0 || type.isSlice || type.isPointer || type.isAtomic){
+        return std::nullopt;
+    }
+
+    return GetValueKind(type.type);
+}
+
+void BytecodeCompiler::Unsupported(const std::string& reason){
+    if(m_function->supported){
+        m_function->supported = false;
+        m_function->unsupportedReason = reason;
+    }
+}
+
+uint16_t BytecodeCompiler::NewRegister(){
+    if(m_function->registerCount == std::numeric_limits<uint16_t>::max()){
+        Unsupported("too many registers");
+        return 0;
+    }
+
+    return m_function->registerCount++;
+}
+
+size_t BytecodeCompiler::Emit(Opcode op, uint16_t a, uint16_t b, uint16_t c){
+    m_function->code.push_back({op, a, b, c});
+    return m_function->code.size() - 1;
+}
+
+size_t BytecodeCompiler::EmitWide(Opcode op, uint16_t a, uint32_t bc){
+    return Emit(op, a, uint16_t(bc), uint16_t(bc >> 16));
+}
+
+void BytecodeCompiler::PatchJump(size_t instruction, size_t target){
+    m_function->code[instruction].b = uint16_t(target);
+    m_function->code[instruction].c = uint16_t(target >> 16);
+}
+
+TypedRegister BytecodeCompiler::LoadConstant(Slot value, ValueKind kind){
+    uint16_t reg = NewRegister();
+    m_function->constants.push_back(value);
+    EmitWide(Opcode::LOAD_CONST, reg, m_function->constants.size() - 1);
+    return {reg, kind};
+}
+
+TypedRegister BytecodeCompiler::Convert(TypedRegister value, ValueKind kind){
+    if(kind != ValueKind::F32 || (value.kind != ValueKind::I32 && value.kind != ValueKind::U32)){
+        return value;
+    }
+
+    uint16_t reg = NewRegister();
+    Emit(value.kind == ValueKind::U32 ? Opcode::U32_TO_F32 : Opcode::I32_TO_F32, reg, value.reg);
+    return {reg, ValueKind::F32};
+}
+
+TypedRegister BytecodeCompiler::Cast(TypedRegister value, ValueKind kind){
+    if(kind == ValueKind::F32){
+        return Convert(value.kind == ValueKind::BOOL ? TypedRegister{value.reg, ValueKind::I32} : value, kind);
+    }
+
+    // i32, u32 and bool share their bits, only the kind changes
+    if(value.kind != ValueKind::F32){
+        return {value.reg, kind};
+    }
+
+    uint16_t reg = NewRegister();
+    Emit(kind == ValueKind::U32 ? Opcode::F32_TO_U32 : Opcode::F32_TO_I32, reg, value.reg);
+    return {reg, kind};
+}
+
+uint16_t BytecodeCompiler::CompileArguments(uint16_t function, const std::vector<std::unique_ptr<ExprNode>>& args){
+    const std::vector<ValueKind>& paramKinds = m_program.functions[function].paramKinds;
+    std::vector<TypedRegister> values;
+
+    for(size_t i = 0; i < args.size() && i < paramKinds.size(); i++){
+        values.push_back(Convert(CompileExpr(args[i]), paramKinds[i]));
+    }
+
+    // the values are only moved into place once all of them are computed, calls in the
+    // arguments would otherwise take the registers in between
+    uint16_t first = m_function->registerCount;
+
+    for(const TypedRegister& value : values){
+        Emit(Opcode::MOVE, NewRegister(), value.reg);
+    }
+
+    return first;
+}
+
+TypedRegister BytecodeCompiler::CompilePrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+    struct PrimaryExprVisitor{
+        BytecodeCompiler & compiler;
+        TypedRegister value = {0, ValueKind::I32};
+
+        // the analyzer checked that the literal fits into its type
+        void operator()(const std::unique_ptr<IntLitNode>& intLit){
+            Slot constant = {};
+            std::optional<ValueKind> kind = GetValueKind(intLit->type);
+
+            if(kind == ValueKind::I32 || kind == ValueKind::U32){
+                constant.u32 = std::stoul(intLit->val.value.value());
+            } else if(kind == ValueKind::F32){
+                constant.f32 = llvm::APFloat(llvm::APFloat::IEEEsingle(), intLit->val.value.value()).convertToFloat();
+            } else {
+                compiler.Unsupported("literal of type " + GetTypeName(intLit->type));
+                return;
+            }
+
+            value = compiler.LoadConstant(constant, kind.value());
+        }
+
+        void operator()(const std::unique_ptr<FloatLitNode>& floatLit){
+            if(GetValueKind(floatLit->type) != ValueKind::F32){
+                compiler.Unsupported("literal of type " + GetTypeName(floatLit->type));
+                return;
+            }
+
+            // rounded like the generator rounds it, std::stof throws for literals that overflow or underflow
+            Slot constant = {};
+            constant.f32 = llvm::APFloat(llvm::APFloat::IEEEsingle(), floatLit->val.value.value()).convertToFloat();
+            value = compiler.LoadConstant(constant, ValueKind::F32);
+        }
+
+        void operator()(const std::unique_ptr<IdentNode>& ident){
+            std::string variableName = ident->val.value.value();
+
+            if(compiler.m_locals.find(variableName) != compiler.m_locals.end()){
+                value = compiler.m_locals.at(variableName);
+                return;
+            }
+
+            if(compiler.m_program.globalIndices.find(variableName) != compiler.m_program.globalIndices.end()){
+                uint16_t global = compiler.m_program.globalIndices.at(variableName);
+                value = {compiler.NewRegister(), compiler.m_program.globals[global].kind};
+                compiler.Emit(Opcode::LOAD_GLOBAL_32, value.reg, global);
+                return;
+            }
+
+            compiler.Unsupported("unknown variable " + variableName);
+        }
+
+        void operator()(const std::unique_ptr<ExprNode>& innerExpr){
+            value = compiler.CompileExpr(innerExpr);
+        }
+
+        void operator()(const std::unique_ptr<CallExprNode>& call){
+            std::string callee = call->callee.value.value();
+
+            if(IsBuiltinFunction(callee)){
+                compiler.Unsupported("builtin " + callee);
+                return;
+            }
+
+            if(compiler.m_program.functionIndices.find(callee) == compiler.m_program.functionIndices.end()){
+                compiler.Unsupported("call to unknown function " + callee);
+                return;
+            }
+
+            uint16_t function = compiler.m_program.functionIndices.at(callee);
+
+            // the arguments and the result would need registers of a kind the interpreter doesn't have
+            if(compiler.m_program.functions[function].knownSignature == false){
+                compiler.Unsupported("call to " + callee + ", which has parameters or a return value of an unsupported type");
+                return;
+            }
+
+            uint16_t arguments = compiler.CompileArguments(function, call->args);
+            value = {compiler.NewRegister(), compiler.m_program.functions[function].returnKind};
+            compiler.Emit(Opcode::CALL, value.reg, function, call->args.empty() ? value.reg : arguments);
+        }
+
+        void operator()(const std::unique_ptr<CastExprNode>& cast){
+            TypedRegister operand = compiler.CompileExpr(cast->expression);
+            std::optional<ValueKind> kind = GetValueKind(cast->type);
+
+            if(!kind || kind == ValueKind::VOID){
+                compiler.Unsupported("conversion to " + GetTypeName(cast->type.type));
+                return;
+            }
+
+            value = compiler.Cast(operand, kind.value());
+        }
+
+        void operator()(const std::unique_ptr<IndexExprNode>& index){
+            compiler.Unsupported("element of " + index->identifier.value.value());
+        }
+
+        void operator()(const std::unique_ptr<FieldExprNode>& field){
+            compiler.Unsupported("field of " + field->identifier.value.value());
+        }
+
+        void operator()(const std::unique_ptr<AddressOfExprNode>& addressOf){
+            compiler.Unsupported("address of " + addressOf->identifier.value.value());
+        }
+    };
+
+    PrimaryExprVisitor visitor = {*this};
+    std::visit(visitor, primaryExpr->var);
+    return visitor.value;
+}
+
+TypedRegister BytecodeCompiler::CompileExpr(const std::unique_ptr<ExprNode>& expr){
+    struct ExprVisitor{
+        BytecodeCompiler & compiler;
+        TypedRegister value = {0, ValueKind::I32};
+
+        void operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+            value = compiler.CompilePrimaryExpr(primaryExpr);
+        }
+
+        void operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+            TypedRegister lhs = compiler.CompileExpr(binExpr->lhs);
+            TypedRegister rhs = compiler.CompileExpr(binExpr->rhs);
+
+            bool isFloat = lhs.kind == ValueKind::F32 && rhs.kind == ValueKind::F32;
+            bool isInt = lhs.kind != ValueKind::F32 && rhs.kind != ValueKind::F32;
+
+            if(!isFloat && !isInt){
+                compiler.Unsupported("mixed int and float operands");
+                return;
+            }
+
+            bool isUnsigned = lhs.kind == ValueKind::U32 || rhs.kind == ValueKind::U32;
+            bool isChecked = !isUnsigned && compiler.m_checkedArithmetic;
+            Opcode op = Opcode::ADD_I32;
+
+            switch(binExpr->type){
+                case BinOpType::ADD:
+                    op = isFloat ? Opcode::ADD_F32 : isChecked ? Opcode::ADD_I32_CHECKED : Opcode::ADD_I32;
+                    break;
+                case BinOpType::SUB:
+                    op = isFloat ? Opcode::SUB_F32 : isChecked ? Opcode::SUB_I32_CHECKED : Opcode::SUB_I32;
+                    break;
+                case BinOpType::MUL:
+                    op = isFloat ? Opcode::MUL_F32 : isChecked ? Opcode::MUL_I32_CHECKED : Opcode::MUL_I32;
+                    break;
+                case BinOpType::DIV:
+                    op = isFloat ? Opcode::DIV_F32 : isUnsigned ? Opcode::DIV_U32 : Opcode::DIV_I32;
+                    break;
+            }
+
+            value = {compiler.NewRegister(), isFloat ? ValueKind::F32 : isUnsigned ? ValueKind::U32 : ValueKind::I32};
+            compiler.Emit(op, value.reg, lhs.reg, rhs.reg);
+        }
+
+        void operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
+            TypedRegister lhs = compiler.CompileExpr(conditionalExpr->lhs);
+            TypedRegister rhs = compiler.CompileExpr(conditionalExpr->rhs);
+
+            bool isFloat = lhs.kind == ValueKind::F32 && rhs.kind == ValueKind::F32;
+            bool isInt = lhs.kind != ValueKind::F32 && rhs.kind != ValueKind::F32;
+
+            if(!isFloat && !isInt){
+                compiler.Unsupported("comparison between int and float");
+                return;
+            }
+
+            bool isUnsigned = lhs.kind == ValueKind::U32 || rhs.kind == ValueKind::U32;
+            Opcode op = Opcode::EQ_I32;
+
+            switch(conditionalExpr->type){
+                case ConditionalOpType::EQUAL_TO:
+                    op = isFloat ? Opcode::EQ_F32 : Opcode::EQ_I32;
+                    break;
+                case ConditionalOpType::NOT_EQUAL:
+                    op = isFloat ? Opcode::NE_F32 : Opcode::NE_I32;
+                    break;
+                case ConditionalOpType::LESS_THAN:
+                    op = isFloat ? Opcode::LT_F32 : isUnsigned ? Opcode::LT_U32 : Opcode::LT_I32;
+                    break;
+                case ConditionalOpType::GREATER_THAN:
+                    op = isFloat ? Opcode::GT_F32 : isUnsigned ? Opcode::GT_U32 : Opcode::GT_I32;
+                    break;
+                case ConditionalOpType::LESS_OR_EQUAL:
+                    op = isFloat ? Opcode::LE_F32 : isUnsigned ? Opcode::LE_U32 : Opcode::LE_I32;
+                    break;
+                case ConditionalOpType::GREATER_OR_EQUAL:
+                    op = isFloat ? Opcode::GE_F32 : isUnsigned ? Opcode::GE_U32 : Opcode::GE_I32;
+                    break;
+            }
+
+            value = {compiler.NewRegister(), ValueKind::BOOL};
+            compiler.Emit(op, value.reg, lhs.reg, rhs.reg);
+        }
+    };
+
+    ExprVisitor visitor = {*this};
+    std::visit(visitor, expr->var);
+    return visitor.value;
+}
+
+TypedRegister BytecodeCompiler::CompileCondition(const std::unique_ptr<ExprNode>& expr){
+    TypedRegister condition = CompileExpr(expr);
+
+    // -0.0 is false as well, so floats can't be tested by their bits
+    if(condition.kind == ValueKind::F32){
+        TypedRegister zero = LoadConstant(Slot{}, ValueKind::F32);
+        TypedRegister result = {NewRegister(), ValueKind::BOOL};
+        Emit(Opcode::NE_F32, result.reg, condition.reg, zero.reg);
+        return result;
+    }
+
+    return condition;
+}
+
+void BytecodeCompiler::CompileStmt(const std::unique_ptr<StmtNode>& stmt){
+    struct StmtVisitor{
+        BytecodeCompiler & compiler;
+
+        void operator()(const std::unique_ptr<CompoundStmtNode>& compoundStmt){
+            std::map<std::string, TypedRegister> outerScope = compiler.m_locals;
+
+            for(const auto& stmt : compoundStmt->body){
+                compiler.CompileStmt(stmt);
+            }
+
+            compiler.m_locals = outerScope;
+        }
+
+        void operator()(const std::unique_ptr<DeclerationStmtNode>& decleration){
+            std::optional<ValueKind> kind = GetValueKind(decleration->type);
+
+            if(!kind || kind == ValueKind::VOID){
+                compiler.Unsupported("variable of unsupported type");
+                return;
+            }
+
+            // registers start out as 0, so uninitialized variables don't need code
+            TypedRegister variable = {compiler.NewRegister(), *kind};
+
+            if(decleration->expression.has_value()){
+                TypedRegister initialValue = compiler.Convert(compiler.CompileExpr(decleration->expression.value()), *kind);
+                compiler.Emit(Opcode::MOVE, variable.reg, initialValue.reg);
+            }
+
+            compiler.m_locals[decleration->identifier.value.value()] = variable;
+        }
+
+        void operator()(const std::unique_ptr<FunctionNode>&){
+            compiler.Unsupported("nested function");
+        }
+
+        void operator()(const std::unique_ptr<AssignmentNode>& assignment){
+            std::string variableName = assignment->identifier.value.value();
+
+            if(assignment->index){
+                compiler.Unsupported("assignment to an element of " + variableName);
+                return;
+            }
+
+            if(assignment->fields.empty() == false){
+                compiler.Unsupported("assignment to a field of " + variableName);
+                return;
+            }
+
+            if(compiler.m_locals.find(variableName) != compiler.m_locals.end()){
+                TypedRegister variable = compiler.m_locals.at(variableName);
+                TypedRegister newValue = compiler.Convert(compiler.CompileExpr(assignment->expression), variable.kind);
+                compiler.Emit(Opcode::MOVE, variable.reg, newValue.reg);
+                return;
+            }
+
+            if(compiler.m_program.globalIndices.find(variableName) != compiler.m_program.globalIndices.end()){
+                uint16_t global = compiler.m_program.globalIndices.at(variableName);
+                TypedRegister newValue = compiler.Convert(compiler.CompileExpr(assignment->expression), compiler.m_program.globals[global].kind);
+                compiler.Emit(Opcode::STORE_GLOBAL_32, newValue.reg, global);
+                return;
+            }
+
+            compiler.Unsupported("assignment to unknown variable " + variableName);
+        }
+
+        void operator()(const std::unique_ptr<IfStmtNode>& ifStmt){
+            TypedRegister condition = compiler.CompileCondition(ifStmt->condition);
+            size_t jumpToElse = compiler.Emit(Opcode::JUMP_IF_FALSE, condition.reg);
+
+            std::map<std::string, TypedRegister> outerScope = compiler.m_locals;
+
+            for(const auto& stmt : ifStmt->thenBody){
+                compiler.CompileStmt(stmt);
+            }
+            compiler.m_locals = outerScope;
+
+            if(ifStmt->elseBody.empty()){
+                compiler.PatchJump(jumpToElse, compiler.m_function->code.size());
+                return;
+            }
+
+            size_t jumpToEnd = compiler.Emit(Opcode::JUMP);
+            compiler.PatchJump(jumpToElse, compiler.m_function->code.size());
+
+            for(const auto& stmt : ifStmt->elseBody){
+                compiler.CompileStmt(stmt);
+            }
+            compiler.m_locals = outerScope;
+
+            compiler.PatchJump(jumpToEnd, compiler.m_function->code.size());
+        }
+
+        // the jump back to the condition is the back edge the interpreter counts for tiering up
+        void CompileLoop(const std::unique_ptr<ExprNode>& condition, const std::vector<std::unique_ptr<StmtNode>>& body, const std::unique_ptr<AssignmentNode>& step){
+            size_t loopStart = compiler.m_function->code.size();
+            std::optional<size_t> jumpToExit;
+
+            if(condition){
+                TypedRegister conditionValue = compiler.CompileCondition(condition);
+                jumpToExit = compiler.Emit(Opcode::JUMP_IF_FALSE, conditionValue.reg);
+            }
+
+            std::map<std::string, TypedRegister> outerScope = compiler.m_locals;
+
+            for(const auto& stmt : body){
+                compiler.CompileStmt(stmt);
+            }
+            compiler.m_locals = outerScope;
+
+            if(step){
+                (*this)(step);
+            }
+
+            compiler.PatchJump(compiler.Emit(Opcode::JUMP), loopStart);
+
+            if(jumpToExit.has_value()){
+                compiler.PatchJump(jumpToExit.value(), compiler.m_function->code.size());
+            }
+        }
+
+        void operator()(const std::unique_ptr<WhileStmtNode>& whileStmt){
+            CompileLoop(whileStmt->condition, whileStmt->body, nullptr);
+        }
+
+        void operator()(const std::unique_ptr<ForStmtNode>& forStmt){
+            std::map<std::string, TypedRegister> outerScope = compiler.m_locals;
+
+            if(forStmt->init){
+                compiler.CompileStmt(forStmt->init);
+            }
+
+            CompileLoop(forStmt->condition, forStmt->body, forStmt->step);
+            compiler.m_locals = outerScope;
+        }
+
+        void operator()(const std::unique_ptr<ReturnNode>& returnStmt){
+            if(returnStmt->value == nullptr){
+                compiler.Emit(Opcode::RETURN_VOID);
+                return;
+            }
+
+            // a self tail call moves its arguments into the parameter registers and starts over,
+            // like the musttail call of the generator it doesn't grow the stack
+            if(std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(returnStmt->value->var)){
+                const auto& primary = std::get<std::unique_ptr<PrimaryExprNode>>(returnStmt->value->var);
+
+                if(std::holds_alternative<std::unique_ptr<CallExprNode>>(primary->var)){
+                    const auto& call = std::get<std::unique_ptr<CallExprNode>>(primary->var);
+
+                    if(call->callee.value.value() == compiler.m_function->name){
+                        uint16_t function = compiler.m_program.functionIndices.at(compiler.m_function->name);
+                        uint16_t arguments = compiler.CompileArguments(function, call->args);
+
+                        for(uint16_t i = 0; i < call->args.size(); i++){
+                            compiler.Emit(Opcode::MOVE, i, arguments + i);
+                        }
+
+                        compiler.PatchJump(compiler.Emit(Opcode::JUMP), 0);
+                        return;
+                    }
+                }
+            }
+
+            TypedRegister value = compiler.Convert(compiler.CompileExpr(returnStmt->value), compiler.m_function->returnKind);
+            compiler.Emit(Opcode::RETURN, value.reg);
+        }
+
+        void operator()(const std::unique_ptr<ExprStmtNode>& exprStmt){
+            compiler.CompileExpr(exprStmt->expression);
+        }
+    };
+
+    std::visit(StmtVisitor{*this}, stmt->var);
+}
+
+void BytecodeCompiler::CompileFunction(const FunctionNode& function){
+    m_function = &m_program.functions[m_program.functionIndices.at(function.prototype->name.value.value())];
+    m_locals.clear();
+
+    if(!GetValueKind(function.prototype->returnType)){
+        Unsupported("unsupported return type");
+    }
+
+    // the arguments are copied into the first registers by the interpreter
+    for(const ParamNode& param : function.prototype->params){
+        std::optional<ValueKind> kind = GetValueKind(param.type);
+
+        if(!kind || kind == ValueKind::VOID){
+            Unsupported("parameter of unsupported type");
+        }
+
+        m_locals[param.identifier.value.value()] = {NewRegister(), kind.value_or(ValueKind::I32)};
+    }
+
+    m_function->paramCount = function.prototype->params.size();
+
+    for(const auto& stmt : function.body){
+        CompileStmt(stmt);
+    }
+
+    // the generator returns the null value of the return type when the end is reached
+    if(m_function->returnKind == ValueKind::VOID){
+        Emit(Opcode::RETURN_VOID);
+    } else {
+        Emit(Opcode::RETURN, LoadConstant(Slot{}, m_function->returnKind).reg);
+    }
+
+    if(m_function->code.size() > std::numeric_limits<uint32_t>::max()){
+        Unsupported("function too large");
+    }
+
+    m_function = nullptr;
+}
+
+BytecodeProgram BytecodeCompiler::Compile(const std::unique_ptr<ProgNode>& prog){
+    m_program = {};
+
+    // functions and globals get their indices first, so calls can refer to functions further down
+    for(const auto& stmt : prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var)){
+            const auto& function = std::get<std::unique_ptr<FunctionNode>>(stmt->var);
+
+            // generic functions only run through their instantiations
+            if(function->prototype->typeParams.empty() == false){
+                continue;
+            }
+
+            BytecodeFunction bytecode;
+            bytecode.name = function->prototype->name.value.value();
+            bytecode.returnKind = GetValueKind(function->prototype->returnType).value_or(ValueKind::VOID);
+            bytecode.knownSignature = GetValueKind(function->prototype->returnType).has_value();
+
+            for(const ParamNode& param : function->prototype->params){
+                std::optional<ValueKind> kind = GetValueKind(param.type);
+                bytecode.knownSignature = bytecode.knownSignature && kind && kind != ValueKind::VOID;
+                bytecode.paramKinds.push_back(kind.value_or(ValueKind::I32));
+            }
+
+            m_program.functionIndices[bytecode.name] = m_program.functions.size();
+            m_program.functions.push_back(std::move(bytecode));
+        }
+        else if(std::holds_alternative<std::unique_ptr<DeclerationStmtNode>>(stmt->var)){
+            const auto& decleration = std::get<std::unique_ptr<DeclerationStmtNode>>(stmt->var);
+            std::optional<ValueKind> kind = GetValueKind(decleration->type);
+
+            // functions that use a global of an unknown type become unsupported
+            if(!kind || kind == ValueKind::VOID){
+                continue;
+            }
+
+            m_program.globalIndices[decleration->identifier.value.value()] = m_program.globals.size();
+            m_program.globals.push_back({decleration->identifier.value.value(), *kind});
+        }
+    }
+
+    for(const auto& stmt : prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var)){
+            const auto& function = std::get<std::unique_ptr<FunctionNode>>(stmt->var);
+
+            if(function->prototype->typeParams.empty()){
+                CompileFunction(*function);
+            }
+        }
+    }
+
+    return std::move(m_program);
+}
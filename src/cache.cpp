@@ -0,0 +1,474 @@
+#include "cache.hpp"
+#include "diagnostics.hpp"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+ObjectCache::ObjectCache(const std::string& directory, uint64_t maxSize) : m_directory(directory), m_maxSize(maxSize) {
+    if(std::error_code error = llvm::sys::fs::create_directories(m_directory)){
+        GetLLVMErrorStream() << "ERROR: Could not create cache directory " << m_directory << ": " << error.message() << "\n";
+        m_directory.clear();
+    }
+}
+
+bool ObjectCache::IsValid(){
+    return m_directory.empty() == false;
+}
+
+std::string ObjectCache::GetEntryPath(const std::string& key){
+    llvm::SmallString<256> path(m_directory);
+    llvm::sys::path::append(path, key + ".o");
+    return std::string(path);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ObjectCache::Load(const std::string& key){
+    std::string path = GetEntryPath(key);
+    auto object = llvm::MemoryBuffer::getFile(path);
+
+    if(!object){
+        m_misses++;
+        return nullptr;
+    }
+
+    m_hits++;
+
+    // marks the entry as recently used
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+    return std::move(*object);
+}
+
+void ObjectCache::Store(const std::string& key, llvm::StringRef object){
+    llvm::SmallString<256> model(m_directory);
+    llvm::sys::path::append(model, key + "-%%%%%%%%.tmp");
+
+    int fd = -1;
+    llvm::SmallString<256> temporaryPath;
+
+    if(std::error_code error = llvm::sys::fs::createUniqueFile(model, fd, temporaryPath)){
+        GetLLVMErrorStream() << "WARNING: Could not write to the cache: " << error.message() << "\n";
+        return;
+    }
+
+    {
+        llvm::raw_fd_ostream output(fd, true);
+        output << object;
+    }
+
+    if(std::error_code error = llvm::sys::fs::rename(temporaryPath, GetEntryPath(key))){
+        GetLLVMErrorStream() << "WARNING: Could not write to the cache: " << error.message() << "\n";
+        llvm::sys::fs::remove(temporaryPath);
+    }
+}
+
+void ObjectCache::Trim(){
+    struct Entry{
+        std::filesystem::file_time_type lastUse;
+        uint64_t size;
+        std::filesystem::path path;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t totalSize = 0;
+    std::error_code error;
+
+    for(const auto& file : std::filesystem::directory_iterator(m_directory, error)){
+        if(file.path().extension() != ".o"){
+            continue;
+        }
+
+        Entry entry = {file.last_write_time(error), file.file_size(error), file.path()};
+
+        if(error){
+            continue;
+        }
+
+        totalSize += entry.size;
+        entries.push_back(entry);
+    }
+
+    if(totalSize <= m_maxSize){
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){
+        return a.lastUse < b.lastUse;
+    });
+
+    for(const Entry& entry : entries){
+        if(totalSize <= m_maxSize){
+            break;
+        }
+
+        if(std::filesystem::remove(entry.path, error)){
+            totalSize -= entry.size;
+            m_evicted++;
+        }
+    }
+}
+
+void ObjectCache::PrintStats(){
+    uint64_t totalSize = 0;
+    unsigned entries = 0;
+    std::error_code error;
+
+    for(const auto& file : std::filesystem::directory_iterator(m_directory, error)){
+        if(file.path().extension() == ".o"){
+            totalSize += file.file_size(error);
+            entries++;
+        }
+    }
+
+    llvm::errs() << "cache: " << m_hits << " hits, " << m_misses << " misses, " << m_evicted << " evicted, "
+                 << entries << " entries using " << totalSize / 1024 << " KiB of " << m_maxSize / 1024 << " KiB\n";
+}
+
+FunctionHasher::FunctionHasher(const std::map<std::string, const ProtoTypeNode*>& functions, const std::map<std::string, const DeclerationStmtNode*>& globals, bool positions)
+    : m_functions(functions), m_globals(globals), m_positions(positions) {}
+
+// every string is terminated, so "ab" "c" and "a" "bc" hash differently
+void FunctionHasher::HashString(llvm::StringRef text){
+    m_hash.update(text);
+    m_hash.update(llvm::StringRef("\0", 1));
+}
+
+void FunctionHasher::HashToken(const Token& token){
+    HashString(std::to_string(static_cast<int>(token.type)));
+    HashString(token.value.value_or(""));
+
+    if(token.lanes != 0){
+        HashString("lanes " + std::to_string(token.lanes));
+    }
+
+    if(token.arrayLength != 0 || token.isSlice){
+        HashString("array " + std::to_string(token.arrayLength) + " " + std::to_string(token.isSlice));
+    }
+
+    if(token.isPointer){
+        HashString(token.isRestrict ? "restrict pointer" : "pointer");
+    }
+
+    if(token.isAtomic){
+        HashString("atomic");
+    }
+
+    if(m_positions){
+        HashString(std::to_string(token.line) + ":" + std::to_string(token.column));
+    }
+}
+
+void FunctionHasher::HashFields(const std::vector<Token>& fields){
+    HashString("fields " + std::to_string(fields.size()));
+
+    for(const Token& field : fields){
+        HashToken(field);
+    }
+}
+
+void FunctionHasher::HashPrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+    struct PrimaryExprHasher{
+        FunctionHasher& self;
+
+        void operator()(const std::unique_ptr<IntLitNode>& intLit){
+            self.HashString("int " + GetTypeName(intLit->type));
+            self.HashToken(intLit->val);
+        }
+
+        void operator()(const std::unique_ptr<FloatLitNode>& floatLit){
+            self.HashString("float " + GetTypeName(floatLit->type));
+            self.HashToken(floatLit->val);
+        }
+
+        void operator()(const std::unique_ptr<IdentNode>& ident){
+            self.HashString("ident");
+            self.HashToken(ident->val);
+            self.m_identifiers.insert(ident->val.value.value());
+        }
+
+        void operator()(const std::unique_ptr<ExprNode>& innerExpr){
+            self.HashString("paren");
+            self.HashExpr(innerExpr);
+        }
+
+        void operator()(const std::unique_ptr<CallExprNode>& call){
+            self.HashString("call " + std::to_string(call->args.size()));
+            self.HashToken(call->callee);
+            self.m_callees.insert(call->callee.value.value());
+
+            for(const auto& arg : call->args){
+                self.HashExpr(arg);
+            }
+        }
+
+        void operator()(const std::unique_ptr<CastExprNode>& cast){
+            self.HashString("cast");
+            self.HashToken(cast->type);
+            self.HashExpr(cast->expression);
+        }
+
+        // whether the access is checked depends on the code around it, so it is hashed too
+        void operator()(const std::unique_ptr<IndexExprNode>& index){
+            self.HashString(std::string("index ") + (index->boundsCheck ? "checked" : "unchecked"));
+            self.HashToken(index->identifier);
+            self.HashExpr(index->index);
+            self.HashFields(index->fields);
+            self.m_identifiers.insert(index->identifier.value.value());
+        }
+
+        void operator()(const std::unique_ptr<AddressOfExprNode>& addressOf){
+            self.HashString(std::string("address of ") + (addressOf->index ? (addressOf->boundsCheck ? "checked" : "unchecked") : "variable"));
+            self.HashToken(addressOf->identifier);
+
+            if(addressOf->index){
+                self.HashExpr(addressOf->index);
+            }
+
+            self.HashFields(addressOf->fields);
+            self.m_identifiers.insert(addressOf->identifier.value.value());
+        }
+
+        void operator()(const std::unique_ptr<FieldExprNode>& field){
+            self.HashString("field");
+            self.HashToken(field->identifier);
+            self.HashFields(field->fields);
+            self.m_identifiers.insert(field->identifier.value.value());
+        }
+    };
+
+    std::visit(PrimaryExprHasher{*this}, primaryExpr->var);
+}
+
+void FunctionHasher::HashExpr(const std::unique_ptr<ExprNode>& expr){
+    struct ExprHasher{
+        FunctionHasher& self;
+
+        void operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+            self.HashPrimaryExpr(primaryExpr);
+        }
+
+        void operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+            self.HashString("binop " + std::to_string(static_cast<int>(binExpr->type)));
+            self.HashExpr(binExpr->lhs);
+            self.HashExpr(binExpr->rhs);
+        }
+
+        void operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
+            self.HashString("compare " + std::to_string(static_cast<int>(conditionalExpr->type)));
+            self.HashExpr(conditionalExpr->lhs);
+            self.HashExpr(conditionalExpr->rhs);
+        }
+    };
+
+    std::visit(ExprHasher{*this}, expr->var);
+}
+
+void FunctionHasher::HashStmt(const std::unique_ptr<StmtNode>& stmt){
+    struct StmtHasher{
+        FunctionHasher& self;
+
+        void operator()(const std::unique_ptr<CompoundStmtNode>& compoundStmt){
+            self.HashString("compound " + std::to_string(compoundStmt->body.size()));
+
+            for(const auto& stmt : compoundStmt->body){
+                self.HashStmt(stmt);
+            }
+        }
+
+        void operator()(const std::unique_ptr<DeclerationStmtNode>& decleration){
+            self.HashString("decleration");
+            self.HashToken(decleration->type);
+            self.HashToken(decleration->identifier);
+            self.HashString(decleration->expression.has_value() ? "=" : "");
+
+            if(decleration->expression.has_value()){
+                self.HashExpr(decleration->expression.value());
+            }
+        }
+
+        void operator()(const std::unique_ptr<FunctionNode>&){
+            self.HashString("function");
+        }
+
+        void operator()(const std::unique_ptr<AssignmentNode>& assignment){
+            self.HashString("assignment");
+            self.HashToken(assignment->identifier);
+            self.HashExpr(assignment->expression);
+
+            if(assignment->index){
+                self.HashString(std::string("element ") + (assignment->boundsCheck ? "checked " : "unchecked "));
+                self.HashExpr(assignment->index);
+            }
+
+            self.HashString(assignment->compoundType.has_value() ? std::to_string(static_cast<int>(assignment->compoundType.value())) : "");
+            self.HashFields(assignment->fields);
+            self.m_identifiers.insert(assignment->identifier.value.value());
+        }
+
+        void operator()(const std::unique_ptr<IfStmtNode>& ifStmt){
+            self.HashString("if " + std::to_string(ifStmt->thenBody.size()) + " " + std::to_string(ifStmt->elseBody.size()));
+            self.HashExpr(ifStmt->condition);
+
+            for(const auto& stmt : ifStmt->thenBody){
+                self.HashStmt(stmt);
+            }
+
+            for(const auto& stmt : ifStmt->elseBody){
+                self.HashStmt(stmt);
+            }
+        }
+
+        void operator()(const std::unique_ptr<ReturnNode>& returnStmt){
+            self.HashString(returnStmt->value ? "return value" : "return");
+
+            if(returnStmt->value){
+                self.HashExpr(returnStmt->value);
+            }
+        }
+
+        void operator()(const std::unique_ptr<ExprStmtNode>& exprStmt){
+            self.HashString("expression");
+            self.HashExpr(exprStmt->expression);
+        }
+
+        void HashLoop(const std::unique_ptr<ExprNode>& condition, const std::vector<std::unique_ptr<StmtNode>>& body, const std::unique_ptr<AssignmentNode>& step, const LoopHints& hints){
+            // the hints change the generated code as much as the statements do
+            self.HashString("loop " + std::to_string(body.size())
+                + " vectorize " + std::to_string(hints.vectorize) + " " + std::to_string(hints.vectorizeWidth)
+                + " unroll " + std::to_string(hints.unroll) + " " + std::to_string(hints.unrollCount)
+                + " nounroll " + std::to_string(hints.noUnroll) + " unchecked " + std::to_string(hints.unchecked));
+
+            self.HashString(condition ? "condition" : "");
+
+            if(condition){
+                self.HashExpr(condition);
+            }
+
+            self.HashString(step ? "step" : "");
+
+            if(step){
+                (*this)(step);
+            }
+
+            for(const auto& stmt : body){
+                self.HashStmt(stmt);
+            }
+        }
+
+        void operator()(const std::unique_ptr<WhileStmtNode>& whileStmt){
+            self.HashString("while");
+            HashLoop(whileStmt->condition, whileStmt->body, nullptr, whileStmt->hints);
+        }
+
+        void operator()(const std::unique_ptr<ForStmtNode>& forStmt){
+            self.HashString(forStmt->init ? "for init" : "for");
+
+            if(forStmt->init){
+                self.HashStmt(forStmt->init);
+            }
+
+            HashLoop(forStmt->condition, forStmt->body, forStmt->step, forStmt->hints);
+        }
+    };
+
+    if(m_positions){
+        HashString(std::to_string(stmt->line) + ":" + std::to_string(stmt->column));
+    }
+
+    std::visit(StmtHasher{*this}, stmt->var);
+}
+
+void FunctionHasher::HashGlobal(const DeclerationStmtNode& global){
+    HashString("global");
+    HashToken(global.type);
+    HashToken(global.identifier);
+    // constant globals are folded into the functions that read them
+    HashString(global.isWritten ? "written" : "constant");
+
+    if(global.expression.has_value()){
+        HashExpr(global.expression.value());
+    }
+}
+
+void FunctionHasher::HashPrototype(const ProtoTypeNode& prototype){
+    HashToken(prototype.name);
+    HashToken(prototype.returnType);
+    HashString("params " + std::to_string(prototype.params.size()));
+
+    for(const ParamNode& param : prototype.params){
+        HashToken(param.type);
+        HashToken(param.identifier);
+    }
+}
+
+std::string FunctionHasher::HashFunction(const FunctionNode& function, const std::string& configuration){
+    m_hash = llvm::MD5();
+    m_callees.clear();
+    m_identifiers.clear();
+
+    HashString(configuration);
+    HashPrototype(*function.prototype);
+
+    const FastMathAttribute& fastMath = function.fastMath;
+    HashString(std::string("fastmath ") + char('0' + fastMath.reassoc) + char('0' + fastMath.contract) + char('0' + fastMath.arcp)
+        + char('0' + fastMath.nnan) + char('0' + fastMath.ninf) + char('0' + fastMath.nsz) + char('0' + fastMath.afn));
+    HashString(function.unchecked ? "unchecked" : "checked");
+
+    HashString("body " + std::to_string(function.body.size()));
+
+    for(const auto& stmt : function.body){
+        HashStmt(stmt);
+    }
+
+    // calls only depend on the prototype of the callee, never on its body
+    for(const std::string& callee : m_callees){
+        HashString("callee");
+
+        if(m_functions.find(callee) == m_functions.end()){
+            HashString(callee);
+            continue;
+        }
+
+        HashPrototype(*m_functions.at(callee));
+    }
+
+    // identifiers that aren't globals are locals and already part of the body. initializers of
+    // globals can refer to other globals, those are followed as well
+    std::set<std::string> hashedGlobals;
+    std::vector<std::string> pending(m_identifiers.begin(), m_identifiers.end());
+
+    while(pending.empty() == false){
+        std::string name = pending.back();
+        pending.pop_back();
+
+        if(m_globals.find(name) == m_globals.end() || hashedGlobals.insert(name).second == false){
+            continue;
+        }
+
+        m_identifiers.clear();
+        HashGlobal(*m_globals.at(name));
+        pending.insert(pending.end(), m_identifiers.begin(), m_identifiers.end());
+    }
+
+    llvm::MD5::MD5Result result;
+    m_hash.final(result);
+    return std::string(result.digest());
+}
+
+std::string FunctionHasher::HashGlobals(const std::string& configuration){
+    m_hash = llvm::MD5();
+
+    HashString(configuration);
+    HashString("globals");
+
+    for(const auto& [name, global] : m_globals){
+        HashGlobal(*global);
+    }
+
+    llvm::MD5::MD5Result result;
+    m_hash.final(result);
+    return std::string(result.digest());
+}
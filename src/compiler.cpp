@@ -0,0 +1,475 @@
+#include "compiler.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "analysis.hpp"
+#include "optimizer.hpp"
+#include "cache.hpp"
+#include "diagnostics.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/Error.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/Triple.h"
+#else
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/Host.h"
+#endif
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// runs task(0) ... task(count - 1) on up to `threads` threads. every index runs exactly once,
+// so results only depend on the index and never on scheduling. the first exception thrown by a
+// task is rethrown on the calling thread once all workers are done
+static void ParallelFor(unsigned count, unsigned threads, const std::function<void(unsigned)>& task){
+    if(threads <= 1 || count <= 1){
+        for(unsigned i = 0; i < count; i++){
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<unsigned> next = 0;
+    std::vector<std::thread> workers;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    // every worker reports into a buffer of its own, the stream of the caller is only written under the lock
+    std::ostream& errorStream = GetErrorStream();
+
+    for(unsigned t = 0; t < std::min(threads, count); t++){
+        workers.emplace_back([&]{
+            std::ostringstream errors;
+            ErrorStreamScope scope(errors);
+
+            try{
+                for(unsigned i = next++; i < count; i = next++){
+                    task(i);
+                }
+            }
+            catch(...){
+                std::lock_guard<std::mutex> lock(errorMutex);
+
+                if(error == nullptr){
+                    error = std::current_exception();
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(errorMutex);
+            errorStream << errors.str();
+        });
+    }
+
+    for(auto& worker : workers){
+        worker.join();
+    }
+
+    if(error != nullptr){
+        std::rethrow_exception(error);
+    }
+}
+
+// splits the function definitions into contiguous groups in source order. the partition only
+// depends on the number of units, never on the number of threads
+static std::vector<CodegenUnit> PartitionProgram(const std::unique_ptr<ProgNode>& prog, unsigned unitCount){
+    std::vector<const FunctionNode*> functions;
+
+    for(const auto& stmt : prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var)){
+            const auto& function = std::get<std::unique_ptr<FunctionNode>>(stmt->var);
+
+            if(function->prototype->typeParams.empty()){
+                functions.push_back(function.get());
+            }
+        }
+    }
+
+    std::vector<CodegenUnit> units(unitCount);
+
+    for(unsigned i = 0; i < unitCount; i++){
+        units[i].index = i;
+
+        size_t begin = functions.size() * i / unitCount;
+        size_t end = functions.size() * (i + 1) / unitCount;
+
+        units[i].functions.insert(functions.begin() + begin, functions.begin() + end);
+    }
+
+    return units;
+}
+
+void CompilerPool::Acquire(OptLevel level, const std::string& cpu, std::unique_ptr<Emitter>& emitter, std::unique_ptr<Optimizer>& optimizer){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Target>& targets = m_targets[{level, cpu}];
+
+        if(targets.empty() == false){
+            emitter = std::move(targets.back().emitter);
+            optimizer = std::move(targets.back().optimizer);
+            targets.pop_back();
+            return;
+        }
+
+        m_created++;
+    }
+
+    // building the pipeline is the slow part, so it happens outside of the lock
+    emitter = std::make_unique<Emitter>(level, cpu);
+    optimizer = std::make_unique<Optimizer>(level, emitter->GetTargetMachine());
+}
+
+void CompilerPool::Release(OptLevel level, const std::string& cpu, std::unique_ptr<Emitter> emitter, std::unique_ptr<Optimizer> optimizer){
+    // a target that failed to be created stays broken, don't hand it out again
+    if(emitter == nullptr || optimizer == nullptr || emitter->GetTargetMachine() == nullptr){
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_targets[{level, cpu}].push_back({std::move(emitter), std::move(optimizer)});
+}
+
+unsigned CompilerPool::GetCreatedCount(){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_created;
+}
+
+CompilerInstance::CompilerInstance(const Options& options, CompilerPool* pool) : m_options(options), m_pool(pool) {}
+
+CompilerInstance::~CompilerInstance(){
+    ReleaseTargets(m_units);
+}
+
+void CompilerInstance::AcquireTarget(CompiledUnit& unit){
+    if(m_pool != nullptr){
+        m_pool->Acquire(m_options.optLevel, m_options.cpu, unit.emitter, unit.optimizer);
+        return;
+    }
+
+    unit.emitter = std::make_unique<Emitter>(m_options.optLevel, m_options.cpu);
+
+    // the JIT optimizes functions itself, building the pipeline would be wasted
+    if(m_options.mode != Mode::Run){
+        unit.optimizer = std::make_unique<Optimizer>(m_options.optLevel, unit.emitter->GetTargetMachine());
+    }
+}
+
+void CompilerInstance::ReleaseTargets(std::vector<CompiledUnit>& units){
+    if(m_pool == nullptr){
+        return;
+    }
+
+    for(CompiledUnit& unit : units){
+        // the module may still be printed by the caller, but it doesn't refer to the target machine
+        if(unit.emitter != nullptr){
+            m_pool->Release(m_options.optLevel, m_options.cpu, std::move(unit.emitter), std::move(unit.optimizer));
+        }
+    }
+}
+
+bool CompilerInstance::Compile(const std::string& source){
+    ReleaseTargets(m_units);
+    m_units.clear();
+
+    // the parser and generator throw when they abort the compilation
+    try{
+        Lexer lex(source);
+        std::vector<Token> tokens = lex.lex();
+
+        Parser parser(tokens);
+        auto prog = parser.Parse();
+
+        Analyzer analyzer;
+
+        if(analyzer.Analyze(prog) == false){
+            return false;
+        }
+
+        m_prog = std::move(prog);
+
+        if(UsesObjectCache(m_options)){
+            return CompileCached();
+        }
+
+        return CompileUnits();
+    }
+    catch(const CompilationAborted&){
+        return false;
+    }
+}
+
+bool CompilerInstance::CompileUnits(){
+    m_units.resize(m_options.codegenUnits);
+
+    std::vector<CodegenUnit> partition;
+
+    if(m_options.codegenUnits > 1){
+        partition = PartitionProgram(m_prog, m_options.codegenUnits);
+    }
+
+    // every unit has its own context and target machine, so units don't share any LLVM state
+    // and the program is only read while they are generated
+    ParallelFor(m_options.codegenUnits, m_options.threads, [&](unsigned index){
+        CompiledUnit& unit = m_units[index];
+        AcquireTarget(unit);
+
+        Generator generator(unit.emitter->GetTargetMachine(), m_options.tiered);
+
+        if(m_options.debugInfo){
+            generator.EnableDebugInfo(m_options.inputPath.empty() ? "<source>" : m_options.inputPath);
+        }
+
+        if(m_options.checkedArithmetic){
+            generator.EnableCheckedArithmetic();
+        }
+
+        if(m_options.fastMath){
+            generator.EnableFastMath();
+        }
+
+        generator.Generate(m_prog, partition.empty() ? nullptr : &partition[index]);
+
+        unit.generated = generator.TakeModule();
+
+        // the JIT optimizes every function lazily when it is first called
+        if(m_options.mode != Mode::Run){
+            unit.optimizer->Optimize(*unit.generated.module);
+        }
+    });
+
+    return true;
+}
+
+bool CompilerInstance::CompileCached(){
+    ObjectCache cache(m_options.cacheDir, uint64_t(m_options.cacheSizeMiB) << 20);
+
+    if(cache.IsValid() == false){
+        return false;
+    }
+
+    std::map<std::string, const ProtoTypeNode*> prototypes;
+    std::map<std::string, const DeclerationStmtNode*> globals;
+    std::vector<const FunctionNode*> functions;
+
+    for(const auto& stmt : m_prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var)){
+            const auto& function = std::get<std::unique_ptr<FunctionNode>>(stmt->var);
+
+            if(function->prototype->typeParams.empty()){
+                prototypes[function->prototype->name.value.value()] = function->prototype.get();
+                functions.push_back(function.get());
+            }
+        }
+        else if(std::holds_alternative<std::unique_ptr<DeclerationStmtNode>>(stmt->var)){
+            const auto& decleration = std::get<std::unique_ptr<DeclerationStmtNode>>(stmt->var);
+            globals[decleration->identifier.value.value()] = decleration.get();
+        }
+    }
+
+    std::vector<CompiledUnit> host(1);
+    AcquireTarget(host.front());
+
+    llvm::TargetMachine* targetMachine = host.front().emitter->GetTargetMachine();
+
+    if(targetMachine == nullptr){
+        return false;
+    }
+
+    // everything besides the source that changes the generated code. bump the version when the
+    // generator changes what it emits for the same source
+    std::string configuration = "xd object cache 6;" LLVM_VERSION_STRING ";"
+        + std::to_string(static_cast<int>(m_options.optLevel)) + ";"
+        + targetMachine->getTargetTriple().str() + ";"
+        + targetMachine->getTargetCPU().str() + ";"
+        + (m_options.checkedArithmetic ? "checked;" : "")
+        + (m_options.fastMath ? "fast-math;" : "")
+        + (m_options.debugInfo ? "-g " + m_options.inputPath : "");
+
+    // the layout of every struct is part of every key, functions only mention the structs they use by name
+    for(const auto& structNode : m_prog->structs){
+        const StructLayout& layout = structNode->layout;
+
+        configuration += "struct " + structNode->name.value.value() + " " + std::to_string(layout.packed) + std::to_string(layout.cachelinePad)
+            + std::to_string(layout.soa) + " " + std::to_string(layout.align) + " {";
+
+        for(const StructFieldNode& field : structNode->fields){
+            configuration += GetTypeName(field.type.type) + " " + field.type.value.value_or("") + " " + std::to_string(field.type.lanes)
+                + (field.type.isAtomic ? " atomic " : " ") + field.identifier.value.value() + ";";
+        }
+
+        configuration += "};";
+    }
+
+    ReleaseTargets(host);
+
+    // unit 0 defines the globals, every function gets a unit of its own
+    std::vector<CodegenUnit> partition(functions.size() + 1);
+    m_units.resize(partition.size());
+
+    for(size_t i = 0; i < partition.size(); i++){
+        partition[i].index = i;
+
+        if(i > 0){
+            partition[i].functions.insert(functions[i - 1]);
+        }
+    }
+
+    std::atomic<bool> compiled = true;
+
+    ParallelFor(m_units.size(), m_options.threads, [&](unsigned index){
+        CompiledUnit& unit = m_units[index];
+        FunctionHasher hasher(prototypes, globals, m_options.debugInfo);
+
+        std::string key = index == 0 ? hasher.HashGlobals(configuration) : hasher.HashFunction(*functions[index - 1], configuration);
+
+        // identifiers can't contain dots, so no function clashes with the globals
+        unit.name = index == 0 ? "xd.globals.o" : functions[index - 1]->prototype->name.value.value() + ".o";
+        unit.object = cache.Load(key);
+
+        if(unit.object != nullptr){
+            return;
+        }
+
+        AcquireTarget(unit);
+
+        Generator generator(unit.emitter->GetTargetMachine());
+
+        if(m_options.debugInfo){
+            generator.EnableDebugInfo(m_options.inputPath);
+        }
+
+        if(m_options.checkedArithmetic){
+            generator.EnableCheckedArithmetic();
+        }
+
+        if(m_options.fastMath){
+            generator.EnableFastMath();
+        }
+
+        generator.Generate(m_prog, &partition[index]);
+        unit.generated = generator.TakeModule();
+
+        unit.optimizer->Optimize(*unit.generated.module);
+
+        llvm::SmallVector<char, 0> object;
+
+        if(unit.emitter->EmitObject(*unit.generated.module, object) == false){
+            compiled = false;
+            return;
+        }
+
+        llvm::StringRef objectData(object.data(), object.size());
+        cache.Store(key, objectData);
+        unit.object = llvm::MemoryBuffer::getMemBufferCopy(objectData, unit.name);
+    });
+
+    cache.Trim();
+
+    if(m_options.cacheStats){
+        cache.PrintStats();
+    }
+
+    return compiled;
+}
+
+// writes the objects of the units as members of a static library
+static bool WriteArchive(const std::string& path, const std::vector<CompiledUnit>& units){
+    std::vector<llvm::NewArchiveMember> members;
+
+    for(const CompiledUnit& unit : units){
+        llvm::NewArchiveMember member(unit.object->getMemBufferRef());
+        member.MemberName = unit.name;
+        members.push_back(std::move(member));
+    }
+
+    llvm::object::Archive::Kind kind = llvm::Triple(llvm::sys::getProcessTriple()).isOSDarwin()
+        ? llvm::object::Archive::K_DARWIN
+        : llvm::object::Archive::K_GNU;
+
+#if LLVM_VERSION_MAJOR >= 18
+    llvm::Error error = llvm::writeArchive(path, members, llvm::SymtabWritingMode::NormalSymtab, kind, true, false);
+#else
+    llvm::Error error = llvm::writeArchive(path, members, true, kind, true, false);
+#endif
+
+    if(error){
+        GetLLVMErrorStream() << "ERROR: Could not write " << path << ": " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool CompilerInstance::CompileFile(){
+    std::ifstream file(m_options.inputPath);
+
+    if(!file){
+        GetErrorStream() << "Error: Could not open source file " << m_options.inputPath << std::endl;
+        return false;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    return Compile(buffer.str());
+}
+
+bool CompilerInstance::Emit(){
+    if(m_units.empty()){
+        return false;
+    }
+
+    std::string outputPath = GetOutputPath(m_options);
+
+    if(UsesObjectCache(m_options)){
+        return WriteArchive(outputPath, m_units);
+    }
+
+    // IR printed to stderr has to come out in unit order
+    if(m_units.size() == 1 || outputPath.empty()){
+        for(auto& unit : m_units){
+            if(unit.emitter->EmitFile(*unit.generated.module, outputPath, m_options.outputType) == false){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::atomic<bool> emitted = true;
+
+    ParallelFor(m_units.size(), m_options.threads, [&](unsigned index){
+        CompiledUnit& unit = m_units[index];
+
+        if(unit.emitter->EmitFile(*unit.generated.module, GetUnitOutputPath(outputPath, index), m_options.outputType) == false){
+            emitted = false;
+        }
+    });
+
+    return emitted;
+}
+
+const std::unique_ptr<ProgNode>& CompilerInstance::GetProgram() const{
+    return m_prog;
+}
+
+GeneratedModule CompilerInstance::TakeModule(){
+    if(m_units.size() != 1){
+        return {};
+    }
+
+    return std::move(m_units.front().generated);
+}
+
+std::vector<GeneratedModule> CompilerInstance::TakeModules(){
+    std::vector<GeneratedModule> modules;
+
+    for(auto& unit : m_units){
+        modules.push_back(std::move(unit.generated));
+    }
+
+    return modules;
+}
@@ -0,0 +1,44 @@
+#include "diagnostics.hpp"
+#include <iostream>
+
+static thread_local std::ostream* s_errorStream = nullptr;
+
+// forwards to the error stream of the thread at the time of every write
+class LLVMErrorStream : public llvm::raw_ostream{
+    private:
+        uint64_t m_position = 0;
+
+        void write_impl(const char* data, size_t size) override{
+            GetErrorStream().write(data, size);
+            m_position += size;
+        }
+
+        uint64_t current_pos() const override{
+            return m_position;
+        }
+
+    public:
+        // unbuffered, so nothing is left behind when the thread switches streams
+        LLVMErrorStream() : llvm::raw_ostream(true) {}
+};
+
+void AbortCompilation(){
+    throw CompilationAborted{};
+}
+
+std::ostream& GetErrorStream(){
+    return s_errorStream != nullptr ? *s_errorStream : std::cerr;
+}
+
+llvm::raw_ostream& GetLLVMErrorStream(){
+    static thread_local LLVMErrorStream stream;
+    return stream;
+}
+
+ErrorStreamScope::ErrorStreamScope(std::ostream& stream) : m_previous(s_errorStream) {
+    s_errorStream = &stream;
+}
+
+ErrorStreamScope::~ErrorStreamScope(){
+    s_errorStream = m_previous;
+}
@@ -0,0 +1,143 @@
+#include "emitter.hpp"
+#include "diagnostics.hpp"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Host.h"
+#else
+#include "llvm/Support/Host.h"
+#endif
+#include <mutex>
+
+void InitializeTargets(){
+    static std::once_flag initialized;
+
+    std::call_once(initialized, []{
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
+}
+
+CodeGenOptLevel GetCodeGenOptLevel(OptLevel level){
+#if LLVM_VERSION_MAJOR >= 18
+    switch(level){
+        case OptLevel::O0:
+            return llvm::CodeGenOptLevel::None;
+        case OptLevel::O3:
+            return llvm::CodeGenOptLevel::Aggressive;
+        default:
+            return llvm::CodeGenOptLevel::Default;
+    }
+#else
+    switch(level){
+        case OptLevel::O0:
+            return llvm::CodeGenOpt::None;
+        case OptLevel::O3:
+            return llvm::CodeGenOpt::Aggressive;
+        default:
+            return llvm::CodeGenOpt::Default;
+    }
+#endif
+}
+
+Emitter::Emitter(OptLevel level, const std::string& cpu){
+    InitializeTargets();
+
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+
+    if(target == nullptr){
+        GetLLVMErrorStream() << "ERROR: Could not find target for " << triple << ": " << error << "\n";
+        return;
+    }
+
+    std::string cpuName = cpu == "native" ? llvm::sys::getHostCPUName().str() : cpu;
+
+    CodeGenOptLevel codeGenLevel = GetCodeGenOptLevel(level);
+
+    llvm::TargetOptions targetOptions;
+
+#if LLVM_VERSION_MAJOR >= 21
+    llvm::TargetMachine* targetMachine = target->createTargetMachine(llvm::Triple(triple), cpuName, "", targetOptions, llvm::Reloc::PIC_, std::nullopt, codeGenLevel);
+#else
+    llvm::TargetMachine* targetMachine = target->createTargetMachine(triple, cpuName, "", targetOptions, llvm::Reloc::PIC_, llvm::None, codeGenLevel);
+#endif
+
+    m_targetMachine.reset(targetMachine);
+}
+
+llvm::TargetMachine* Emitter::GetTargetMachine(){
+    return m_targetMachine.get();
+}
+
+bool Emitter::EmitFile(llvm::Module& module, const std::string& path, OutputType type){
+    if(type == OutputType::IR && path.empty()){
+        module.print(llvm::errs(), nullptr);
+        return true;
+    }
+
+    std::error_code errorCode;
+    llvm::raw_fd_ostream output(path, errorCode, type == OutputType::IR ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+
+    if(errorCode){
+        GetLLVMErrorStream() << "ERROR: Could not open " << path << ": " << errorCode.message() << "\n";
+        return false;
+    }
+
+    switch(type){
+        case OutputType::IR:
+            module.print(output, nullptr);
+            return true;
+
+        case OutputType::Bitcode:
+            llvm::WriteBitcodeToFile(module, output);
+            return true;
+
+        default:
+            break;
+    }
+
+    if(EmitCode(module, output, type) == false){
+        return false;
+    }
+
+    output.flush();
+    return true;
+}
+
+bool Emitter::EmitObject(llvm::Module& module, llvm::SmallVectorImpl<char>& object){
+    llvm::raw_svector_ostream output(object);
+    return EmitCode(module, output, OutputType::Object);
+}
+
+bool Emitter::EmitCode(llvm::Module& module, llvm::raw_pwrite_stream& output, OutputType type){
+    if(m_targetMachine == nullptr){
+        GetLLVMErrorStream() << "ERROR: No target machine available to emit " << module.getModuleIdentifier() << "\n";
+        return false;
+    }
+
+#if LLVM_VERSION_MAJOR >= 18
+    llvm::CodeGenFileType fileType = type == OutputType::Assembly ? llvm::CodeGenFileType::AssemblyFile : llvm::CodeGenFileType::ObjectFile;
+#else
+    llvm::CodeGenFileType fileType = type == OutputType::Assembly ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
+#endif
+
+    llvm::legacy::PassManager codeGenPasses;
+
+    if(m_targetMachine->addPassesToEmitFile(codeGenPasses, output, nullptr, fileType)){
+        GetLLVMErrorStream() << "ERROR: Target machine can't emit this file type\n";
+        return false;
+    }
+
+    codeGenPasses.run(module);
+    return true;
+}
@@ -1,60 +1,1101 @@
 #include "generator.hpp"
+#include "diagnostics.hpp"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CallingConv.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h" 
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 #include <algorithm>
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 
-std::unique_ptr<llvm::LLVMContext> TheContext;
-std::unique_ptr<llvm::IRBuilder<>> Builder;
-std::unique_ptr<llvm::Module> TheModule;
+static llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Function *TheFunction, llvm::Type * Type, llvm::StringRef VarName) {
+    if (!TheFunction) return nullptr;
+    llvm::IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
+    return TmpB.CreateAlloca(Type, nullptr, VarName);
+}
+
+void Generator::InitializeModule(){
+    m_context = std::make_unique<llvm::LLVMContext>();
+    m_module = std::make_unique<llvm::Module>("XD Compiler", *m_context);
+    m_builder = std::make_unique<llvm::IRBuilder<>>(*m_context);
+
+    m_globalValues.clear();
+    m_structs.clear();
+    m_tbaaRoot = nullptr;
+    m_tbaaTags.clear();
+    m_functionProtos.clear();
+    m_namedValues.clear();
+    m_currentFunc = nullptr;
+
+    m_debugBuilder.reset();
+    m_debugFile = nullptr;
+    m_debugFunction = nullptr;
+
+    if(m_debugSourcePath.empty()){
+        return;
+    }
+
+    llvm::SmallString<256> absolutePath(m_debugSourcePath);
+    llvm::sys::fs::make_absolute(absolutePath);
+
+    m_debugBuilder = std::make_unique<llvm::DIBuilder>(*m_module);
+    m_debugFile = m_debugBuilder->createFile(llvm::sys::path::filename(absolutePath), llvm::sys::path::parent_path(absolutePath));
+
+    // DWARF has no language code for XD, C is the closest for debuggers and profilers
+    m_debugBuilder->createCompileUnit(
+        llvm::dwarf::DW_LANG_C, m_debugFile, "xd", false, "", 0, "",
+        llvm::DICompileUnit::DebugEmissionKind::LineTablesOnly
+    );
+
+    m_module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+}
+
+void Generator::EnableDebugInfo(const std::string& sourcePath){
+    m_debugSourcePath = sourcePath;
+}
+
+void Generator::EnableCheckedArithmetic(){
+    m_checkedArithmetic = true;
+}
+
+void Generator::EnableFastMath(){
+    m_fastMath = true;
+}
+
+void Generator::SetDebugLocation(unsigned line, unsigned column){
+    if(m_debugFunction == nullptr || line == 0){
+        return;
+    }
+
+    m_builder->SetCurrentDebugLocation(llvm::DILocation::get(*m_context, line, column, m_debugFunction));
+}
+
+llvm::Type* Generator::GetTypeFromToken(TokenType type) {
+    switch(type){
+        case TokenType::I8:
+        case TokenType::U8:
+        case TokenType::I16:
+        case TokenType::U16:
+        case TokenType::INT:
+        case TokenType::UINT:
+        case TokenType::I64:
+        case TokenType::U64:
+            return llvm::Type::getIntNTy(*m_context, GetTypeBits(type));
+        case TokenType::FLOAT:
+            return llvm::Type::getFloatTy(*m_context);
+        case TokenType::F64:
+            return llvm::Type::getDoubleTy(*m_context);
+        case TokenType::VOID:
+            return llvm::Type::getVoidTy(*m_context);
+        default:
+            GetLLVMErrorStream() << "DEBUG: Unhandled TokenType (" << (int)type << ") in GetTypeFromToken.\n";
+            return nullptr;
+    }
+}
+
+static llvm::Type* GetPointerType(llvm::Type* elementType){
+#if LLVM_VERSION_MAJOR >= 15
+    return llvm::PointerType::get(elementType->getContext(), 0);
+#else
+    return llvm::PointerType::getUnqual(elementType);
+#endif
+}
+
+llvm::Type* Generator::GetTypeFromToken(const Token& type){
+    llvm::Type* elementType = nullptr;
+
+    if(type.type == TokenType::IDENT){
+        if(m_structs.find(type.value.value()) == m_structs.end()){
+            GetLLVMErrorStream() << "ERROR: Unknown struct " << type.value.value() << "\n";
+            return nullptr;
+        }
+
+        elementType = m_structs.at(type.value.value()).type;
+    } else {
+        elementType = GetTypeFromToken(type.type);
+    }
+
+    if(type.lanes != 0 && elementType != nullptr){
+        elementType = llvm::FixedVectorType::get(elementType, type.lanes);
+    }
+
+    if(type.isPointer && elementType != nullptr){
+        return GetPointerType(elementType);
+    }
+
+    if(type.isSlice && elementType != nullptr){
+        return GetSliceType(elementType);
+    }
+
+    // an array of a @soa struct is a struct of one array per field
+    if(type.arrayLength != 0 && elementType != nullptr){
+        const StructInfo* info = GetStructInfo(elementType);
+
+        if(info != nullptr && info->soa){
+            std::vector<llvm::Type*> arrays;
+
+            for(llvm::Type* field : info->type->elements()){
+                arrays.push_back(llvm::ArrayType::get(field, type.arrayLength));
+            }
+
+            return llvm::StructType::get(*m_context, arrays);
+        }
+
+        return llvm::ArrayType::get(elementType, type.arrayLength);
+    }
+
+    return elementType;
+}
+
+llvm::Type* Generator::GetElementType(const Token& type){
+    if(type.arrayLength == 0 && type.isSlice == false && type.isPointer == false){
+        return nullptr;
+    }
+
+    Token element = type;
+    element.arrayLength = 0;
+    element.isSlice = false;
+    element.isPointer = false;
+    element.isRestrict = false;
+    return GetTypeFromToken(element);
+}
+
+llvm::StructType* Generator::GetSliceType(llvm::Type* elementType){
+    std::vector<llvm::Type*> fields;
+    const StructInfo* info = GetStructInfo(elementType);
+
+    if(info != nullptr && info->soa){
+        for(llvm::Type* field : info->type->elements()){
+            fields.push_back(GetPointerType(field));
+        }
+    } else {
+        fields.push_back(GetPointerType(elementType));
+    }
+
+    fields.push_back(llvm::Type::getInt64Ty(*m_context));
+    return llvm::StructType::get(*m_context, fields);
+}
+
+// 64 bytes on x86 and most arm cores. @cacheline_pad with a larger @align uses lines of that size
+static constexpr uint64_t CacheLineSize = 64;
+
+void Generator::GenStruct(const StructNode& structNode){
+    const llvm::DataLayout& layout = m_module->getDataLayout();
+    const StructLayout& attributes = structNode.layout;
+
+    // a field that is an @align or @cacheline_pad struct keeps the alignment of that struct
+    auto alignmentOf = [&](const StructFieldNode* field){
+        llvm::Type* type = GetTypeFromToken(field->type);
+        const StructInfo* info = GetStructInfo(type);
+        return std::max<uint64_t>(layout.getABITypeAlign(type).value(), info != nullptr ? info->alignment.value() : 1);
+    };
+
+    std::vector<const StructFieldNode*> order;
+    // the alignment LLVM gives the struct and the one its fields need
+    uint64_t naturalAlignment = 1;
+    uint64_t fieldAlignment = 1;
+
+    for(const StructFieldNode& field : structNode.fields){
+        order.push_back(&field);
+
+        // packed fields are never aligned, so the struct itself is only aligned by @align
+        if(attributes.packed == false){
+            naturalAlignment = std::max<uint64_t>(naturalAlignment, layout.getABITypeAlign(GetTypeFromToken(field.type)).value());
+            fieldAlignment = std::max(fieldAlignment, alignmentOf(&field));
+        }
+    }
+
+    // every size is a multiple of its alignment, so with the most aligned fields first no field
+    // needs padding in front of it. fields of the same alignment keep their order
+    if(attributes.packed == false){
+        std::stable_sort(order.begin(), order.end(), [&](const StructFieldNode* a, const StructFieldNode* b){
+            return alignmentOf(a) > alignmentOf(b);
+        });
+    }
+
+    uint64_t line = attributes.cachelinePad ? std::max({CacheLineSize, uint64_t(attributes.align), fieldAlignment}) : 0;
+    uint64_t alignment = std::max({uint64_t(attributes.align), line, fieldAlignment});
+
+    StructInfo info;
+    info.soa = attributes.soa;
+    info.alignment = llvm::Align(alignment);
+
+    std::vector<llvm::Type*> elements;
+    uint64_t size = 0;
+
+    auto addPadding = [&](uint64_t bytes){
+        if(bytes != 0){
+            elements.push_back(llvm::ArrayType::get(m_builder->getInt8Ty(), bytes));
+            size += bytes;
+        }
+    };
+
+    for(const StructFieldNode* field : order){
+        llvm::Type* type = GetTypeFromToken(field->type);
+
+        size = attributes.packed ? size : llvm::alignTo(size, layout.getABITypeAlign(type));
+        info.fields[field->identifier.value.value()] = {unsigned(elements.size()), IsUnsignedType(field->type.type)};
+        info.hasAtomics |= field->type.isAtomic || (GetStructInfo(type) != nullptr && GetStructInfo(type)->hasAtomics);
+        elements.push_back(type);
+        size += layout.getTypeAllocSize(type).getFixedValue();
+
+        // the rest of the line, so two fields never share one
+        if(line != 0){
+            addPadding(llvm::alignTo(size, line) - size);
+        }
+    }
+
+    // LLVM pads the struct to the alignment of its fields, anything above that needs a padding field
+    if(alignment > naturalAlignment){
+        addPadding(llvm::alignTo(size, alignment) - size);
+    }
+
+    info.type = llvm::StructType::create(*m_context, elements, structNode.name.value.value(), attributes.packed);
+    m_structs[structNode.name.value.value()] = info;
+}
+
+const StructInfo* Generator::GetStructInfo(llvm::Type* type){
+    // LLVM renames a struct type whose name is taken in the context, so types are compared instead of names
+    for(const auto& [name, info] : m_structs){
+        if(info.type == type){
+            return &info;
+        }
+    }
+
+    return nullptr;
+}
+
+std::vector<unsigned> Generator::GetFieldPath(llvm::Type*& type, bool& isUnsigned, const std::vector<Token>& fields){
+    std::vector<unsigned> path;
+
+    // the analyzer made sure that every field exists
+    for(const Token& field : fields){
+        const StructInfo* info = GetStructInfo(type);
+        const StructFieldInfo& fieldInfo = info->fields.at(field.value.value());
+
+        path.push_back(fieldInfo.index);
+        type = info->type->getElementType(fieldInfo.index);
+        isUnsigned = fieldInfo.isUnsigned;
+    }
+
+    return path;
+}
+
+llvm::Value* Generator::GenVariablePointer(const std::string& name, llvm::Type*& type, bool& isUnsigned, const std::vector<Token>& fields){
+    llvm::Value* base = nullptr;
+
+    if(m_namedValues.find(name) != m_namedValues.end()){
+        const VarInfo& info = m_namedValues.at(name);
+        base = info.alloca;
+        type = info.type;
+        isUnsigned = info.isUnsigned;
+    } else {
+        const GlobalInfo& info = m_globalValues.at(name);
+        base = info.global;
+        type = info.global->getValueType();
+        isUnsigned = info.isUnsigned;
+    }
+
+    if(fields.empty()){
+        return base;
+    }
+
+    llvm::Type* baseType = type;
+    std::vector<llvm::Value*> indices = {m_builder->getInt32(0)};
+
+    for(unsigned index : GetFieldPath(type, isUnsigned, fields)){
+        indices.push_back(m_builder->getInt32(index));
+    }
+
+    return m_builder->CreateInBoundsGEP(baseType, base, indices);
+}
+
+llvm::MDNode* Generator::GetTBAATag(llvm::Type* type){
+    // a struct or array is accessed as a whole, which overlaps accesses of its fields or elements
+    if(type->isAggregateType()){
+        return nullptr;
+    }
+
+    if(m_tbaaTags.find(type) != m_tbaaTags.end()){
+        return m_tbaaTags.at(type);
+    }
+
+    llvm::MDBuilder builder(*m_context);
+
+    if(m_tbaaRoot == nullptr){
+        m_tbaaRoot = builder.createTBAARoot("xd tbaa");
+    }
+
+    // the LLVM name of the type, i32 for int and uint. typed pointers all share one node
+    std::string name;
+    llvm::raw_string_ostream stream(name);
+
+    if(type->isPointerTy()){
+        stream << "pointer";
+    } else {
+        type->print(stream);
+    }
+
+    llvm::MDNode* node = builder.createTBAAScalarTypeNode(stream.str(), m_tbaaRoot);
+    llvm::MDNode* tag = builder.createTBAAStructTagNode(node, node, 0);
+    m_tbaaTags[type] = tag;
+    return tag;
+}
+
+llvm::LoadInst* Generator::GenLoad(llvm::Type* type, llvm::Value* pointer){
+    llvm::LoadInst* load = m_builder->CreateLoad(type, pointer);
+
+    if(llvm::MDNode* tag = GetTBAATag(type)){
+        load->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    }
+
+    return load;
+}
+
+llvm::StoreInst* Generator::GenStore(llvm::Value* value, llvm::Value* pointer){
+    llvm::StoreInst* store = m_builder->CreateStore(value, pointer);
+
+    if(llvm::MDNode* tag = GetTBAATag(value->getType())){
+        store->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    }
+
+    return store;
+}
+
+llvm::Value* Generator::ConvertToType(TypedValue value, llvm::Type* type, bool targetUnsigned){
+    llvm::Type* sourceType = value.value->getType();
+
+    if(sourceType == type){
+        return value.value;
+    }
+
+    if(auto* vectorType = llvm::dyn_cast<llvm::FixedVectorType>(type); vectorType && sourceType->isVectorTy() == false){
+        llvm::Value* element = ConvertToType(value, vectorType->getElementType(), targetUnsigned);
+        return m_builder->CreateVectorSplat(vectorType->getNumElements(), element);
+    }
+
+    // comparison results are 0 or 1, never -1
+    bool isUnsigned = value.isUnsigned || sourceType->getScalarType()->isIntegerTy(1);
+
+    if(sourceType->isIntOrIntVectorTy() && type->isIntOrIntVectorTy()){
+        return isUnsigned
+            ? m_builder->CreateZExtOrTrunc(value.value, type)
+            : m_builder->CreateSExtOrTrunc(value.value, type);
+    }
+
+    if(sourceType->isIntOrIntVectorTy() && type->isFPOrFPVectorTy()){
+        return isUnsigned
+            ? m_builder->CreateUIToFP(value.value, type)
+            : m_builder->CreateSIToFP(value.value, type);
+    }
+
+    if(sourceType->isFPOrFPVectorTy() && type->isFPOrFPVectorTy()){
+        return m_builder->CreateFPCast(value.value, type);
+    }
+
+    if(sourceType->isFPOrFPVectorTy() && type->isIntOrIntVectorTy()){
+        return targetUnsigned
+            ? m_builder->CreateFPToUI(value.value, type)
+            : m_builder->CreateFPToSI(value.value, type);
+    }
+
+    return value.value;
+}
+
+void Generator::UnifyOperands(TypedValue& lhs, TypedValue& rhs){
+    llvm::Type* leftType = lhs.value->getType();
+    llvm::Type* rightType = rhs.value->getType();
+
+    if(leftType == rightType){
+        return;
+    }
+
+    // the operand of the smaller type is widened to the type of the other one,
+    // integers mixed with floats become floats and scalars mixed with vectors are broadcast
+    auto widen = [&](TypedValue& narrow, const TypedValue& wide){
+        narrow = {ConvertToType(narrow, wide.value->getType()), wide.isUnsigned};
+    };
+
+    if(leftType->isVectorTy() != rightType->isVectorTy()){
+        leftType->isVectorTy() ? widen(rhs, lhs) : widen(lhs, rhs);
+        return;
+    }
+
+    if(leftType->isFPOrFPVectorTy() != rightType->isFPOrFPVectorTy()){
+        leftType->isFPOrFPVectorTy() ? widen(rhs, lhs) : widen(lhs, rhs);
+        return;
+    }
+
+    leftType->getScalarSizeInBits() < rightType->getScalarSizeInBits() ? widen(lhs, rhs) : widen(rhs, lhs);
+}
+
+void Generator::WriteVariable(const VarInfo& variable, llvm::BasicBlock* block, llvm::Value* value){
+    m_currentDef[variable.id][block] = value;
+}
+
+llvm::Value* Generator::ReadVariable(const VarInfo& variable, llvm::BasicBlock* block){
+    auto& definitions = m_currentDef[variable.id];
+
+    if(definitions.find(block) != definitions.end()){
+        return definitions.at(block);
+    }
+
+    return ReadVariableRecursive(variable, block);
+}
+
+llvm::Value* Generator::ReadVariableRecursive(const VarInfo& variable, llvm::BasicBlock* block){
+    llvm::Value* value = nullptr;
+
+    if(m_sealedBlocks.contains(block) == false){
+        // not all predecessors are known yet, the operands are filled in once the block is sealed
+        llvm::IRBuilder<> TmpB(block, block->begin());
+        llvm::PHINode* phi = TmpB.CreatePHI(variable.type, 0, variable.name);
+        m_incompletePhis[block].push_back({variable, phi});
+        value = phi;
+    }
+    else if(llvm::BasicBlock* predecessor = block->getSinglePredecessor()){
+        // no phi needed
+        value = ReadVariable(variable, predecessor);
+    }
+    else if(llvm::pred_empty(block)){
+        // read before any write, the value is undefined just like an uninitialized alloca
+        value = llvm::UndefValue::get(variable.type);
+    }
+    else{
+        // the phi is written first to break cycles through loops
+        llvm::IRBuilder<> TmpB(block, block->begin());
+        llvm::PHINode* phi = TmpB.CreatePHI(variable.type, 0, variable.name);
+        WriteVariable(variable, block, phi);
+        value = AddPhiOperands(variable, phi);
+    }
+
+    WriteVariable(variable, block, value);
+    return value;
+}
+
+llvm::Value* Generator::AddPhiOperands(const VarInfo& variable, llvm::PHINode* phi){
+    for(llvm::BasicBlock* predecessor : llvm::predecessors(phi->getParent())){
+        phi->addIncoming(ReadVariable(variable, predecessor), predecessor);
+    }
+
+    return TryRemoveTrivialPhi(phi);
+}
+
+// a phi that only merges a single value (or itself) is replaced by that value
+llvm::Value* Generator::TryRemoveTrivialPhi(llvm::PHINode* phi){
+    llvm::Value* same = nullptr;
+
+    for(llvm::Value* operand : phi->incoming_values()){
+        if(operand == same || operand == phi){
+            continue;
+        }
+
+        if(same != nullptr){
+            return phi;
+        }
+
+        same = operand;
+    }
+
+    if(same == nullptr){
+        same = llvm::UndefValue::get(phi->getType());
+    }
+
+    // phis that used this phi might have become trivial too. weak handles, since those can be
+    // removed by the recursion before we get to them
+    std::vector<llvm::WeakVH> phiUsers;
+
+    for(llvm::User* user : phi->users()){
+        if(user != phi && llvm::isa<llvm::PHINode>(user)){
+            phiUsers.push_back(user);
+        }
+    }
+
+    phi->replaceAllUsesWith(same);
+
+    for(auto& definitions : m_currentDef){
+        for(auto& definition : definitions.second){
+            if(definition.second == phi){
+                definition.second = same;
+            }
+        }
+    }
+
+    phi->eraseFromParent();
+
+    for(llvm::WeakVH& user : phiUsers){
+        if(llvm::PHINode* userPhi = llvm::dyn_cast_or_null<llvm::PHINode>(user)){
+            TryRemoveTrivialPhi(userPhi);
+        }
+    }
+
+    return same;
+}
+
+void Generator::SealBlock(llvm::BasicBlock* block){
+    for(auto& [variable, phi] : m_incompletePhis[block]){
+        AddPhiOperands(variable, phi);
+    }
+
+    m_incompletePhis.erase(block);
+    m_sealedBlocks.insert(block);
+}
+
+std::string GetTierEntryName(const std::string& function){
+    return "xd.tier." + function;
+}
+
+// tier entries pass every value as an i64 slot, with the value in the low bytes
+static llvm::Value* ToSlot(llvm::IRBuilder<>& builder, llvm::Value* value){
+    if(value->getType()->isFloatingPointTy()){
+        value = builder.CreateBitCast(value, builder.getIntNTy(value->getType()->getScalarSizeInBits()));
+    }
+
+    return builder.CreateZExtOrTrunc(value, builder.getInt64Ty());
+}
+
+static llvm::Value* FromSlot(llvm::IRBuilder<>& builder, llvm::Value* slot, llvm::Type* type){
+    llvm::Value* value = builder.CreateTrunc(slot, builder.getIntNTy(type->getScalarSizeInBits()));
+
+    if(type->isFloatingPointTy()){
+        value = builder.CreateBitCast(value, type);
+    }
+
+    return value;
+}
+
+void Generator::GenTierEntry(llvm::Function* function){
+    // vectors and slices don't fit into a slot, the interpreter never calls functions that take or return them
+    auto fitsSlot = [](llvm::Type* type){ return type->isIntegerTy() || type->isFloatingPointTy() || type->isVoidTy(); };
+
+    if(fitsSlot(function->getReturnType()) == false
+        || std::any_of(function->arg_begin(), function->arg_end(), [&](const llvm::Argument& argument){ return fitsSlot(argument.getType()) == false; })){
+        return;
+    }
+
+#if LLVM_VERSION_MAJOR >= 15
+    llvm::Type* slotsType = llvm::PointerType::get(*m_context, 0);
+#else
+    llvm::Type* slotsType = llvm::Type::getInt64PtrTy(*m_context);
+#endif
+
+    llvm::FunctionType* entryType = llvm::FunctionType::get(m_builder->getVoidTy(), {slotsType, slotsType}, false);
+
+    llvm::Function* entry = llvm::Function::Create(
+        entryType,
+        llvm::Function::ExternalLinkage,
+        GetTierEntryName(function->getName().str()),
+        m_module.get()
+    );
+
+    llvm::Argument* arguments = entry->getArg(0);
+    llvm::Argument* result = entry->getArg(1);
+
+    m_builder->SetInsertPoint(llvm::BasicBlock::Create(*m_context, "entry", entry));
+
+    std::vector<llvm::Value*> callArguments;
+
+    for(llvm::Argument& parameter : function->args()){
+        llvm::Value* slotPointer = m_builder->CreateConstGEP1_64(m_builder->getInt64Ty(), arguments, parameter.getArgNo());
+        llvm::Value* slot = m_builder->CreateLoad(m_builder->getInt64Ty(), slotPointer);
+        callArguments.push_back(FromSlot(*m_builder, slot, parameter.getType()));
+    }
+
+    llvm::CallInst* returnValue = m_builder->CreateCall(function, callArguments);
+    returnValue->setCallingConv(function->getCallingConv());
+
+    if(returnValue->getType()->isVoidTy() == false){
+        m_builder->CreateStore(ToSlot(*m_builder, returnValue), result);
+    }
+
+    m_builder->CreateRetVoid();
+}
+
+llvm::Function* Generator::GenPrototype(const std::unique_ptr<ProtoTypeNode>& prototype){
+    llvm::Type* ReturnType = GetTypeFromToken(prototype->returnType);
+
+    if (!ReturnType) {
+        GetLLVMErrorStream() << "DEBUG: Function Gen failed - ReturnType is null for function: " 
+                     << prototype->name.value.value() << "\n";
+        return nullptr;
+    } 
+
+    std::vector<llvm::Type*> paramTypes;
+
+    for(const ParamNode& param : prototype->params){
+        llvm::Type* paramType = GetTypeFromToken(param.type);
+
+        if(paramType == nullptr || paramType->isVoidTy()){
+            GetLLVMErrorStream() << "ERROR: Invalid type of parameter " << param.identifier.value.value() << " of function " << prototype->name.value.value() << "\n";
+            AbortCompilation();
+        }
+
+        paramTypes.push_back(paramType);
+    }
+
+    llvm::FunctionType * funcType = llvm::FunctionType::get(ReturnType, paramTypes, false);
+
+    m_functionProtos[prototype->name.value.value()] = prototype.get();
+
+    llvm::Function* function = llvm::Function::Create(
+        funcType,
+        llvm::Function::ExternalLinkage,
+        prototype->name.value.value().c_str(),
+        m_module.get()
+    );
+
+    for(size_t i = 0; i < prototype->params.size(); i++){
+        function->getArg(i)->setName(prototype->params[i].identifier.value.value());
+
+        // no other pointer the function can see reaches the memory of a restrict pointer
+        if(prototype->params[i].type.isRestrict){
+            function->addParamAttr(i, llvm::Attribute::NoAlias);
+        }
+    }
+
+    // calls between XD functions use the fast calling convention, main is called by the C runtime
+    // or the JIT and keeps the C calling convention
+    if(prototype->name.value.value() != "main"){
+        function->setCallingConv(llvm::CallingConv::Fast);
+    }
+
+    return function;
+}
+
+llvm::BasicBlock* Generator::GetTrapBlock(){
+    if(m_trapBlock == nullptr){
+        // never reads a variable, so it doesn't take part in SSA construction
+        m_trapBlock = llvm::BasicBlock::Create(*m_context, "trap", m_currentFunc);
+        llvm::IRBuilder<> trapBuilder(m_trapBlock);
+        trapBuilder.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+        trapBuilder.CreateUnreachable();
+    }
+
+    return m_trapBlock;
+}
+
+llvm::Value* Generator::GenCheckedArithmetic(llvm::Intrinsic::ID intrinsic, llvm::Value* lhs, llvm::Value* rhs){
+    llvm::Value* result = m_builder->CreateBinaryIntrinsic(intrinsic, lhs, rhs);
+    llvm::Value* overflow = m_builder->CreateExtractValue(result, 1);
+
+    // a vector operation traps when any of its lanes overflowed
+    if(overflow->getType()->isVectorTy()){
+        overflow = m_builder->CreateOrReduce(overflow);
+    }
+
+    llvm::BasicBlock* continueBB = llvm::BasicBlock::Create(*m_context, "overflow.ok", m_currentFunc);
+
+    // the trap is cold, so the checks stay out of the way of the hot path
+    m_builder->CreateCondBr(overflow, GetTrapBlock(), continueBB, llvm::MDBuilder(*m_context).createBranchWeights(1, 1 << 20));
+
+    m_builder->SetInsertPoint(continueBB);
+    SealBlock(continueBB);
+
+    return m_builder->CreateExtractValue(result, 0);
+}
+
+SliceValue Generator::GenSlice(const Token& identifier){
+    std::string name = identifier.value.value();
+    llvm::Value* base = nullptr;
+    llvm::Type* type = nullptr;
+    SliceValue slice = {nullptr, nullptr, nullptr, false};
+
+    // slices and pointers are values, arrays are the only variables with elements that live in memory
+    if(m_namedValues.find(name) != m_namedValues.end()){
+        const VarInfo& info = m_namedValues.at(name);
+
+        // a pointer is a slice without a length
+        if(info.alloca == nullptr && info.type->isPointerTy()){
+            return {ReadVariable(info, m_builder->GetInsertBlock()), nullptr, info.elementType, info.isUnsigned};
+        }
+
+        if(info.alloca == nullptr){
+            return UnpackSlice(ReadVariable(info, m_builder->GetInsertBlock()), info.elementType, info.isUnsigned);
+        }
+
+        base = info.alloca;
+        type = info.type;
+        slice.elementType = info.elementType;
+        slice.isUnsigned = info.isUnsigned;
+    }
+    // only arrays can be globals
+    else if(m_globalValues.find(name) != m_globalValues.end()){
+        const GlobalInfo& info = m_globalValues.at(name);
+
+        base = info.global;
+        type = info.global->getValueType();
+        slice.elementType = info.elementType;
+        slice.isUnsigned = info.isUnsigned;
+    }
+    else{
+        GetLLVMErrorStream() << "ERROR: Undefined array or slice: " << name << "\n";
+        AbortCompilation();
+    }
+
+    if(auto* arrayType = llvm::dyn_cast<llvm::ArrayType>(type)){
+        slice.pointer = m_builder->CreateConstInBoundsGEP2_64(arrayType, base, 0, 0);
+        slice.length = m_builder->getInt64(arrayType->getNumElements());
+        return slice;
+    }
+
+    // a @soa array, every field array has as many elements as the array
+    auto* arrays = llvm::cast<llvm::StructType>(type);
+
+    for(unsigned i = 0; i < arrays->getNumElements(); i++){
+        slice.fieldPointers.push_back(m_builder->CreateInBoundsGEP(arrays, base, {m_builder->getInt32(0), m_builder->getInt32(i), m_builder->getInt64(0)}));
+    }
+
+    slice.length = m_builder->getInt64(llvm::cast<llvm::ArrayType>(arrays->getElementType(0))->getNumElements());
+    return slice;
+}
+
+llvm::Value* Generator::PackSlice(const SliceValue& slice){
+    llvm::Value* packed = llvm::UndefValue::get(GetSliceType(slice.elementType));
+    unsigned index = 0;
+
+    if(slice.fieldPointers.empty()){
+        packed = m_builder->CreateInsertValue(packed, slice.pointer, index++);
+    }
+
+    for(llvm::Value* fieldPointer : slice.fieldPointers){
+        packed = m_builder->CreateInsertValue(packed, fieldPointer, index++);
+    }
+
+    return m_builder->CreateInsertValue(packed, slice.length, index);
+}
+
+SliceValue Generator::UnpackSlice(llvm::Value* slice, llvm::Type* elementType, bool isUnsigned){
+    unsigned pointers = llvm::cast<llvm::StructType>(slice->getType())->getNumElements() - 1;
+    const StructInfo* info = GetStructInfo(elementType);
+    SliceValue unpacked = {nullptr, m_builder->CreateExtractValue(slice, pointers), elementType, isUnsigned};
+
+    if(info != nullptr && info->soa){
+        for(unsigned i = 0; i < pointers; i++){
+            unpacked.fieldPointers.push_back(m_builder->CreateExtractValue(slice, i));
+        }
+    } else {
+        unpacked.pointer = m_builder->CreateExtractValue(slice, 0);
+    }
+
+    return unpacked;
+}
+
+llvm::Value* Generator::GenIndex(const SliceValue& slice, const std::unique_ptr<ExprNode>& index, bool boundsCheck){
+    TypedValue offset = GenExpr(index);
+
+    if(offset.value == nullptr){
+        GetLLVMErrorStream() << "ERROR: Failed to generate an index\n";
+        AbortCompilation();
+    }
+
+    // a negative index is sign extended, which makes it larger than any length as an unsigned number
+    llvm::Value* position = ConvertToType(offset, m_builder->getInt64Ty());
+
+    if(boundsCheck){
+        llvm::Value* inRange = m_builder->CreateICmpULT(position, slice.length);
+        llvm::BasicBlock* continueBB = llvm::BasicBlock::Create(*m_context, "bounds.ok", m_currentFunc);
+
+        m_builder->CreateCondBr(inRange, continueBB, GetTrapBlock(), llvm::MDBuilder(*m_context).createBranchWeights(1 << 20, 1));
+
+        m_builder->SetInsertPoint(continueBB);
+        SealBlock(continueBB);
+    }
+
+    return position;
+}
 
-std::map<std::string, llvm::Value *> GlobalValues;
-std::map<std::string, VarInfo> NamedValues;
-llvm::Function * CurrentFunc = nullptr;
+llvm::Value* Generator::GenElementPointer(const SliceValue& slice, llvm::Value* position, const std::vector<unsigned>& path){
+    std::vector<llvm::Value*> indices = {position};
 
-static llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Function *TheFunction, llvm::Type * Type, llvm::StringRef VarName) {
-    if (!TheFunction) return nullptr;
-    llvm::IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    return TmpB.CreateAlloca(Type, nullptr, VarName);
+    // the first field of a @soa element selects the field array
+    size_t first = slice.fieldPointers.empty() ? 0 : 1;
+
+    for(size_t i = first; i < path.size(); i++){
+        indices.push_back(m_builder->getInt32(path[i]));
+    }
+
+    if(first == 0){
+        return m_builder->CreateInBoundsGEP(slice.elementType, slice.pointer, indices);
+    }
+
+    llvm::Type* fieldType = llvm::cast<llvm::StructType>(slice.elementType)->getElementType(path.at(0));
+    return m_builder->CreateInBoundsGEP(fieldType, slice.fieldPointers.at(path.at(0)), indices);
 }
 
-void InitializeModule(){
-    TheContext = std::make_unique<llvm::LLVMContext>();
-    TheModule = std::make_unique<llvm::Module>("XD Compiler", *TheContext);
-    Builder = std::make_unique<llvm::IRBuilder<>>(*TheContext);
+llvm::Value* Generator::GenGatherElement(const SliceValue& slice, llvm::Value* position){
+    llvm::Value* element = llvm::UndefValue::get(slice.elementType);
+
+    for(unsigned i = 0; i < slice.fieldPointers.size(); i++){
+        llvm::Type* fieldType = llvm::cast<llvm::StructType>(slice.elementType)->getElementType(i);
+        llvm::Value* field = GenLoad(fieldType, GenElementPointer(slice, position, {i}));
+        element = m_builder->CreateInsertValue(element, field, i);
+    }
+
+    return element;
 }
 
-llvm::Type* Generator::GetTypeFromToken(TokenType type) {
-    switch(type){
-        case TokenType::INT:
-            return llvm::Type::getInt32Ty(*TheContext);
-        case TokenType::UINT:
-            return llvm::Type::getInt32Ty(*TheContext);
-        case TokenType::FLOAT:
-            return llvm::Type::getFloatTy(*TheContext);
-        case TokenType::VOID:
-            return llvm::Type::getVoidTy(*TheContext);
-        default:
-            llvm::errs() << "DEBUG: Unhandled TokenType (" << (int)type << ") in GetTypeFromToken.\n";
-            return nullptr;
+void Generator::GenScatterElement(const SliceValue& slice, llvm::Value* position, llvm::Value* element){
+    for(unsigned i = 0; i < slice.fieldPointers.size(); i++){
+        GenStore(m_builder->CreateExtractValue(element, i), GenElementPointer(slice, position, {i}));
+    }
+}
+
+TypedValue Generator::GenCall(const std::unique_ptr<CallExprNode>& call){
+    if(IsBuiltinFunction(call->callee.value.value())){
+        return GenBuiltin(call);
+    }
+
+    llvm::Function* callee = m_module->getFunction(call->callee.value.value());
+
+    if(callee == nullptr){
+        GetLLVMErrorStream() << "ERROR: Call to unknown function: " << call->callee.value.value() << "\n";
+        return {nullptr, false};
+    }
+
+    if(call->args.size() != callee->arg_size()){
+        GetLLVMErrorStream() << "ERROR: Wrong number of arguments in call to " << call->callee.value.value() << "\n";
+        AbortCompilation();
+    }
+
+    const ProtoTypeNode* prototype = m_functionProtos.at(call->callee.value.value());
+    std::vector<llvm::Value*> arguments;
+
+    for(size_t i = 0; i < call->args.size(); i++){
+        TypedValue argument = GenExpr(call->args[i]);
+        llvm::Type* paramType = callee->getArg(i)->getType();
+
+        if(argument.value == nullptr || argument.value->getType()->isVoidTy()){
+            GetLLVMErrorStream() << "ERROR: Argument " << i + 1 << " of call to " << call->callee.value.value() << " has the wrong type\n";
+            AbortCompilation();
+        }
+
+        arguments.push_back(ConvertToType(argument, paramType));
+    }
+
+    // calls get their own location, so profiles can tell calls on the same line apart
+    llvm::DebugLoc statementLocation = m_builder->getCurrentDebugLocation();
+    SetDebugLocation(call->callee.line, call->callee.column);
+
+    llvm::CallInst* callInst = m_builder->CreateCall(callee, arguments);
+    callInst->setCallingConv(callee->getCallingConv());
+
+    m_builder->SetCurrentDebugLocation(statementLocation);
+
+    return {callInst, IsUnsignedType(prototype->returnType.type)};
+}
+
+llvm::Value* Generator::GenAtomicPointer(const std::unique_ptr<ExprNode>& expr, llvm::Type*& type, bool& isUnsigned){
+    const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(expr->var);
+
+    if(std::holds_alternative<std::unique_ptr<IdentNode>>(primaryExpr->var)){
+        return GenVariablePointer(std::get<std::unique_ptr<IdentNode>>(primaryExpr->var)->val.value.value(), type, isUnsigned, {});
+    }
+
+    // a struct with atomic fields is never kept in SSA registers
+    if(std::holds_alternative<std::unique_ptr<FieldExprNode>>(primaryExpr->var)){
+        const auto& field = std::get<std::unique_ptr<FieldExprNode>>(primaryExpr->var);
+        return GenVariablePointer(field->identifier.value.value(), type, isUnsigned, field->fields);
+    }
+
+    const auto& index = std::get<std::unique_ptr<IndexExprNode>>(primaryExpr->var);
+    SliceValue slice = GenSlice(index->identifier);
+    llvm::Value* position = GenIndex(slice, index->index, index->boundsCheck);
+
+    type = slice.elementType;
+    isUnsigned = slice.isUnsigned;
+    std::vector<unsigned> path = GetFieldPath(type, isUnsigned, index->fields);
+
+    return GenElementPointer(slice, position, path);
+}
+
+// the ordering that the last argument of an atomic builtin names, see Analyzer::AnalyzeAtomic
+static llvm::AtomicOrdering GetAtomicOrdering(const std::unique_ptr<ExprNode>& expr){
+    static const std::map<std::string, llvm::AtomicOrdering> orderings = {
+        {"relaxed", llvm::AtomicOrdering::Monotonic},
+        {"acquire", llvm::AtomicOrdering::Acquire},
+        {"release", llvm::AtomicOrdering::Release},
+        {"acq_rel", llvm::AtomicOrdering::AcquireRelease},
+        {"seq_cst", llvm::AtomicOrdering::SequentiallyConsistent},
+    };
+
+    const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(expr->var);
+    return orderings.at(std::get<std::unique_ptr<IdentNode>>(primaryExpr->var)->val.value.value());
+}
+
+TypedValue Generator::GenAtomic(const std::unique_ptr<CallExprNode>& call){
+    std::string name = call->callee.value.value();
+    llvm::Type* type = nullptr;
+    bool isUnsigned = false;
+
+    llvm::Value* pointer = GenAtomicPointer(call->args.front(), type, isUnsigned);
+    llvm::AtomicOrdering ordering = GetAtomicOrdering(call->args.back());
+    // every atomic is at least aligned to its ABI alignment, which the instructions need to be lock free
+    llvm::Align alignment = m_module->getDataLayout().getABITypeAlign(type);
+
+    std::vector<llvm::Value*> values;
+
+    for(size_t i = 1; i + 1 < call->args.size(); i++){
+        TypedValue value = GenExpr(call->args[i]);
+
+        if(value.value == nullptr){
+            GetLLVMErrorStream() << "ERROR: Failed to generate argument " << i + 1 << " of " << name << "\n";
+            AbortCompilation();
+        }
+
+        values.push_back(ConvertToType(value, type, isUnsigned));
+    }
+
+    if(name == "load"){
+        llvm::LoadInst* load = GenLoad(type, pointer);
+        load->setAtomic(ordering);
+        load->setAlignment(alignment);
+        return {load, isUnsigned};
     }
+
+    if(name == "store"){
+        llvm::StoreInst* store = GenStore(values[0], pointer);
+        store->setAtomic(ordering);
+        store->setAlignment(alignment);
+        return {store, false};
+    }
+
+    llvm::Instruction* instruction = nullptr;
+    TypedValue result;
+
+    if(name == "cas"){
+        // a strong compare-exchange, it only fails when the atomic holds another value. the
+        // failure ordering is the strongest one the ordering allows for a load
+        auto* cmpxchg = m_builder->CreateAtomicCmpXchg(pointer, values[0], values[1], alignment, ordering, llvm::AtomicCmpXchgInst::getStrongestFailureOrdering(ordering));
+        instruction = cmpxchg;
+        result = {m_builder->CreateExtractValue(cmpxchg, 1), false};
+    } else {
+        auto operation = name == "fetch_add" ? llvm::AtomicRMWInst::Add : llvm::AtomicRMWInst::Sub;
+        instruction = m_builder->CreateAtomicRMW(operation, pointer, values[0], alignment, ordering);
+        result = {instruction, isUnsigned};
+    }
+
+    if(llvm::MDNode* tag = GetTBAATag(type)){
+        instruction->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    }
+
+    return result;
+}
+
+TypedValue Generator::GenBuiltin(const std::unique_ptr<CallExprNode>& call){
+    std::string name = call->callee.value.value();
+    std::vector<TypedValue> args;
+
+    if(name == "load" || name == "store" || name == "fetch_add" || name == "fetch_sub" || name == "cas"){
+        return GenAtomic(call);
+    }
+
+    // the length of an array is a constant, a slice carries it. lengths are less than 2^31
+    if(name == "len"){
+        const auto& primaryExpr = std::get<std::unique_ptr<PrimaryExprNode>>(call->args.at(0)->var);
+        SliceValue slice = GenSlice(std::get<std::unique_ptr<IdentNode>>(primaryExpr->var)->val);
+        return {m_builder->CreateTrunc(slice.length, m_builder->getInt32Ty()), false};
+    }
+
+    for(size_t i = 0; i < call->args.size(); i++){
+        TypedValue arg = GenExpr(call->args[i]);
+
+        if(arg.value == nullptr){
+            GetLLVMErrorStream() << "ERROR: Failed to generate argument " << i + 1 << " of " << name << "\n";
+            AbortCompilation();
+        }
+
+        // comparisons give masks of i1, everywhere but in select they are ints of 0 or 1
+        llvm::Type* type = arg.value->getType();
+
+        if(type->getScalarType()->isIntegerTy(1) && (name != "select" || i != 0)){
+            llvm::Type* intType = m_builder->getInt32Ty();
+            arg.value = ConvertToType(arg, type->isVectorTy() ? llvm::VectorType::get(intType, llvm::cast<llvm::VectorType>(type)->getElementCount()) : intType);
+        }
+
+        args.push_back(arg);
+    }
+
+    TypedValue vector = args.at(0);
+    llvm::Type* elementType = vector.value->getType()->getScalarType();
+    bool isFloat = elementType->isFloatingPointTy();
+
+    // float reductions combine the lanes in order, like a loop over them would. reassoc
+    // (@fastmath) lets LLVM use a tree of shuffles instead
+    if(name == "reduce_add"){
+        return {isFloat ? m_builder->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(elementType), vector.value)
+            : m_builder->CreateAddReduce(vector.value), vector.isUnsigned};
+    }
+
+    if(name == "reduce_mul"){
+        return {isFloat ? m_builder->CreateFMulReduce(llvm::ConstantFP::get(elementType, 1.0), vector.value)
+            : m_builder->CreateMulReduce(vector.value), vector.isUnsigned};
+    }
+
+    if(name == "reduce_min"){
+        return {isFloat ? m_builder->CreateFPMinReduce(vector.value)
+            : m_builder->CreateIntMinReduce(vector.value, !vector.isUnsigned), vector.isUnsigned};
+    }
+
+    if(name == "reduce_max"){
+        return {isFloat ? m_builder->CreateFPMaxReduce(vector.value)
+            : m_builder->CreateIntMaxReduce(vector.value, !vector.isUnsigned), vector.isUnsigned};
+    }
+
+    if(name == "extract"){
+        return {m_builder->CreateExtractElement(vector.value, args[1].value), vector.isUnsigned};
+    }
+
+    if(name == "insert"){
+        return {m_builder->CreateInsertElement(vector.value, ConvertToType(args[2], elementType), args[1].value), vector.isUnsigned};
+    }
+
+    if(name == "select"){
+        llvm::Value* mask = vector.value;
+
+        // masks stored in variables hold 0 or 1 in every lane
+        if(elementType->isIntegerTy(1) == false){
+            mask = m_builder->CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()));
+        }
+
+        TypedValue lhs = args[1];
+        TypedValue rhs = args[2];
+        UnifyOperands(lhs, rhs);
+
+        return {m_builder->CreateSelect(mask, lhs.value, rhs.value), lhs.isUnsigned || rhs.isUnsigned};
+    }
+
+    // shuffle, the analyzer made sure that the lane indices are literals
+    std::vector<int> lanes;
+
+    for(size_t i = 2; i < args.size(); i++){
+        lanes.push_back(llvm::cast<llvm::ConstantInt>(args[i].value)->getSExtValue());
+    }
+
+    return {m_builder->CreateShuffleVector(vector.value, args[1].value, lanes), vector.isUnsigned};
 }
 
 TypedValue Generator::GenPrimaryExpr(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
@@ -62,41 +1103,138 @@ TypedValue Generator::GenPrimaryExpr(const std::unique_ptr<PrimaryExprNode>& pri
         Generator & generator;
         TypedValue value = {nullptr, false};
 
+        // the analyzer gave every literal its type and checked that the value fits into it
         void operator()(const std::unique_ptr<IntLitNode>& intLit){
-            std::string intValueStr = intLit->val.value.value();
-            value.value = Builder->getInt32(std::stoi(intValueStr));
+            llvm::Type* type = generator.GetTypeFromToken(intLit->type);
+
+            if(type->isFloatingPointTy()){
+                value.value = llvm::ConstantFP::get(type, intLit->val.value.value());
+                return;
+            }
+
+            value.value = llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(type), intLit->val.value.value(), 10);
+            value.isUnsigned = IsUnsignedType(intLit->type);
         }
 
         void operator()(const std::unique_ptr<FloatLitNode>& floatLit){
-            std::string floatValueStr = floatLit->val.value.value();
-            value.value = llvm::ConstantFP::get(llvm::Type::getFloatTy(*TheContext), std::stof(floatValueStr));
+            value.value = llvm::ConstantFP::get(generator.GetTypeFromToken(floatLit->type), floatLit->val.value.value());
         }
 
         void operator()(const std::unique_ptr<IdentNode>& ident){
-            if(CurrentFunc == nullptr){
+            if(generator.m_currentFunc == nullptr){
                 return;
             }
 
-            if(CurrentFunc != nullptr){
+            if(generator.m_currentFunc != nullptr){
                 std::string variableName = ident->val.value.value();
 
-                if(NamedValues.find(variableName) == NamedValues.end()){
-                    llvm::errs() << "Error: Undefined variable: " << variableName << '\n';
+                if(generator.m_namedValues.find(variableName) == generator.m_namedValues.end()){
+                    if(generator.m_globalValues.find(variableName) != generator.m_globalValues.end()){
+                        GlobalInfo info = generator.m_globalValues.at(variableName);
+                        value.isUnsigned = info.isUnsigned;
+
+                        // an array used as a value is a slice of its elements
+                        value.value = info.elementType != nullptr
+                            ? generator.PackSlice(generator.GenSlice(ident->val))
+                            : generator.GenLoad(info.global->getValueType(), info.global);
+                        return;
+                    }
+
+                    GetLLVMErrorStream() << "Error: Undefined variable: " << variableName << '\n';
                     value = {nullptr, false};
                     return;
                 }
 
-                VarInfo info = NamedValues.at(variableName);
+                VarInfo info = generator.m_namedValues.at(variableName);
                 value.isUnsigned = info.isUnsigned;
-                llvm::AllocaInst* variable = info.alloca;
-                llvm::Type* variableType = variable->getAllocatedType();
-                value.value = Builder->CreateLoad(variableType, variable);
+
+                // arrays are the only variables with an element type that live in memory
+                if(info.elementType != nullptr && info.alloca != nullptr){
+                    value.value = generator.PackSlice(generator.GenSlice(ident->val));
+                }
+                else if(info.alloca != nullptr){
+                    value.value = generator.GenLoad(info.type, info.alloca);
+                } else {
+                    value.value = generator.ReadVariable(info, generator.m_builder->GetInsertBlock());
+                }
             } 
         }
         
         void operator()(const std::unique_ptr<ExprNode>& innerExpr){
             value = generator.GenExpr(innerExpr);
         }
+
+        void operator()(const std::unique_ptr<CallExprNode>& call){
+            value = generator.GenCall(call);
+        }
+
+        void operator()(const std::unique_ptr<CastExprNode>& cast){
+            TypedValue operand = generator.m_currentFunc == nullptr
+                ? generator.GenConstantExpr(cast->expression)
+                : generator.GenExpr(cast->expression);
+
+            if(operand.value == nullptr){
+                return;
+            }
+
+            bool isUnsigned = IsUnsignedType(cast->type.type);
+            value = {generator.ConvertToType(operand, generator.GetTypeFromToken(cast->type), isUnsigned), isUnsigned};
+        }
+
+        void operator()(const std::unique_ptr<IndexExprNode>& index){
+            SliceValue slice = generator.GenSlice(index->identifier);
+            llvm::Value* position = generator.GenIndex(slice, index->index, index->boundsCheck);
+
+            llvm::Type* type = slice.elementType;
+            bool isUnsigned = slice.isUnsigned;
+            std::vector<unsigned> path = generator.GetFieldPath(type, isUnsigned, index->fields);
+
+            if(path.empty() && slice.fieldPointers.empty() == false){
+                value = {generator.GenGatherElement(slice, position), isUnsigned};
+                return;
+            }
+
+            value = {generator.GenLoad(type, generator.GenElementPointer(slice, position, path)), isUnsigned};
+        }
+
+        void operator()(const std::unique_ptr<FieldExprNode>& field){
+            std::string name = field->identifier.value.value();
+
+            // structs that aren't arrays are kept in SSA registers like numbers, unless their address is taken
+            if(generator.m_namedValues.find(name) != generator.m_namedValues.end() && generator.m_namedValues.at(name).alloca == nullptr){
+                const VarInfo& info = generator.m_namedValues.at(name);
+                llvm::Type* type = info.type;
+                bool isUnsigned = info.isUnsigned;
+                std::vector<unsigned> path = generator.GetFieldPath(type, isUnsigned, field->fields);
+
+                value = {generator.m_builder->CreateExtractValue(generator.ReadVariable(info, generator.m_builder->GetInsertBlock()), path), isUnsigned};
+                return;
+            }
+
+            llvm::Type* type = nullptr;
+            bool isUnsigned = false;
+            llvm::Value* pointer = generator.GenVariablePointer(name, type, isUnsigned, field->fields);
+            value = {generator.GenLoad(type, pointer), isUnsigned};
+        }
+
+        void operator()(const std::unique_ptr<AddressOfExprNode>& addressOf){
+            llvm::Type* type = nullptr;
+            bool isUnsigned = false;
+
+            if(addressOf->index == nullptr){
+                value = {generator.GenVariablePointer(addressOf->identifier.value.value(), type, isUnsigned, addressOf->fields), isUnsigned};
+                return;
+            }
+
+            SliceValue slice = generator.GenSlice(addressOf->identifier);
+            llvm::Value* position = generator.GenIndex(slice, addressOf->index, addressOf->boundsCheck);
+
+            type = slice.elementType;
+            isUnsigned = slice.isUnsigned;
+            std::vector<unsigned> path = generator.GetFieldPath(type, isUnsigned, addressOf->fields);
+
+            value = {generator.GenElementPointer(slice, position, path), isUnsigned};
+        }
     };
 
     PrimaryExprVisitor visitor = {*this};
@@ -104,10 +1242,60 @@ TypedValue Generator::GenPrimaryExpr(const std::unique_ptr<PrimaryExprNode>& pri
     return visitor.value;
 }
 
+TypedValue Generator::GenBinOp(BinOpType type, TypedValue lhs, TypedValue rhs){
+    UnifyOperands(lhs, rhs);
+
+    llvm::Type * leftType = lhs.value->getType();
+    llvm::Type * rightType = rhs.value->getType();
+
+    if(leftType->isIntOrIntVectorTy() && rightType->isIntOrIntVectorTy()){
+        bool isUnsigned = lhs.isUnsigned || rhs.isUnsigned;
+
+        // uint wraps around, int overflow is undefined (nsw) or traps with --checked-arith
+        bool isChecked = !isUnsigned && m_checkedArithmetic;
+
+        switch(type){
+            case BinOpType::ADD:
+                return {isUnsigned ? m_builder->CreateAdd(lhs.value, rhs.value)
+                    : isChecked ? GenCheckedArithmetic(llvm::Intrinsic::sadd_with_overflow, lhs.value, rhs.value)
+                    : m_builder->CreateNSWAdd(lhs.value, rhs.value), isUnsigned};
+            case BinOpType::SUB:
+                return {isUnsigned ? m_builder->CreateSub(lhs.value, rhs.value)
+                    : isChecked ? GenCheckedArithmetic(llvm::Intrinsic::ssub_with_overflow, lhs.value, rhs.value)
+                    : m_builder->CreateNSWSub(lhs.value, rhs.value), isUnsigned};
+            case BinOpType::MUL:
+                return {isUnsigned ? m_builder->CreateMul(lhs.value, rhs.value)
+                    : isChecked ? GenCheckedArithmetic(llvm::Intrinsic::smul_with_overflow, lhs.value, rhs.value)
+                    : m_builder->CreateNSWMul(lhs.value, rhs.value), isUnsigned};
+            case BinOpType::DIV:
+                return isUnsigned
+                    ? TypedValue{m_builder->CreateUDiv(lhs.value, rhs.value), true}
+                    : TypedValue{m_builder->CreateSDiv(lhs.value, rhs.value), false};
+        }
+    }
+
+    if(leftType->isFPOrFPVectorTy() && rightType->isFPOrFPVectorTy()){
+        switch(type){
+            case BinOpType::ADD:
+                return {m_builder->CreateFAdd(lhs.value, rhs.value)};
+            case BinOpType::SUB:
+                return {m_builder->CreateFSub(lhs.value, rhs.value)};
+            case BinOpType::MUL:
+                return {m_builder->CreateFMul(lhs.value, rhs.value)};
+            case BinOpType::DIV:
+                return {m_builder->CreateFDiv(lhs.value, rhs.value)};
+        }
+    }
+
+    GetLLVMErrorStream() << "ERROR: Invalid operand types for binary expression. LHS="
+         << *leftType << " RHS=" << *rightType << "\n";
+    return {nullptr, false};
+}
+
 TypedValue Generator::GenExpr(const std::unique_ptr<ExprNode>& expr){
 
     if (!expr) {
-        llvm::errs() << "ERROR: GenExpr called with nullptr ExprNode\n";
+        GetLLVMErrorStream() << "ERROR: GenExpr called with nullptr ExprNode\n";
         return {nullptr, false};
     }
 
@@ -125,284 +1313,1048 @@ TypedValue Generator::GenExpr(const std::unique_ptr<ExprNode>& expr){
             TypedValue rhs = generator.GenExpr(binExpr->rhs);
 
             if (!lhs.value || !rhs.value) {
-                llvm::errs() << "ERROR: Null operand encountered in binary expression.\n";
+                GetLLVMErrorStream() << "ERROR: Null operand encountered in binary expression.\n";
                 value = {nullptr, false};
                 return;
             }
 
+            value = generator.GenBinOp(binExpr->type, lhs, rhs);
+        }
+
+        void operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
+            TypedValue lhs = generator.GenExpr(conditionalExpr->lhs);
+            TypedValue rhs = generator.GenExpr(conditionalExpr->rhs);
+
+            if (!lhs.value || !rhs.value) {
+                return;
+            }
+
+            generator.UnifyOperands(lhs, rhs);
+
             llvm::Type * leftType = lhs.value->getType();
             llvm::Type * rightType = rhs.value->getType();
 
-            if(leftType->isIntegerTy() && rightType->isIntegerTy()){
+            // vectors are compared lane by lane into a mask of i1
+            if(leftType->isIntOrIntVectorTy() && rightType->isIntOrIntVectorTy()){
+                bool isUnsigned = lhs.isUnsigned || rhs.isUnsigned;
+
+                switch(conditionalExpr->type){
+                    case ConditionalOpType::EQUAL_TO:
+                        value.value = generator.m_builder->CreateICmpEQ(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::NOT_EQUAL:
+                        value.value = generator.m_builder->CreateICmpNE(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::LESS_THAN:
+                        value.value = isUnsigned
+                            ? generator.m_builder->CreateICmpULT(lhs.value, rhs.value)
+                            : generator.m_builder->CreateICmpSLT(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::GREATER_THAN:
+                        value.value = isUnsigned
+                            ? generator.m_builder->CreateICmpUGT(lhs.value, rhs.value)
+                            : generator.m_builder->CreateICmpSGT(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::LESS_OR_EQUAL:
+                        value.value = isUnsigned
+                            ? generator.m_builder->CreateICmpULE(lhs.value, rhs.value)
+                            : generator.m_builder->CreateICmpSLE(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::GREATER_OR_EQUAL:
+                        value.value = isUnsigned
+                            ? generator.m_builder->CreateICmpUGE(lhs.value, rhs.value)
+                            : generator.m_builder->CreateICmpSGE(lhs.value, rhs.value);
+                        break;
+                }
+            }
+
+            else if(leftType->isFPOrFPVectorTy() && rightType->isFPOrFPVectorTy()){
+                switch(conditionalExpr->type){
+                    case ConditionalOpType::EQUAL_TO:
+                        value.value = generator.m_builder->CreateFCmpOEQ(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::NOT_EQUAL:
+                        value.value = generator.m_builder->CreateFCmpONE(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::LESS_THAN:
+                        value.value = generator.m_builder->CreateFCmpOLT(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::GREATER_THAN:
+                        value.value = generator.m_builder->CreateFCmpOGT(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::LESS_OR_EQUAL:
+                        value.value = generator.m_builder->CreateFCmpOLE(lhs.value, rhs.value);
+                        break;
+                    case ConditionalOpType::GREATER_OR_EQUAL:
+                        value.value = generator.m_builder->CreateFCmpOGE(lhs.value, rhs.value);
+                        break;
+                }
+            }
+
+            else{
+                GetLLVMErrorStream() << "Error Comparison between expressions failed, type mismatch\n";
+            }
+        }
+    };
+
+    ExprVisitor visitor = {*this};
+    std::visit(visitor, expr->var);
+    return visitor.value;
+}
+
+TypedValue Generator::GenConstantExpr(const std::unique_ptr<ExprNode>& expr){
+    struct ConstantExprVisitor{
+        Generator & generator;
+        TypedValue value = {nullptr, false};
+
+        void operator()(const std::unique_ptr<PrimaryExprNode>& primaryExpr){
+            if(std::holds_alternative<std::unique_ptr<ExprNode>>(primaryExpr->var)){
+                value = generator.GenConstantExpr(std::get<std::unique_ptr<ExprNode>>(primaryExpr->var));
+                return;
+            }
+
+            // globals are initialized in order, so an earlier global is folded into its initial value
+            if(std::holds_alternative<std::unique_ptr<IdentNode>>(primaryExpr->var)){
+                std::string variableName = std::get<std::unique_ptr<IdentNode>>(primaryExpr->var)->val.value.value();
+
+                if(generator.m_globalValues.find(variableName) == generator.m_globalValues.end()){
+                    GetLLVMErrorStream() << "ERROR: Global initializer refers to unknown global: " << variableName << "\n";
+                    return;
+                }
+
+                GlobalInfo info = generator.m_globalValues.at(variableName);
+                value = {info.global->getInitializer(), info.isUnsigned};
+                return;
+            }
+
+            // literals are already constants
+            value = generator.GenPrimaryExpr(primaryExpr);
+        }
+
+        void operator()(const std::unique_ptr<BinOpExpr>& binExpr){
+            TypedValue lhs = generator.GenConstantExpr(binExpr->lhs);
+            TypedValue rhs = generator.GenConstantExpr(binExpr->rhs);
+
+            if (!lhs.value || !rhs.value) {
+                return;
+            }
+
+            // the builder folds conversions of constants, so this emits no code
+            generator.UnifyOperands(lhs, rhs);
+
+            auto * leftInt = llvm::dyn_cast<llvm::ConstantInt>(lhs.value);
+            auto * rightInt = llvm::dyn_cast<llvm::ConstantInt>(rhs.value);
+
+            if(leftInt && rightInt){
                 bool isUnsigned = lhs.isUnsigned || rhs.isUnsigned;
+                const llvm::APInt& l = leftInt->getValue();
+                const llvm::APInt& r = rightInt->getValue();
+                bool overflow = false;
 
                 switch(binExpr->type){
                     case BinOpType::ADD:
-                        value = {Builder->CreateAdd(lhs.value, rhs.value), isUnsigned};
+                        value = {llvm::ConstantInt::get(*generator.m_context, isUnsigned ? l + r : l.sadd_ov(r, overflow)), isUnsigned};
                         break;
                     case BinOpType::SUB:
-                        value = {Builder->CreateSub(lhs.value, rhs.value), isUnsigned};
+                        value = {llvm::ConstantInt::get(*generator.m_context, isUnsigned ? l - r : l.ssub_ov(r, overflow)), isUnsigned};
                         break;
                     case BinOpType::MUL:
-                        value = {Builder->CreateMul(lhs.value, rhs.value), isUnsigned};
+                        value = {llvm::ConstantInt::get(*generator.m_context, isUnsigned ? l * r : l.smul_ov(r, overflow)), isUnsigned};
                         break;
                     case BinOpType::DIV:
-                        value = isUnsigned
-                            ? TypedValue{Builder->CreateUDiv(lhs.value, rhs.value), true}
-                            : TypedValue{Builder->CreateSDiv(lhs.value, rhs.value), false};
-                        break;
-                    default:
-                        llvm::errs() << "DEBUG: Error unknown operation between expression\n"; 
+                        if(r.isZero()){
+                            GetLLVMErrorStream() << "ERROR: Division by zero in global initializer\n";
+                            return;
+                        }
+                        value = {llvm::ConstantInt::get(*generator.m_context, isUnsigned ? l.udiv(r) : l.sdiv(r)), isUnsigned};
                         break;
                 }
+
+                // the initializer would trap at run time, so it is rejected at compile time
+                if(overflow && generator.m_checkedArithmetic){
+                    GetLLVMErrorStream() << "ERROR: Integer overflow in global initializer\n";
+                    value = {nullptr, false};
+                }
                 return;
             }
 
-            if(leftType->isFloatingPointTy() && rightType->isFloatingPointTy()){
+            auto * leftFloat = llvm::dyn_cast<llvm::ConstantFP>(lhs.value);
+            auto * rightFloat = llvm::dyn_cast<llvm::ConstantFP>(rhs.value);
+
+            if(leftFloat && rightFloat){
+                llvm::APFloat result = leftFloat->getValueAPF();
+                const llvm::APFloat& r = rightFloat->getValueAPF();
+
                 switch(binExpr->type){
                     case BinOpType::ADD:
-                        value.value = Builder->CreateFAdd(lhs.value, rhs.value);
+                        result.add(r, llvm::APFloat::rmNearestTiesToEven);
                         break;
                     case BinOpType::SUB:
-                        value.value = Builder->CreateFSub(lhs.value, rhs.value);
+                        result.subtract(r, llvm::APFloat::rmNearestTiesToEven);
                         break;
                     case BinOpType::MUL:
-                        value.value = Builder->CreateFMul(lhs.value, rhs.value);
+                        result.multiply(r, llvm::APFloat::rmNearestTiesToEven);
                         break;
                     case BinOpType::DIV:
-                        value.value = Builder->CreateFDiv(lhs.value, rhs.value);
-                        break;
-                    default:
-                        llvm::errs() << "DEBUG: Error unknown operation between expression\n"; 
+                        result.divide(r, llvm::APFloat::rmNearestTiesToEven);
                         break;
                 }
+                value.value = llvm::ConstantFP::get(lhs.value->getType(), result);
                 return;
             }
 
-            llvm::errs() << "ERROR: Invalid operand types for binary expression. LHS="
-                 << *leftType << " RHS=" << *rightType << "\n";
-            value = {nullptr, false};
+            GetLLVMErrorStream() << "ERROR: Invalid operand types for binary expression in global initializer\n";
         }
 
         void operator()(const std::unique_ptr<ConditionalOpExpr>& conditionalExpr){
-            TypedValue lhs = generator.GenExpr(conditionalExpr->lhs);
-            TypedValue rhs = generator.GenExpr(conditionalExpr->rhs);
+            TypedValue lhs = generator.GenConstantExpr(conditionalExpr->lhs);
+            TypedValue rhs = generator.GenConstantExpr(conditionalExpr->rhs);
 
-            llvm::Type * leftType = lhs.value->getType();
-            llvm::Type * rightType = rhs.value->getType();
+            if (!lhs.value || !rhs.value) {
+                return;
+            }
+
+            generator.UnifyOperands(lhs, rhs);
 
-            if(leftType->isIntegerTy() && rightType->isIntegerTy()){
+            auto * leftInt = llvm::dyn_cast<llvm::ConstantInt>(lhs.value);
+            auto * rightInt = llvm::dyn_cast<llvm::ConstantInt>(rhs.value);
+
+            if(leftInt && rightInt){
                 bool isUnsigned = lhs.isUnsigned || rhs.isUnsigned;
+                const llvm::APInt& l = leftInt->getValue();
+                const llvm::APInt& r = rightInt->getValue();
+                bool result = false;
 
                 switch(conditionalExpr->type){
                     case ConditionalOpType::EQUAL_TO:
-                        value.value = Builder->CreateICmpEQ(lhs.value, rhs.value);
+                        result = l == r;
                         break;
                     case ConditionalOpType::NOT_EQUAL:
-                        value.value = Builder->CreateICmpNE(lhs.value, rhs.value);
+                        result = l != r;
                         break;
                     case ConditionalOpType::LESS_THAN:
-                        value.value = isUnsigned
-                            ? Builder->CreateICmpULT(lhs.value, rhs.value)
-                            : Builder->CreateICmpSLT(lhs.value, rhs.value);
+                        result = isUnsigned ? l.ult(r) : l.slt(r);
+                        break;
+                    case ConditionalOpType::GREATER_THAN:
+                        result = isUnsigned ? l.ugt(r) : l.sgt(r);
+                        break;
+                    case ConditionalOpType::LESS_OR_EQUAL:
+                        result = isUnsigned ? l.ule(r) : l.sle(r);
+                        break;
+                    case ConditionalOpType::GREATER_OR_EQUAL:
+                        result = isUnsigned ? l.uge(r) : l.sge(r);
                         break;
                 }
+                value.value = generator.m_builder->getInt1(result);
+                return;
             }
 
-            else if(leftType->isFloatingPointTy() && rightType->isFloatingPointTy()){
+            auto * leftFloat = llvm::dyn_cast<llvm::ConstantFP>(lhs.value);
+            auto * rightFloat = llvm::dyn_cast<llvm::ConstantFP>(rhs.value);
+
+            if(leftFloat && rightFloat){
+                llvm::APFloat::cmpResult cmp = leftFloat->getValueAPF().compare(rightFloat->getValueAPF());
+                bool result = false;
+
                 switch(conditionalExpr->type){
                     case ConditionalOpType::EQUAL_TO:
-                        value.value = Builder->CreateFCmpOEQ(lhs.value, rhs.value);
+                        result = cmp == llvm::APFloat::cmpEqual;
                         break;
                     case ConditionalOpType::NOT_EQUAL:
-                        value.value = Builder->CreateFCmpONE(lhs.value, rhs.value);
+                        result = cmp == llvm::APFloat::cmpLessThan || cmp == llvm::APFloat::cmpGreaterThan;
                         break;
                     case ConditionalOpType::LESS_THAN:
-                        value.value = Builder->CreateFCmpOLT(lhs.value, rhs.value);
+                        result = cmp == llvm::APFloat::cmpLessThan;
+                        break;
+                    case ConditionalOpType::GREATER_THAN:
+                        result = cmp == llvm::APFloat::cmpGreaterThan;
+                        break;
+                    case ConditionalOpType::LESS_OR_EQUAL:
+                        result = cmp == llvm::APFloat::cmpLessThan || cmp == llvm::APFloat::cmpEqual;
+                        break;
+                    case ConditionalOpType::GREATER_OR_EQUAL:
+                        result = cmp == llvm::APFloat::cmpGreaterThan || cmp == llvm::APFloat::cmpEqual;
                         break;
                 }
+                value.value = generator.m_builder->getInt1(result);
+                return;
             }
 
-            else{
-                llvm::errs() << "Error Comparison between expressions failed, type mismatch\n";
-            }
+            GetLLVMErrorStream() << "Error Comparison between expressions failed, type mismatch\n";
         }
     };
 
-    ExprVisitor visitor = {*this};
+    ConstantExprVisitor visitor = {*this};
     std::visit(visitor, expr->var);
     return visitor.value;
 }
 
+llvm::Value* Generator::GenCondition(const std::unique_ptr<ExprNode>& expr){
+    TypedValue condition = GenExpr(expr);
+
+    if(condition.value == nullptr){
+        GetLLVMErrorStream() << "ERROR: Failed to generate condition\n";
+        AbortCompilation();
+    }
+
+    llvm::Type* type = condition.value->getType();
+
+    if(type->isIntegerTy(1)){
+        return condition.value;
+    }
+
+    if(type->isIntegerTy()){
+        return m_builder->CreateICmpNE(condition.value, llvm::ConstantInt::get(type, 0));
+    }
+
+    return m_builder->CreateFCmpUNE(condition.value, llvm::ConstantFP::get(type, 0.0));
+}
+
+llvm::MDNode* Generator::GenLoopMetadata(const LoopHints& hints, const llvm::DebugLoc& location){
+    std::vector<llvm::Metadata*> properties;
+
+    auto addProperty = [&](const char* name, llvm::Constant* value){
+        std::vector<llvm::Metadata*> operands = {llvm::MDString::get(*m_context, name)};
+
+        if(value != nullptr){
+            operands.push_back(llvm::ConstantAsMetadata::get(value));
+        }
+
+        properties.push_back(llvm::MDNode::get(*m_context, operands));
+    };
+
+    if(hints.vectorize){
+        addProperty("llvm.loop.vectorize.enable", m_builder->getTrue());
+
+        if(hints.vectorizeWidth != 0){
+            addProperty("llvm.loop.vectorize.width", m_builder->getInt32(hints.vectorizeWidth));
+        }
+    }
+
+    if(hints.unroll){
+        if(hints.unrollCount != 0){
+            addProperty("llvm.loop.unroll.count", m_builder->getInt32(hints.unrollCount));
+        } else {
+            addProperty("llvm.loop.unroll.enable", nullptr);
+        }
+    }
+
+    if(hints.noUnroll){
+        addProperty("llvm.loop.unroll.disable", nullptr);
+    }
+
+    if(properties.empty()){
+        return nullptr;
+    }
+
+    // the first operand of a loop id is the loop id itself, followed by the start location of
+    // the loop, which optimization remarks refer to
+    std::vector<llvm::Metadata*> operands = {nullptr};
+
+    if(location){
+        operands.push_back(location.getAsMDNode());
+    }
+
+    operands.insert(operands.end(), properties.begin(), properties.end());
+
+    llvm::MDNode* loopID = llvm::MDNode::getDistinct(*m_context, operands);
+    loopID->replaceOperandWith(0, loopID);
+    return loopID;
+}
+
+// whether a value of the type can hold an address: pointers, slices and structs of them
+static bool HoldsPointer(llvm::Type* type){
+    if(type->isPointerTy()){
+        return true;
+    }
+
+    return type->isStructTy() && std::any_of(type->subtype_begin(), type->subtype_end(), HoldsPointer);
+}
+
+// whether the value can point into the stack frame of the current function: the address of a
+// local in memory, an element of a local array or a slice of one. musttail frees the frame of
+// the caller before the callee runs, so a call that is given such a value can't be one
+static bool PointsIntoFrame(llvm::Value* value, std::set<llvm::Value*>& visited){
+    if(HoldsPointer(value->getType()) == false || visited.insert(value).second == false){
+        return false;
+    }
+
+    if(llvm::isa<llvm::AllocaInst>(value)){
+        return true;
+    }
+
+    // parameters point into the frames of callers, globals and constants into no frame at all
+    if(llvm::isa<llvm::Argument>(value) || llvm::isa<llvm::GlobalValue>(value) || llvm::isa<llvm::ConstantData>(value)){
+        return false;
+    }
+
+    auto* user = llvm::dyn_cast<llvm::User>(value);
+
+    // slices are built with insertvalue and pointers with GEPs, what they point to is in their
+    // operands. anything else that holds an address, like a loaded pointer, might point into the frame
+    if(user == nullptr || (llvm::isa<llvm::InsertValueInst>(value) == false && llvm::isa<llvm::ExtractValueInst>(value) == false
+        && llvm::isa<llvm::GEPOperator>(value) == false && llvm::isa<llvm::BitCastOperator>(value) == false
+        && llvm::isa<llvm::PHINode>(value) == false && llvm::isa<llvm::SelectInst>(value) == false && llvm::isa<llvm::ConstantAggregate>(value) == false)){
+        return true;
+    }
+
+    for(llvm::Value* operand : user->operands()){
+        if(PointsIntoFrame(operand, visited)){
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void Generator::GenStmt(const std::unique_ptr<StmtNode>& stmt){
     struct StmtVisitor{
         Generator & generator;
 
         void operator()(const std::unique_ptr<CompoundStmtNode>& compoundStmt){
+          // variables declared in the block go out of scope at the end of it
+          std::map<std::string, VarInfo> outerScope = generator.m_namedValues;
 
           for(const auto& stmt : compoundStmt->body){
               generator.GenStmt(stmt);
           }
 
+          generator.m_namedValues = outerScope;
+
           return;
         }
         
         void operator()(const std::unique_ptr<DeclerationStmtNode>& decleration){
-            llvm::Type * VarType = generator.GetTypeFromToken(decleration->type.type);
+            llvm::Type * VarType = generator.GetTypeFromToken(decleration->type);
             if (!VarType) return;
 
-            if (CurrentFunc == nullptr) {
-                llvm::Constant * Initializer = nullptr;
-                if (VarType->isIntegerTy()) {
-                    Initializer = llvm::ConstantInt::get(VarType, 0);
-                } else if (VarType->isFloatTy()) {
-                    Initializer = llvm::ConstantFP::get(VarType, 0.0);
-                } else {
+            if (generator.m_currentFunc == nullptr) {
+                if (VarType->isVoidTy()) {
                     return;
                 }
 
+                llvm::Constant * Initializer = llvm::Constant::getNullValue(VarType);
+
+                // initializers are folded at compile time so no runtime constructor is needed
+                if(decleration->expression.has_value()){
+                    TypedValue InitialValue = generator.GenConstantExpr(decleration->expression.value());
+
+                    if(InitialValue.value == nullptr){
+                        GetLLVMErrorStream() << "ERROR: Failed to evaluate initializer of global variable: " << decleration->identifier.value.value() << "\n";
+                        AbortCompilation();
+                    }
+
+                    llvm::Constant * Value = llvm::cast<llvm::Constant>(generator.ConvertToType(InitialValue, VarType, IsUnsignedType(decleration->type.type)));
+
+                    if(Value->getType() != VarType){
+                        GetLLVMErrorStream() << "ERROR: Type mismatch in initializer of global variable: " << decleration->identifier.value.value() << "\n";
+                        AbortCompilation();
+                    }
+
+                    Initializer = Value;
+                }
+
+                // globals that are never written to become read only data
+                bool isConstant = decleration->isWritten == false;
+
+                llvm::GlobalValue::LinkageTypes linkage = llvm::GlobalValue::ExternalLinkage;
+
+                // other units only declare the global. constants keep their initializer so they
+                // can still be folded, the definition itself is emitted by unit 0
+                if(generator.m_unit != nullptr && generator.m_unit->index != 0){
+                    if(isConstant){
+                        linkage = llvm::GlobalValue::AvailableExternallyLinkage;
+                    } else {
+                        Initializer = nullptr;
+                    }
+                }
+
                 llvm::GlobalVariable* GlobalVar = new llvm::GlobalVariable(
-                    *TheModule, VarType, false,
-                    llvm::GlobalValue::ExternalLinkage,
+                    *generator.m_module, VarType, isConstant,
+                    linkage,
                     Initializer,
                     decleration->identifier.value.value()
                 );
+
+                if(isConstant){
+                    GlobalVar->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+                }
+
+                llvm::Type* elementType = generator.GetElementType(decleration->type);
+
+                // @align and @cacheline_pad structs and arrays of them
+                if(const StructInfo* layout = generator.GetStructInfo(elementType != nullptr ? elementType : VarType)){
+                    GlobalVar->setAlignment(layout->alignment);
+                }
                 
-                GlobalValues[decleration->identifier.value.value()] = GlobalVar;
+                GlobalInfo info;
+                info.global = GlobalVar;
+                info.isUnsigned = IsUnsignedType(decleration->type.type);
+                info.elementType = elementType;
+                generator.m_globalValues[decleration->identifier.value.value()] = info;
                 return;
 
             } else {
-                llvm::AllocaInst* Alloc = CreateEntryBlockAlloca(CurrentFunc, VarType, decleration->identifier.value.value());
+                VarInfo info;
+                info.isUnsigned = IsUnsignedType(decleration->type.type);
+                info.type = VarType;
+                info.name = decleration->identifier.value.value();
+                info.id = generator.m_nextVariableId++;
+                info.elementType = generator.GetElementType(decleration->type);
+
+                // scalars, structs, slices and pointers don't need memory unless their address is taken.
+                // arrays of a @soa struct are structs too, but they are arrays
+                bool isArray = decleration->type.arrayLength != 0;
+                // atomics are accessed through their address, so they live in memory too. pointers
+                // to atomics and slices of them are plain values
+                const StructInfo* structInfo = generator.GetStructInfo(VarType);
+                bool isAtomicValue = decleration->type.isAtomic && decleration->type.isPointer == false && decleration->type.isSlice == false;
+                bool hasAtomics = isAtomicValue || (structInfo != nullptr && structInfo->hasAtomics);
+                bool isPromotable = isArray == false && decleration->isAddressTaken == false && hasAtomics == false
+                    && (VarType->isIntOrIntVectorTy() || VarType->isFPOrFPVectorTy() || VarType->isStructTy() || VarType->isPointerTy());
+                info.alloca = isPromotable ? nullptr : CreateEntryBlockAlloca(generator.m_currentFunc, VarType, info.name);
+
+                // arrays start out as 0 every time their decleration is reached
+                if (isArray) {
+                    if(const StructInfo* layout = generator.GetStructInfo(info.elementType)){
+                        info.alloca->setAlignment(std::max(info.alloca->getAlign(), layout->alignment));
+                    }
+
+                    const llvm::DataLayout& layout = generator.m_module->getDataLayout();
+                    generator.m_builder->CreateMemSet(info.alloca, generator.m_builder->getInt8(0), layout.getTypeAllocSize(VarType).getFixedValue(), info.alloca->getAlign());
+                }
+
+                // a slice without an initializer has no elements, the fields of a struct start as 0. a
+                // variable in memory starts as 0 too, a pointer to it could read it before it is written
+                if (isPromotable && (VarType->isStructTy() || VarType->isPointerTy()) && decleration->expression.has_value() == false) {
+                    generator.WriteVariable(info, generator.m_builder->GetInsertBlock(), llvm::Constant::getNullValue(VarType));
+                }
+                else if (isArray == false && isPromotable == false && decleration->expression.has_value() == false) {
+                    generator.GenStore(llvm::Constant::getNullValue(VarType), info.alloca);
+                }
                 
-                if (VarType->isIntegerTy(32) || VarType->isFloatTy()) {
+                if (isArray == false) {
                     if(decleration->expression.has_value()){
                         TypedValue InitialValue = generator.GenExpr(decleration->expression.value());
                         if (InitialValue.value) {
-                            Builder->CreateStore(InitialValue.value, Alloc);
+                            llvm::Value* converted = generator.ConvertToType(InitialValue, VarType, info.isUnsigned);
+
+                            if(info.alloca != nullptr){
+                                generator.GenStore(converted, info.alloca);
+                            } else {
+                                generator.WriteVariable(info, generator.m_builder->GetInsertBlock(), converted);
+                            }
                         } else {
-                            llvm::errs() << "ERROR: Failed to generate IR for initializer expression of variable: " << decleration->identifier.value.value() << "\n";
+                            GetLLVMErrorStream() << "ERROR: Failed to generate IR for initializer expression of variable: " << decleration->identifier.value.value() << "\n";
                         }
                     }
                 }
                 
-                VarInfo info;
-                info.isUnsigned = (decleration->type.type == TokenType::UINT);
-                info.alloca = Alloc;
-                NamedValues[decleration->identifier.value.value()] = info;
+                generator.m_namedValues[decleration->identifier.value.value()] = info;
                 return;
             }
         }
 
         void operator()(const std::unique_ptr<FunctionNode>& Function){
+            // generic functions are generated through their instantiations
+            if(Function->prototype->typeParams.empty() == false){
+                return;
+            }
 
-            llvm::Type* ReturnType = generator.GetTypeFromToken(Function->prototype->returnType.type);
-            
-            if (!ReturnType) {
-                llvm::errs() << "DEBUG: Function Gen failed - ReturnType is null for function: " 
-                             << Function->prototype->name.value.value() << "\n";
+            // the body belongs to another codegen unit
+            if(generator.m_unit != nullptr && generator.m_unit->functions.contains(Function.get()) == false){
                 return;
-            } 
+            }
+
+            llvm::Function* func = generator.m_module->getFunction(Function->prototype->name.value.value());
+
+            if(func == nullptr){
+                func = generator.GenPrototype(Function->prototype);
+            }
+
+            if(func == nullptr){
+                return;
+            }
+
+            llvm::Type* ReturnType = func->getReturnType();
+
+            llvm::BasicBlock* entryBB = llvm::BasicBlock::Create(*generator.m_context, "entry", func);
+            generator.m_builder->SetInsertPoint(entryBB);
+
+            generator.m_namedValues.clear();
+            generator.m_currentDef.clear();
+            generator.m_incompletePhis.clear();
+            generator.m_sealedBlocks.clear();
+            generator.m_currentFunc = func;
+            generator.m_currentProto = Function->prototype.get();
+            generator.m_trapBlock = nullptr;
+
+            // the builder puts the flags on every float operation and comparison it creates
+            const FastMathAttribute& fastMath = Function->fastMath;
+            llvm::FastMathFlags flags;
 
-            llvm::FunctionType * funcType = nullptr;
+            if(generator.m_fastMath){
+                flags.setFast();
+            } else {
+                flags.setAllowReassoc(fastMath.reassoc);
+                flags.setAllowContract(fastMath.contract);
+                flags.setAllowReciprocal(fastMath.arcp);
+                flags.setNoNaNs(fastMath.nnan);
+                flags.setNoInfs(fastMath.ninf);
+                flags.setNoSignedZeros(fastMath.nsz);
+                flags.setApproxFunc(fastMath.afn);
+            }
+
+            generator.m_builder->setFastMathFlags(flags);
+
+            // the entry block never gets predecessors
+            generator.SealBlock(entryBB);
 
-            if(Function->prototype->argCounter == 0){
-                funcType = llvm::FunctionType::get(ReturnType, false);
-            } else{
-                funcType = llvm::FunctionType::get(ReturnType, false);
+            // parameters are variables whose definition in the entry block is the argument
+            for(size_t i = 0; i < Function->prototype->params.size(); i++){
+                const ParamNode& param = Function->prototype->params[i];
+
+                VarInfo info;
+                info.alloca = nullptr;
+                info.isUnsigned = IsUnsignedType(param.type.type);
+                info.type = func->getArg(i)->getType();
+                info.name = param.identifier.value.value();
+                info.id = generator.m_nextVariableId++;
+                info.elementType = generator.GetElementType(param.type);
+
+                generator.WriteVariable(info, entryBB, func->getArg(i));
+                generator.m_namedValues[info.name] = info;
             }
 
-            llvm::Function* func = llvm::Function::Create(
-                funcType,
-                llvm::Function::ExternalLinkage,
-                Function->prototype->name.value.value().c_str(),
-                TheModule.get()
-            );
+            if(generator.m_debugBuilder != nullptr){
+                const Token& name = Function->prototype->name;
+                llvm::DISubroutineType* type = generator.m_debugBuilder->createSubroutineType(generator.m_debugBuilder->getOrCreateTypeArray({}));
 
-            llvm::BasicBlock* entryBB = llvm::BasicBlock::Create(*TheContext, "entry", func);
-            Builder->SetInsertPoint(entryBB);
+                generator.m_debugFunction = generator.m_debugBuilder->createFunction(
+                    generator.m_debugFile, name.value.value(), llvm::StringRef(), generator.m_debugFile,
+                    name.line, type, name.line, llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition
+                );
 
-            NamedValues.clear();
-            CurrentFunc = func;
+                func->setSubprogram(generator.m_debugFunction);
+                generator.SetDebugLocation(name.line, name.column);
+            }
 
             for(const auto& stmt : Function->body){
                 generator.GenStmt(stmt);
             }
 
-            if (Builder->GetInsertBlock()->getTerminator() == NULL) {
+            if (generator.m_builder->GetInsertBlock()->getTerminator() == NULL) {
                 if (ReturnType->isVoidTy()) {
-                    Builder->CreateRetVoid();
+                    generator.m_builder->CreateRetVoid();
                 } else {
-                    Builder->CreateRet(llvm::Constant::getNullValue(ReturnType));
+                    generator.m_builder->CreateRet(llvm::Constant::getNullValue(ReturnType));
                 }
             }
 
             llvm::verifyFunction(*func);
-            CurrentFunc = nullptr;
+            generator.m_currentFunc = nullptr;
+            generator.m_currentProto = nullptr;
+            generator.m_builder->clearFastMathFlags();
+
+            if(generator.m_debugFunction != nullptr){
+                generator.m_debugBuilder->finalizeSubprogram(generator.m_debugFunction);
+                generator.m_debugFunction = nullptr;
+                generator.m_builder->SetCurrentDebugLocation(llvm::DebugLoc());
+            }
+
+            if(generator.m_tierEntries){
+                generator.GenTierEntry(func);
+            }
         }
 
         void operator()(const std::unique_ptr<AssignmentNode>& assignment){
-            if(CurrentFunc != nullptr){
-                if(NamedValues.find(assignment->identifier.value.value()) == NamedValues.end()){
-                    llvm::errs() << "ERROR: Variable is uninitialized\n";
-                    exit(EXIT_FAILURE);
+            // the index is evaluated before the value, a[i] += x loads and stores the same element
+            if(assignment->index && generator.m_currentFunc != nullptr){
+                SliceValue slice = generator.GenSlice(assignment->identifier);
+                llvm::Value* position = generator.GenIndex(slice, assignment->index, assignment->boundsCheck);
+
+                llvm::Type* type = slice.elementType;
+                bool isUnsigned = slice.isUnsigned;
+                std::vector<unsigned> path = generator.GetFieldPath(type, isUnsigned, assignment->fields);
+
+                // a whole @soa element is stored to every field array
+                bool scatter = path.empty() && slice.fieldPointers.empty() == false;
+                llvm::Value* element = scatter ? nullptr : generator.GenElementPointer(slice, position, path);
+                TypedValue newValue = generator.GenExpr(assignment->expression);
+
+                if(newValue.value == nullptr){
+                    GetLLVMErrorStream() << "ERROR: Unexpected error generating expression for assignment operation\n";
+                    return;
+                }
+
+                if(assignment->compoundType.has_value()){
+                    TypedValue current = {generator.GenLoad(type, element), isUnsigned};
+                    newValue = generator.GenBinOp(assignment->compoundType.value(), current, newValue);
+                }
+
+                if(scatter){
+                    generator.GenScatterElement(slice, position, newValue.value);
+                    return;
+                }
+
+                generator.GenStore(generator.ConvertToType(newValue, type, isUnsigned), element);
+                return;
+            }
+
+            if(assignment->fields.empty() == false && generator.m_currentFunc != nullptr){
+                std::string name = assignment->identifier.value.value();
+
+                // a local struct is a value in an SSA register, the assignment creates a new value with the field replaced.
+                // globals and locals whose address is taken store to the field in memory
+                if(generator.m_namedValues.find(name) != generator.m_namedValues.end() && generator.m_namedValues.at(name).alloca == nullptr){
+                    VarInfo& info = generator.m_namedValues.at(name);
+                    llvm::Type* type = info.type;
+                    bool isUnsigned = info.isUnsigned;
+                    std::vector<unsigned> path = generator.GetFieldPath(type, isUnsigned, assignment->fields);
+
+                    TypedValue newValue = generator.GenExpr(assignment->expression);
+
+                    if(newValue.value == nullptr){
+                        GetLLVMErrorStream() << "ERROR: Unexpected error generating expression for assignment operation\n";
+                        return;
+                    }
+
+                    // read after the value, which may have moved the insert point to another block
+                    llvm::Value* current = generator.ReadVariable(info, generator.m_builder->GetInsertBlock());
+
+                    if(assignment->compoundType.has_value()){
+                        newValue = generator.GenBinOp(assignment->compoundType.value(), {generator.m_builder->CreateExtractValue(current, path), isUnsigned}, newValue);
+                    }
+
+                    llvm::Value* updated = generator.m_builder->CreateInsertValue(current, generator.ConvertToType(newValue, type, isUnsigned), path);
+                    generator.WriteVariable(info, generator.m_builder->GetInsertBlock(), updated);
+                    return;
+                }
+
+                llvm::Type* type = nullptr;
+                bool isUnsigned = false;
+                llvm::Value* field = generator.GenVariablePointer(name, type, isUnsigned, assignment->fields);
+                TypedValue newValue = generator.GenExpr(assignment->expression);
+
+                if(newValue.value == nullptr){
+                    GetLLVMErrorStream() << "ERROR: Unexpected error generating expression for assignment operation\n";
+                    return;
+                }
+
+                if(assignment->compoundType.has_value()){
+                    newValue = generator.GenBinOp(assignment->compoundType.value(), {generator.GenLoad(type, field), isUnsigned}, newValue);
+                }
+
+                generator.GenStore(generator.ConvertToType(newValue, type, isUnsigned), field);
+                return;
+            }
+
+            if(generator.m_currentFunc != nullptr){
+                if(generator.m_namedValues.find(assignment->identifier.value.value()) == generator.m_namedValues.end()){
+                    if(generator.m_globalValues.find(assignment->identifier.value.value()) != generator.m_globalValues.end()){
+                        TypedValue newValue = generator.GenExpr(assignment->expression);
+
+                        if(newValue.value){
+                            llvm::GlobalVariable* global = generator.m_globalValues.at(assignment->identifier.value.value()).global;
+                            generator.GenStore(generator.ConvertToType(newValue, global->getValueType()), global);
+                        } else {
+                            GetLLVMErrorStream() << "ERROR: Unexpected error generating expression for assignment operation\n";
+                        }
+                        return;
+                    }
+
+                    GetLLVMErrorStream() << "ERROR: Variable is uninitialized\n";
+                    AbortCompilation();
                 }
                 
                 TypedValue newValue = generator.GenExpr(assignment->expression);
-                VarInfo& info = NamedValues.at(assignment->identifier.value.value());
+                VarInfo& info = generator.m_namedValues.at(assignment->identifier.value.value());
 
                 if(newValue.value){
-                    Builder->CreateStore(newValue.value, info.alloca);
+                    llvm::Value* converted = generator.ConvertToType(newValue, info.type);
+
+                    if(info.alloca != nullptr){
+                        generator.GenStore(converted, info.alloca);
+                    } else {
+                        generator.WriteVariable(info, generator.m_builder->GetInsertBlock(), converted);
+                    }
                 } else {
-                    llvm::errs() << "ERROR: Unexpected error generating expression for assignment operation\n";
+                    GetLLVMErrorStream() << "ERROR: Unexpected error generating expression for assignment operation\n";
                 }
             }
         }
 
         void operator()(const std::unique_ptr<IfStmtNode>& ifStmt){
-            if(CurrentFunc == nullptr){
-                llvm::errs() << "ERROR: If statement must be contained within a function\n";
-                exit(EXIT_FAILURE);
+            if(generator.m_currentFunc == nullptr){
+                GetLLVMErrorStream() << "ERROR: If statement must be contained within a function\n";
+                AbortCompilation();
             }
 
-            TypedValue condition = generator.GenExpr(ifStmt->condition);
+            llvm::Value* condition = generator.GenCondition(ifStmt->condition);
 
-            llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(*TheContext, "then", CurrentFunc);
-            llvm::BasicBlock* elseBB = llvm::BasicBlock::Create(*TheContext, "else", CurrentFunc);
-            llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(*TheContext, "merge", CurrentFunc);
+            // branches that leave the bodies belong to the if, not to the last statement of a body
+            llvm::DebugLoc ifLocation = generator.m_builder->getCurrentDebugLocation();
 
-            Builder->CreateCondBr(condition.value, thenBB, elseBB);
-            Builder->SetInsertPoint(thenBB);
+            llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(*generator.m_context, "then", generator.m_currentFunc);
+            llvm::BasicBlock* elseBB = llvm::BasicBlock::Create(*generator.m_context, "else", generator.m_currentFunc);
+            llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(*generator.m_context, "merge", generator.m_currentFunc);
+
+            generator.m_builder->CreateCondBr(condition, thenBB, elseBB);
+            generator.SealBlock(thenBB);
+            generator.SealBlock(elseBB);
+            generator.m_builder->SetInsertPoint(thenBB);
+
+            std::map<std::string, VarInfo> outerScope = generator.m_namedValues;
 
             for (const auto& stmt : ifStmt->thenBody) {
                 generator.GenStmt(stmt);
             }
-            if (!Builder->GetInsertBlock()->getTerminator()) {
-                Builder->CreateBr(mergeBB);
+            generator.m_namedValues = outerScope;
+            generator.m_builder->SetCurrentDebugLocation(ifLocation);
+
+            if (!generator.m_builder->GetInsertBlock()->getTerminator()) {
+                generator.m_builder->CreateBr(mergeBB);
             }
 
-            Builder->SetInsertPoint(elseBB);
+            generator.m_builder->SetInsertPoint(elseBB);
             if (!ifStmt->elseBody.empty()) {
                 for (const auto& stmt : ifStmt->elseBody) {
                     generator.GenStmt(stmt);
                 }
+                generator.m_namedValues = outerScope;
+                generator.m_builder->SetCurrentDebugLocation(ifLocation);
+            }
+            if (!generator.m_builder->GetInsertBlock()->getTerminator()) {
+                generator.m_builder->CreateBr(mergeBB);
+            }
+
+            // when both branches return, the statements after the if are unreachable. the insert
+            // block stays terminated so they are skipped, see GenStmt
+            if (llvm::pred_empty(mergeBB)) {
+                mergeBB->eraseFromParent();
+                return;
+            }
+
+            // both branches are done, so merge has all of its predecessors
+            generator.SealBlock(mergeBB);
+            generator.m_builder->SetInsertPoint(mergeBB);
+        }
+
+        // lowers a loop in the form LLVM's loop passes expect: the current block only branches
+        // to the header, so it is the preheader, the body ends in a single latch and the loop
+        // has a single exit block. the hints go on the back edge, the branch of the latch
+        void GenLoop(const std::unique_ptr<ExprNode>& condition, const std::vector<std::unique_ptr<StmtNode>>& body, const std::unique_ptr<AssignmentNode>& step, const LoopHints& hints){
+            if(generator.m_currentFunc == nullptr){
+                GetLLVMErrorStream() << "ERROR: Loop must be contained within a function\n";
+                AbortCompilation();
+            }
+
+            llvm::DebugLoc loopLocation = generator.m_builder->getCurrentDebugLocation();
+
+            llvm::BasicBlock* headerBB = llvm::BasicBlock::Create(*generator.m_context, "loop.header", generator.m_currentFunc);
+            llvm::BasicBlock* bodyBB = llvm::BasicBlock::Create(*generator.m_context, "loop.body", generator.m_currentFunc);
+            llvm::BasicBlock* latchBB = llvm::BasicBlock::Create(*generator.m_context, "loop.latch", generator.m_currentFunc);
+            llvm::BasicBlock* exitBB = llvm::BasicBlock::Create(*generator.m_context, "loop.exit", generator.m_currentFunc);
+
+            generator.m_builder->CreateBr(headerBB);
+            generator.m_builder->SetInsertPoint(headerBB);
+
+            // the header stays unsealed until the back edge exists, variables read in the loop get phis
+            if(condition){
+                generator.m_builder->CreateCondBr(generator.GenCondition(condition), bodyBB, exitBB);
+            } else {
+                generator.m_builder->CreateBr(bodyBB);
+            }
+
+            generator.SealBlock(bodyBB);
+            generator.SealBlock(exitBB);
+            generator.m_builder->SetInsertPoint(bodyBB);
+
+            std::map<std::string, VarInfo> outerScope = generator.m_namedValues;
+
+            for(const auto& stmt : body){
+                generator.GenStmt(stmt);
+            }
+            generator.m_namedValues = outerScope;
+            generator.m_builder->SetCurrentDebugLocation(loopLocation);
+
+            if(!generator.m_builder->GetInsertBlock()->getTerminator()){
+                generator.m_builder->CreateBr(latchBB);
+            }
+
+            generator.SealBlock(latchBB);
+            generator.m_builder->SetInsertPoint(latchBB);
+
+            if(step){
+                (*this)(step);
+            }
+
+            llvm::BranchInst* backEdge = generator.m_builder->CreateBr(headerBB);
+
+            if(llvm::MDNode* loopID = generator.GenLoopMetadata(hints, loopLocation)){
+                backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+            }
+
+            generator.SealBlock(headerBB);
+
+            // a loop without a condition is only left by returning, nothing after it is reachable
+            if(llvm::pred_empty(exitBB)){
+                generator.m_sealedBlocks.erase(exitBB);
+                exitBB->eraseFromParent();
+                return;
+            }
+
+            generator.m_builder->SetInsertPoint(exitBB);
+        }
+
+        void operator()(const std::unique_ptr<WhileStmtNode>& whileStmt){
+            GenLoop(whileStmt->condition, whileStmt->body, nullptr, whileStmt->hints);
+        }
+
+        void operator()(const std::unique_ptr<ForStmtNode>& forStmt){
+            // the variables of init are only visible inside the loop
+            std::map<std::string, VarInfo> outerScope = generator.m_namedValues;
+            llvm::DebugLoc forLocation = generator.m_builder->getCurrentDebugLocation();
+
+            if(forStmt->init){
+                generator.GenStmt(forStmt->init);
+                generator.m_builder->SetCurrentDebugLocation(forLocation);
+            }
+
+            GenLoop(forStmt->condition, forStmt->body, forStmt->step, forStmt->hints);
+            generator.m_namedValues = outerScope;
+        }
+
+        // a call of the current function itself, the only kind of call that is emitted as musttail
+        const CallExprNode* GetSelfCall(const std::unique_ptr<ExprNode>& expr){
+            if(std::holds_alternative<std::unique_ptr<PrimaryExprNode>>(expr->var) == false){
+                return nullptr;
+            }
+
+            const auto& primary = std::get<std::unique_ptr<PrimaryExprNode>>(expr->var);
+
+            if(std::holds_alternative<std::unique_ptr<CallExprNode>>(primary->var) == false){
+                return nullptr;
+            }
+
+            const auto& call = std::get<std::unique_ptr<CallExprNode>>(primary->var);
+            return call->callee.value.value() == generator.m_currentProto->name.value.value() ? call.get() : nullptr;
+        }
+
+        void operator()(const std::unique_ptr<ReturnNode>& returnStmt){
+            if(generator.m_currentFunc == nullptr){
+                GetLLVMErrorStream() << "ERROR: Return outside of a function\n";
+                return;
+            }
+
+            llvm::Type* returnType = generator.m_currentFunc->getReturnType();
+
+            if(returnStmt->value == nullptr){
+                generator.m_builder->CreateRetVoid();
+            }
+            else if(GetSelfCall(returnStmt->value) != nullptr){
+                // self recursive tail calls reuse the frame of the caller, so deep recursion runs
+                // in constant stack space even without optimizations. not when an argument points
+                // into that frame, the callee would read memory that is already reused
+                const auto& primary = std::get<std::unique_ptr<PrimaryExprNode>>(returnStmt->value->var);
+                TypedValue call = generator.GenCall(std::get<std::unique_ptr<CallExprNode>>(primary->var));
+                auto* callInst = llvm::cast<llvm::CallInst>(call.value);
+                std::set<llvm::Value*> visited;
+
+                bool isFrameFree = std::none_of(callInst->arg_begin(), callInst->arg_end(), [&](llvm::Value* arg){ return PointsIntoFrame(arg, visited); });
+
+                if(isFrameFree){
+                    callInst->setTailCallKind(llvm::CallInst::TCK_MustTail);
+                }
+
+                if(returnType->isVoidTy()){
+                    generator.m_builder->CreateRetVoid();
+                } else {
+                    generator.m_builder->CreateRet(call.value);
+                }
             }
-            if (!Builder->GetInsertBlock()->getTerminator()) {
-                Builder->CreateBr(mergeBB);
+            else {
+                TypedValue value = generator.GenExpr(returnStmt->value);
+                llvm::Value* converted = value.value == nullptr ? nullptr : generator.ConvertToType(value, returnType);
+
+                if(converted == nullptr || converted->getType() != returnType){
+                    GetLLVMErrorStream() << "ERROR: Return value of " << generator.m_currentProto->name.value.value() << " has the wrong type\n";
+                    AbortCompilation();
+                }
+
+                generator.m_builder->CreateRet(converted);
             }
+        }
 
-            Builder->SetInsertPoint(mergeBB);
+        void operator()(const std::unique_ptr<ExprStmtNode>& exprStmt){
+            generator.GenExpr(exprStmt->expression);
         }
     };
 
+    // statements after a return are unreachable and not generated, so no block without
+    // predecessors feeds undef into the phis of the blocks after it
+    if(m_currentFunc != nullptr && m_builder->GetInsertBlock() != nullptr && m_builder->GetInsertBlock()->getTerminator() != nullptr){
+        return;
+    }
+
+    SetDebugLocation(stmt->line, stmt->column);
     std::visit(StmtVisitor{*this}, stmt->var);
 }
 
-void Generator::Generate(const std::unique_ptr<ProgNode>& prog){
+void Generator::Generate(const std::unique_ptr<ProgNode>& prog, const CodegenUnit* unit){
+    m_unit = unit;
     InitializeModule();
 
+    if(m_unit != nullptr){
+        m_module->setModuleIdentifier("XD Compiler." + std::to_string(m_unit->index));
+    }
+
+    if(m_targetMachine != nullptr){
+        m_module->setDataLayout(m_targetMachine->createDataLayout());
+#if LLVM_VERSION_MAJOR >= 21
+        m_module->setTargetTriple(m_targetMachine->getTargetTriple());
+#else
+        m_module->setTargetTriple(m_targetMachine->getTargetTriple().str());
+#endif
+    }
+
+    // the layout of a struct depends on the data layout, and the types of its fields on earlier structs
+    for(const auto& structNode : prog->structs){
+        GenStruct(*structNode);
+    }
+
+    // declares every function first so calls can refer to functions defined further down
+    for(const auto& stmt : prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var)){
+            const auto& function = std::get<std::unique_ptr<FunctionNode>>(stmt->var);
+
+            if(function->prototype->typeParams.empty()){
+                GenPrototype(function->prototype);
+            }
+        }
+    }
+
     for(const auto& stmt : prog->stmts){
         Generator::GenStmt(stmt);
     }
 
-    TheModule->print(llvm::errs(), nullptr);
+    if(m_debugBuilder != nullptr){
+        m_debugBuilder->finalize();
+    }
+}
+
+llvm::Module& Generator::GetModule(){
+    return *m_module;
+}
+
+GeneratedModule Generator::TakeModule(){
+    GeneratedModule generated;
+
+    // the builders refer to the module and context, so they go first
+    m_debugBuilder.reset();
+    m_builder.reset();
+    generated.module = std::move(m_module);
+    generated.context = std::move(m_context);
+
+    return generated;
 }
@@ -0,0 +1,322 @@
+#include "hotswap.hpp"
+#include "diagnostics.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "analysis.hpp"
+#include "profiling.hpp"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include <functional>
+
+// removes the declarations the module doesn't use and hashes what is left. the fingerprint of a
+// function module changes with the function itself or the declarations of what it calls, but not
+// with unrelated functions
+static size_t FingerprintModule(llvm::Module& module){
+    for(llvm::Function& function : llvm::make_early_inc_range(module.functions())){
+        if(function.isDeclaration() && function.use_empty()){
+            function.eraseFromParent();
+        }
+    }
+
+    for(llvm::GlobalVariable& global : llvm::make_early_inc_range(module.globals())){
+        if(global.isDeclaration() && global.use_empty()){
+            global.eraseFromParent();
+        }
+    }
+
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    module.print(stream, nullptr);
+    stream.flush();
+
+    return std::hash<std::string>{}(text);
+}
+
+HotSwapJit::HotSwapJit(const Options& options) : m_options(options){
+    InitializeTargets();
+
+    auto targetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+    if(!targetMachineBuilder){
+        llvm::errs() << "ERROR: Could not detect the host for the JIT: " << llvm::toString(targetMachineBuilder.takeError()) << "\n";
+        return;
+    }
+
+    targetMachineBuilder->setCodeGenOptLevel(GetCodeGenOptLevel(options.optLevel));
+
+    llvm::orc::LLJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(*targetMachineBuilder));
+
+    if(options.perf){
+        builder.setObjectLinkingLayerCreator([](llvm::orc::ExecutionSession& session, auto&&...) -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+            return CreateProfiledObjectLayer(session);
+        });
+    }
+
+    auto jit = builder.create();
+
+    if(!jit){
+        llvm::errs() << "ERROR: Could not create the JIT: " << llvm::toString(jit.takeError()) << "\n";
+        return;
+    }
+
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+
+    if(!processSymbols){
+        llvm::errs() << "ERROR: Could not load process symbols: " << llvm::toString(processSymbols.takeError()) << "\n";
+        return;
+    }
+
+    (*jit)->getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+    m_stubs = llvm::orc::createLocalIndirectStubsManagerBuilder((*jit)->getTargetTriple())();
+
+    if(m_stubs == nullptr){
+        llvm::errs() << "ERROR: Indirect stubs are not supported on " << (*jit)->getTargetTriple().str() << "\n";
+        return;
+    }
+
+    m_jit = std::move(*jit);
+    m_emitter = std::make_unique<Emitter>(options.optLevel, options.cpu);
+    m_optimizer = std::make_unique<Optimizer>(options.optLevel, m_emitter->GetTargetMachine());
+}
+
+bool HotSwapJit::IsValid(){
+    return m_jit != nullptr && m_emitter->GetTargetMachine() != nullptr;
+}
+
+bool HotSwapJit::LookupAddress(const std::string& name, StubAddress& address){
+    auto symbol = m_jit->lookup(name);
+
+    if(!symbol){
+        llvm::errs() << "ERROR: Could not find " << name << ": " << llvm::toString(symbol.takeError()) << "\n";
+        return false;
+    }
+
+#if LLVM_VERSION_MAJOR >= 17
+    address = *symbol;
+#elif LLVM_VERSION_MAJOR >= 15
+    address = symbol->getValue();
+#else
+    address = symbol->getAddress();
+#endif
+
+    return true;
+}
+
+bool HotSwapJit::AddModule(GeneratedModule generated){
+    generated.module->setDataLayout(m_jit->getDataLayout());
+
+    llvm::orc::ThreadSafeModule module(std::move(generated.module), std::move(generated.context));
+
+    if(llvm::Error error = m_jit->addIRModule(std::move(module))){
+        llvm::errs() << "ERROR: Could not add module to the JIT: " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool HotSwapJit::Load(const std::string& source){
+    std::lock_guard<std::mutex> lock(m_loadMutex);
+    m_swapped.clear();
+
+    if(!IsValid()){
+        return false;
+    }
+
+    // a broken source must not end the session, the code that runs stays live
+    try{
+        return Swap(source);
+    }
+    catch(const CompilationAborted&){
+        llvm::errs() << "ERROR: The source has errors, nothing was swapped\n";
+        return false;
+    }
+}
+
+bool HotSwapJit::Swap(const std::string& source){
+    Lexer lex(source);
+    std::vector<Token> tokens = lex.lex();
+
+    Parser parser(tokens);
+    auto prog = parser.Parse();
+
+    Analyzer analyzer;
+
+    if(analyzer.Analyze(prog) == false){
+        return false;
+    }
+
+    // whether a global is written depends on every function, so globals are never folded into
+    // constants here. otherwise editing one function could change the globals under the others
+    for(const auto& stmt : prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<DeclerationStmtNode>>(stmt->var)){
+            std::get<std::unique_ptr<DeclerationStmtNode>>(stmt->var)->isWritten = true;
+        }
+    }
+
+    // unit 0 without functions defines the globals, function units only declare them
+    CodegenUnit globalsUnit = {0, {}};
+    Generator globalsGenerator(m_emitter->GetTargetMachine());
+
+    if(m_options.checkedArithmetic){
+        globalsGenerator.EnableCheckedArithmetic();
+    }
+
+    if(m_options.fastMath){
+        globalsGenerator.EnableFastMath();
+    }
+
+    globalsGenerator.Generate(prog, &globalsUnit);
+
+    GeneratedModule globals = globalsGenerator.TakeModule();
+    size_t globalsFingerprint = FingerprintModule(*globals.module);
+
+    if(m_globalsFingerprint.has_value() && *m_globalsFingerprint != globalsFingerprint){
+        llvm::errs() << "ERROR: Globals changed, restart to apply the new source\n";
+        return false;
+    }
+
+    struct ChangedFunction{
+        std::string name;
+        GeneratedModule generated;
+        FunctionVersion version;
+    };
+
+    std::vector<ChangedFunction> changed;
+
+    for(const auto& stmt : prog->stmts){
+        if(std::holds_alternative<std::unique_ptr<FunctionNode>>(stmt->var) == false){
+            continue;
+        }
+
+        const auto& function = std::get<std::unique_ptr<FunctionNode>>(stmt->var);
+
+        if(function->prototype->typeParams.empty() == false){
+            continue;
+        }
+
+        std::string name = function->prototype->name.value.value();
+
+        CodegenUnit unit = {1, {function.get()}};
+        Generator generator(m_emitter->GetTargetMachine());
+
+        if(m_options.checkedArithmetic){
+            generator.EnableCheckedArithmetic();
+        }
+
+        if(m_options.fastMath){
+            generator.EnableFastMath();
+        }
+
+        generator.Generate(prog, &unit);
+
+        GeneratedModule generated = generator.TakeModule();
+        size_t fingerprint = FingerprintModule(*generated.module);
+
+        auto current = m_functions.find(name);
+
+        if(current != m_functions.end() && current->second.fingerprint == fingerprint){
+            continue;
+        }
+
+        unsigned version = current == m_functions.end() ? 1 : current->second.version + 1;
+
+        // the body gets a name of its own, <name> is the stub. recursive calls stay on this version
+        generated.module->getFunction(name)->setName(name + ".v" + std::to_string(version));
+
+        changed.push_back({name, std::move(generated), {fingerprint, version}});
+    }
+
+    if(m_globalsFingerprint.has_value() == false){
+        if(AddModule(std::move(globals)) == false){
+            return false;
+        }
+
+        m_globalsFingerprint = globalsFingerprint;
+    }
+
+    // stubs of new functions exist before any code that calls them is linked
+    llvm::orc::SymbolMap stubSymbols;
+
+    for(const ChangedFunction& function : changed){
+        if(m_functions.find(function.name) != m_functions.end()){
+            continue;
+        }
+
+        if(llvm::Error error = m_stubs->createStub(function.name, StubAddress(), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable)){
+            llvm::errs() << "ERROR: Could not create stub for " << function.name << ": " << llvm::toString(std::move(error)) << "\n";
+            return false;
+        }
+
+        stubSymbols[m_jit->getExecutionSession().intern(function.name)] = m_stubs->findStub(function.name, true);
+    }
+
+    if(stubSymbols.empty() == false){
+        if(llvm::Error error = m_jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(stubSymbols)))){
+            llvm::errs() << "ERROR: Could not define stubs: " << llvm::toString(std::move(error)) << "\n";
+            return false;
+        }
+    }
+
+    for(ChangedFunction& function : changed){
+        m_optimizer->Optimize(*function.generated.module);
+
+        if(AddModule(std::move(function.generated)) == false){
+            return false;
+        }
+    }
+
+    // compiles the new bodies and repoints the stubs. the stub reads its target from a pointer
+    // sized slot, so callers either jump to the old or to the new version
+    for(ChangedFunction& function : changed){
+        StubAddress body;
+
+        if(LookupAddress(function.name + ".v" + std::to_string(function.version.version), body) == false){
+            return false;
+        }
+
+        if(llvm::Error error = m_stubs->updatePointer(function.name, body)){
+            llvm::errs() << "ERROR: Could not update stub for " << function.name << ": " << llvm::toString(std::move(error)) << "\n";
+            return false;
+        }
+
+        m_functions[function.name] = function.version;
+        m_swapped.push_back(function.name);
+    }
+
+    return true;
+}
+
+const std::vector<std::string>& HotSwapJit::GetSwappedFunctions(){
+    return m_swapped;
+}
+
+void* HotSwapJit::Lookup(const std::string& name){
+    if(!IsValid()){
+        return nullptr;
+    }
+
+    auto stub = m_stubs->findStub(name, true);
+
+#if LLVM_VERSION_MAJOR >= 17
+    return stub.getAddress().toPtr<void*>();
+#else
+    return reinterpret_cast<void*>(stub.getAddress());
+#endif
+}
+
+int HotSwapJit::RunMain(){
+    auto mainFunction = reinterpret_cast<int (*)()>(Lookup("main"));
+
+    if(mainFunction == nullptr){
+        llvm::errs() << "ERROR: Could not find main\n";
+        return -1;
+    }
+
+    return mainFunction();
+}
@@ -0,0 +1,369 @@
+#include "interpreter.hpp"
+#include "generator.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+// registers available to all frames together
+static constexpr size_t STACK_SLOTS = 1 << 20;
+
+Interpreter::Interpreter(BytecodeProgram program, Jit& jit, const Options& options)
+    : m_program(std::move(program)), m_jit(jit), m_threshold(options.tierThreshold), m_printStats(options.tierStats) {
+
+    m_states = std::make_unique<FunctionState[]>(m_program.functions.size());
+    m_stack.resize(STACK_SLOTS);
+
+    // looking a global up only materializes its definition, no function is compiled yet
+    for(const BytecodeGlobal& global : m_program.globals){
+        void* address = m_jit.Lookup(global.name);
+
+        if(address == nullptr){
+            m_globals.clear();
+            return;
+        }
+
+        m_globals.push_back(address);
+    }
+}
+
+Interpreter::~Interpreter(){
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopping = true;
+    }
+    m_queueReady.notify_one();
+
+    if(m_compiler.joinable()){
+        m_compiler.join();
+    }
+}
+
+bool Interpreter::IsValid(){
+    return m_globals.size() == m_program.globals.size();
+}
+
+bool Interpreter::CompileNow(uint16_t function){
+    const std::string& name = m_program.functions[function].name;
+
+    // the tier entry calls the function through a lazy stub, looking the function up as well
+    // compiles its body here instead of on the first call
+    void* entry = m_jit.Lookup(GetTierEntryName(name));
+
+    if(entry == nullptr || m_jit.Lookup(name) == nullptr){
+        return false;
+    }
+
+    m_states[function].native.store(reinterpret_cast<NativeEntry>(entry), std::memory_order_release);
+    return true;
+}
+
+void Interpreter::CompilerLoop(){
+    while(true){
+        uint16_t function = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueReady.wait(lock, [this]{ return m_stopping || !m_queue.empty(); });
+
+            if(m_stopping){
+                return;
+            }
+
+            function = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        // on failure the function just stays in the interpreter
+        CompileNow(function);
+    }
+}
+
+void Interpreter::RequestTierUp(uint16_t function){
+    FunctionState& state = m_states[function];
+
+    if(state.tierUpRequested){
+        return;
+    }
+
+    state.tierUpRequested = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(function);
+    }
+
+    if(!m_compiler.joinable()){
+        m_compiler = std::thread(&Interpreter::CompilerLoop, this);
+    }
+
+    m_queueReady.notify_one();
+}
+
+Slot Interpreter::Call(uint16_t function, Slot* arguments){
+    FunctionState& state = m_states[function];
+    state.calls++;
+
+    NativeEntry native = state.native.load(std::memory_order_acquire);
+
+    if(native == nullptr && m_program.functions[function].supported == false){
+        if(CompileNow(function) == false){
+            std::cerr << "Error: Could not compile " << m_program.functions[function].name << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        state.tierUpRequested = true;
+        native = state.native.load(std::memory_order_acquire);
+    }
+
+    if(native != nullptr){
+        Slot result = {};
+        native(arguments, &result);
+        return result;
+    }
+
+    if(state.calls == m_threshold){
+        RequestTierUp(function);
+    }
+
+    return Execute(function, arguments);
+}
+
+// with GCC and clang every handler jumps straight to the next one through a table of label
+// addresses, which keeps the indirect branches apart for the branch predictor. other compilers
+// fall back to a switch in a loop
+#if defined(__GNUC__)
+#define XD_THREADED_DISPATCH 1
+#define CASE(name) LABEL_##name:
+#define DISPATCH() goto *dispatchTable[size_t(ip->op)]
+#else
+#define CASE(name) case Opcode::name:
+#define DISPATCH() continue
+#endif
+
+#define NEXT() do { ip++; DISPATCH(); } while(0)
+
+#define BINARY(name, field, op) \
+    CASE(name) registers[ip->a].field = registers[ip->b].field op registers[ip->c].field; NEXT();
+
+// generated code traps on overflow, the interpreter stops the same way division by zero does.
+// the operation is done in 64 bits, where 32 bit operands can't overflow
+#define CHECKED(opcode, op) \
+    CASE(opcode) { \
+        int64_t wide = int64_t(registers[ip->b].i32) op int64_t(registers[ip->c].i32); \
+        if(wide < std::numeric_limits<int32_t>::min() || wide > std::numeric_limits<int32_t>::max()){ \
+            std::cerr << "Error: Integer overflow in " << bytecode.name << std::endl; \
+            exit(EXIT_FAILURE); \
+        } \
+        registers[ip->a].i32 = int32_t(wide); \
+        NEXT(); \
+    }
+
+#define COMPARE(name, field, op) \
+    CASE(name) registers[ip->a].u64 = registers[ip->b].field op registers[ip->c].field; NEXT();
+
+Slot Interpreter::Execute(uint16_t function, Slot* arguments){
+    const BytecodeFunction& bytecode = m_program.functions[function];
+    FunctionState& state = m_states[function];
+
+    if(m_stackTop + bytecode.registerCount > m_stack.size()){
+        std::cerr << "Error: Stack overflow in " << bytecode.name << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    Slot* registers = &m_stack[m_stackTop];
+    m_stackTop += bytecode.registerCount;
+
+    std::fill(registers, registers + bytecode.registerCount, Slot{});
+    std::copy(arguments, arguments + bytecode.paramCount, registers);
+
+    const Instruction* code = bytecode.code.data();
+    const Instruction* ip = code;
+    const Slot* constants = bytecode.constants.data();
+    Slot result = {};
+
+#ifdef XD_THREADED_DISPATCH
+    // same order as Opcode
+    static void* const dispatchTable[] = {
+        &&LABEL_LOAD_CONST, &&LABEL_MOVE, &&LABEL_LOAD_GLOBAL_32, &&LABEL_STORE_GLOBAL_32,
+        &&LABEL_ADD_I32, &&LABEL_SUB_I32, &&LABEL_MUL_I32, &&LABEL_DIV_I32, &&LABEL_DIV_U32,
+        &&LABEL_ADD_I32_CHECKED, &&LABEL_SUB_I32_CHECKED, &&LABEL_MUL_I32_CHECKED,
+        &&LABEL_ADD_F32, &&LABEL_SUB_F32, &&LABEL_MUL_F32, &&LABEL_DIV_F32,
+        &&LABEL_EQ_I32, &&LABEL_NE_I32, &&LABEL_LT_I32, &&LABEL_GT_I32, &&LABEL_LE_I32, &&LABEL_GE_I32,
+        &&LABEL_LT_U32, &&LABEL_GT_U32, &&LABEL_LE_U32, &&LABEL_GE_U32,
+        &&LABEL_EQ_F32, &&LABEL_NE_F32, &&LABEL_LT_F32, &&LABEL_GT_F32, &&LABEL_LE_F32, &&LABEL_GE_F32,
+        &&LABEL_I32_TO_F32, &&LABEL_U32_TO_F32, &&LABEL_F32_TO_I32, &&LABEL_F32_TO_U32,
+        &&LABEL_JUMP, &&LABEL_JUMP_IF_FALSE, &&LABEL_CALL, &&LABEL_RETURN, &&LABEL_RETURN_VOID,
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == size_t(Opcode::COUNT));
+
+    DISPATCH();
+#else
+    for(;;){
+    switch(ip->op){
+#endif
+
+    CASE(LOAD_CONST)
+        registers[ip->a] = constants[ip->bc()];
+        NEXT();
+
+    CASE(MOVE)
+        registers[ip->a] = registers[ip->b];
+        NEXT();
+
+    CASE(LOAD_GLOBAL_32)
+        registers[ip->a].u64 = *static_cast<uint32_t*>(m_globals[ip->b]);
+        NEXT();
+
+    CASE(STORE_GLOBAL_32)
+        *static_cast<uint32_t*>(m_globals[ip->b]) = registers[ip->a].u32;
+        NEXT();
+
+    // signed overflow is undefined in generated code, wrapping is one of the allowed outcomes
+    CASE(ADD_I32) registers[ip->a].u32 = registers[ip->b].u32 + registers[ip->c].u32; NEXT();
+    CASE(SUB_I32) registers[ip->a].u32 = registers[ip->b].u32 - registers[ip->c].u32; NEXT();
+    CASE(MUL_I32) registers[ip->a].u32 = registers[ip->b].u32 * registers[ip->c].u32; NEXT();
+
+    CASE(DIV_I32)
+        if(registers[ip->c].i32 == 0){
+            std::cerr << "Error: Division by zero in " << bytecode.name << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        registers[ip->a].i32 = registers[ip->b].i32 / registers[ip->c].i32;
+        NEXT();
+
+    CASE(DIV_U32)
+        if(registers[ip->c].u32 == 0){
+            std::cerr << "Error: Division by zero in " << bytecode.name << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        registers[ip->a].u32 = registers[ip->b].u32 / registers[ip->c].u32;
+        NEXT();
+
+    CHECKED(ADD_I32_CHECKED, +)
+    CHECKED(SUB_I32_CHECKED, -)
+    CHECKED(MUL_I32_CHECKED, *)
+
+    BINARY(ADD_F32, f32, +)
+    BINARY(SUB_F32, f32, -)
+    BINARY(MUL_F32, f32, *)
+    BINARY(DIV_F32, f32, /)
+
+    COMPARE(EQ_I32, i32, ==)
+    COMPARE(NE_I32, i32, !=)
+    COMPARE(LT_I32, i32, <)
+    COMPARE(GT_I32, i32, >)
+    COMPARE(LE_I32, i32, <=)
+    COMPARE(GE_I32, i32, >=)
+    COMPARE(LT_U32, u32, <)
+    COMPARE(GT_U32, u32, >)
+    COMPARE(LE_U32, u32, <=)
+    COMPARE(GE_U32, u32, >=)
+    COMPARE(EQ_F32, f32, ==)
+    COMPARE(LT_F32, f32, <)
+    COMPARE(GT_F32, f32, >)
+    COMPARE(LE_F32, f32, <=)
+    COMPARE(GE_F32, f32, >=)
+
+    // ordered like the generated fcmp one, false when either side is NaN
+    CASE(NE_F32)
+        registers[ip->a].u64 = registers[ip->b].f32 < registers[ip->c].f32 || registers[ip->b].f32 > registers[ip->c].f32;
+        NEXT();
+
+    CASE(I32_TO_F32)
+        registers[ip->a].f32 = float(registers[ip->b].i32);
+        NEXT();
+
+    CASE(U32_TO_F32)
+        registers[ip->a].f32 = float(registers[ip->b].u32);
+        NEXT();
+
+    // out of range values are undefined, like fptosi and fptoui in the generated code
+    CASE(F32_TO_I32)
+        registers[ip->a].i32 = int32_t(registers[ip->b].f32);
+        NEXT();
+
+    CASE(F32_TO_U32)
+        registers[ip->a].u32 = uint32_t(registers[ip->b].f32);
+        NEXT();
+
+    CASE(JUMP)
+    {
+        const Instruction* target = code + ip->bc();
+
+        // loops are hot as well, the running frame stays here but the next call is compiled
+        if(target <= ip && ++state.backEdges >= m_threshold){
+            RequestTierUp(function);
+        }
+
+        ip = target;
+        DISPATCH();
+    }
+
+    CASE(JUMP_IF_FALSE)
+        if(registers[ip->a].u32 == 0){
+            ip = code + ip->bc();
+            DISPATCH();
+        }
+        NEXT();
+
+    CASE(CALL)
+        registers[ip->a] = Call(ip->b, &registers[ip->c]);
+        NEXT();
+
+    CASE(RETURN)
+        result = registers[ip->a];
+        goto done;
+
+    CASE(RETURN_VOID)
+        goto done;
+
+#ifndef XD_THREADED_DISPATCH
+    default:
+        goto done;
+    }
+    }
+#endif
+
+done:
+    m_stackTop -= bytecode.registerCount;
+    return result;
+}
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef BINARY
+#undef CHECKED
+#undef COMPARE
+
+void Interpreter::PrintStats(){
+    for(size_t i = 0; i < m_program.functions.size(); i++){
+        const BytecodeFunction& function = m_program.functions[i];
+        const FunctionState& state = m_states[i];
+
+        std::cerr << function.name << ": " << state.calls << " calls, " << state.backEdges << " back edges, "
+                  << (state.native.load() != nullptr ? "jit" : "interpreter");
+
+        if(function.supported == false){
+            std::cerr << " (" << function.unsupportedReason << ")";
+        }
+
+        std::cerr << "\n";
+    }
+}
+
+int Interpreter::RunMain(){
+    if(m_program.functionIndices.find("main") == m_program.functionIndices.end()){
+        std::cerr << "Error: Could not find main" << std::endl;
+        return -1;
+    }
+
+    Slot result = Call(m_program.functionIndices.at("main"), nullptr);
+
+    if(m_printStats){
+        PrintStats();
+    }
+
+    return result.i32;
+}
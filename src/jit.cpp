@@ -0,0 +1,148 @@
+#include "jit.hpp"
+#include "emitter.hpp"
+#include "profiling.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+Jit::Jit(const Options& options){
+    InitializeTargets();
+
+    auto targetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+    if(!targetMachineBuilder){
+        llvm::errs() << "ERROR: Could not detect the host for the JIT: " << llvm::toString(targetMachineBuilder.takeError()) << "\n";
+        return;
+    }
+
+    targetMachineBuilder->setCodeGenOptLevel(GetCodeGenOptLevel(options.optLevel));
+
+    // the vectorizers and the inliner need the costs of the host that the JIT compiles for
+    auto targetMachine = targetMachineBuilder->createTargetMachine();
+
+    if(!targetMachine){
+        llvm::errs() << "ERROR: Could not create the target machine for the JIT: " << llvm::toString(targetMachine.takeError()) << "\n";
+        return;
+    }
+
+    m_targetMachine = std::move(*targetMachine);
+
+    llvm::orc::LLLazyJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(*targetMachineBuilder));
+
+    if(options.perf){
+        builder.setObjectLinkingLayerCreator([](llvm::orc::ExecutionSession& session, auto&&...) -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+            return CreateProfiledObjectLayer(session);
+        });
+    }
+
+    auto jit = builder.create();
+
+    if(!jit){
+        llvm::errs() << "ERROR: Could not create the JIT: " << llvm::toString(jit.takeError()) << "\n";
+        return;
+    }
+
+    m_jit = std::move(*jit);
+
+    // lets XD code call into the C library and the rest of the process
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(m_jit->getDataLayout().getGlobalPrefix());
+
+    if(!processSymbols){
+        llvm::errs() << "ERROR: Could not load process symbols: " << llvm::toString(processSymbols.takeError()) << "\n";
+        m_jit.reset();
+        return;
+    }
+
+    m_jit->getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+    // the optimizer runs on each partition right before it is compiled
+    m_optimizer = std::make_unique<Optimizer>(options.optLevel, m_targetMachine.get());
+
+    m_jit->getIRTransformLayer().setTransform([this](llvm::orc::ThreadSafeModule module, llvm::orc::MaterializationResponsibility&) -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+        std::lock_guard<std::mutex> lock(m_optimizerMutex);
+
+        module.withModuleDo([this](llvm::Module& partition){
+            m_optimizer->Optimize(partition);
+        });
+
+        return module;
+    });
+}
+
+bool Jit::IsValid(){
+    return m_jit != nullptr;
+}
+
+// structs are passed field by field, so a struct with a vector field passes a vector too
+static bool ContainsVector(llvm::Type* type){
+    if(auto* structType = llvm::dyn_cast<llvm::StructType>(type)){
+        return std::any_of(structType->element_begin(), structType->element_end(), ContainsVector);
+    }
+
+    if(auto* arrayType = llvm::dyn_cast<llvm::ArrayType>(type)){
+        return ContainsVector(arrayType->getElementType());
+    }
+
+    return type->isVectorTy();
+}
+
+bool Jit::AddModule(GeneratedModule generated){
+    if(m_jit == nullptr){
+        return false;
+    }
+
+    generated.module->setDataLayout(m_jit->getDataLayout());
+
+    // the resolver behind lazy call-through stubs only saves the xmm registers, so the upper
+    // lanes of ymm and zmm arguments would not survive the first call of a function. modules
+    // that pass vectors around are compiled eagerly and call each other directly instead
+    bool passesVectors = std::any_of(generated.module->begin(), generated.module->end(), [](const llvm::Function& function){
+        llvm::FunctionType* type = function.getFunctionType();
+        return ContainsVector(type->getReturnType()) || std::any_of(type->param_begin(), type->param_end(), ContainsVector);
+    });
+
+    llvm::orc::ThreadSafeModule module(std::move(generated.module), std::move(generated.context));
+
+    llvm::Error error = passesVectors ? m_jit->addIRModule(std::move(module)) : m_jit->addLazyIRModule(std::move(module));
+
+    if(error){
+        llvm::errs() << "ERROR: Could not add module to the JIT: " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+void* Jit::Lookup(const std::string& name){
+    if(m_jit == nullptr){
+        return nullptr;
+    }
+
+    auto symbol = m_jit->lookup(name);
+
+    if(!symbol){
+        llvm::errs() << "ERROR: Could not find " << name << ": " << llvm::toString(symbol.takeError()) << "\n";
+        return nullptr;
+    }
+
+#if LLVM_VERSION_MAJOR >= 15
+    return symbol->toPtr<void*>();
+#else
+    return reinterpret_cast<void*>(symbol->getAddress());
+#endif
+}
+
+int Jit::RunMain(){
+    auto mainFunction = reinterpret_cast<int (*)()>(Lookup("main"));
+
+    if(mainFunction == nullptr){
+        return -1;
+    }
+
+    return mainFunction();
+}
@@ -1,4 +1,65 @@
 #include "lexer.hpp"
+#include "diagnostics.hpp"
+
+bool IsNumericType(TokenType type){
+    return GetTypeBits(type) != 0;
+}
+
+bool IsFloatType(TokenType type){
+    return type == TokenType::FLOAT || type == TokenType::F64;
+}
+
+bool IsUnsignedType(TokenType type){
+    return type == TokenType::U8 || type == TokenType::U16 || type == TokenType::UINT || type == TokenType::U64;
+}
+
+unsigned GetTypeBits(TokenType type){
+    switch(type){
+        case TokenType::I8:
+        case TokenType::U8:
+            return 8;
+        case TokenType::I16:
+        case TokenType::U16:
+            return 16;
+        case TokenType::INT:
+        case TokenType::UINT:
+        case TokenType::FLOAT:
+            return 32;
+        case TokenType::I64:
+        case TokenType::U64:
+        case TokenType::F64:
+            return 64;
+        default:
+            return 0;
+    }
+}
+
+std::string GetTypeName(TokenType type){
+    switch(type){
+        case TokenType::INT: return "int";
+        case TokenType::UINT: return "uint";
+        case TokenType::FLOAT: return "float";
+        case TokenType::I8: return "i8";
+        case TokenType::I16: return "i16";
+        case TokenType::I64: return "i64";
+        case TokenType::U8: return "u8";
+        case TokenType::U16: return "u16";
+        case TokenType::U64: return "u64";
+        case TokenType::F64: return "f64";
+        default: return "void";
+    }
+}
+
+std::optional<TokenType> GetSuffixType(const std::string& suffix){
+    static const std::unordered_map<std::string, TokenType> suffixes = {
+        {"i8", TokenType::I8}, {"i16", TokenType::I16}, {"i32", TokenType::INT}, {"i64", TokenType::I64},
+        {"u8", TokenType::U8}, {"u16", TokenType::U16}, {"u32", TokenType::UINT}, {"u64", TokenType::U64},
+        {"f32", TokenType::FLOAT}, {"f64", TokenType::F64},
+    };
+
+    auto type = suffixes.find(suffix);
+    return type == suffixes.end() ? std::nullopt : std::optional<TokenType>(type->second);
+}
 
 Lexer::Lexer(const std::string& code) : m_code(code) {}
 
@@ -11,7 +72,20 @@ Lexer::Lexer(const std::string& code) : m_code(code) {}
 }
 
 char Lexer::eat(){
-    return m_code.at(m_index++);
+    char c = m_code.at(m_index++);
+
+    if(c == '\n'){
+        m_line++;
+        m_column = 1;
+    } else {
+        m_column++;
+    }
+
+    return c;
+}
+
+Token Lexer::MakeToken(TokenType type, std::optional<std::string> value){
+    return {type, std::move(value), m_tokenLine, m_tokenColumn};
 }
 
 std::vector<Token> Lexer::lex(){
@@ -20,6 +94,8 @@ std::vector<Token> Lexer::lex(){
 
     // main loop to cover all characters within the file
     while(peek().has_value()){
+        m_tokenLine = m_line;
+        m_tokenColumn = m_column;
 
         // processes keywords and identifiers
         if(std::isalpha(peek().value())){
@@ -30,18 +106,19 @@ std::vector<Token> Lexer::lex(){
             }
 
             if(m_TokenMap.contains(buffer) == true){
-                tokens.push_back({m_TokenMap.at(buffer), std::nullopt});
+                tokens.push_back(MakeToken(m_TokenMap.at(buffer), std::nullopt));
                 buffer.clear();
                 continue;
             }
 
             // otherwise treat as identifier
-            tokens.push_back({TokenType::IDENT, buffer});
+            tokens.push_back(MakeToken(TokenType::IDENT, buffer));
             buffer.clear();
         }
 
         // processes numerical values
         else if(isdigit(peek().value())){
+            TokenType type = TokenType::INT_LIT;
             buffer.push_back(eat());
 
             while(isdigit(peek().value())){
@@ -56,13 +133,17 @@ std::vector<Token> Lexer::lex(){
                     buffer.push_back(eat());
                 }
 
-                tokens.push_back({TokenType::FLOAT_LIT, buffer});
-                buffer.clear();
-            } else {
-                tokens.push_back({TokenType::INT_LIT, buffer});
-                buffer.clear();
+                type = TokenType::FLOAT_LIT;
             }
 
+            // type suffix like 255u8 or 1.5f64, the parser splits it off
+            while(peek().has_value() && std::isalnum(peek().value())){
+                buffer.push_back(eat());
+            }
+
+            tokens.push_back(MakeToken(type, buffer));
+            buffer.clear();
+
             continue;
         }
 
@@ -77,7 +158,7 @@ std::vector<Token> Lexer::lex(){
             eat(); // eats final quote
           }
           
-          tokens.push_back({TokenType::STRING_LIT, buffer});
+          tokens.push_back(MakeToken(TokenType::STRING_LIT, buffer));
 
           buffer.clear();
 
@@ -139,6 +220,19 @@ std::vector<Token> Lexer::lex(){
                     }
                     break;
 
+                case '!':
+                    if(peek(1).has_value() && peek(1).value() == '='){
+                        type = TokenType::NOT_EQUAL;
+                        eat();
+                    }else{
+                        GetErrorStream() << "Lexer Error: Expected '=' after '!'" << std::endl;
+                    }
+                    break;
+
+                case '@':
+                    type = TokenType::AT;
+                    break;
+
                 case '>':
                     if(peek(1).value() == '='){
                         type = TokenType::GREATER_OR_EQUAL;
@@ -172,17 +266,37 @@ std::vector<Token> Lexer::lex(){
                 case '}':
                     type = TokenType::CLOSE_BRACKET;
                     break;
+
+                case '[':
+                    type = TokenType::OPEN_SQUARE;
+                    break;
+
+                case ']':
+                    type = TokenType::CLOSE_SQUARE;
+                    break;
+
+                case '.':
+                    type = TokenType::DOT;
+                    break;
+
+                case '&':
+                    type = TokenType::AMPERSAND;
+                    break;
                 
                 case ';':
                     type = TokenType::SEMI;
                     break;
 
+                case ',':
+                    type = TokenType::COMMA;
+                    break;
+
                 default:
-                    std::cerr<< "Lexer Error: Unknown character detected " << peek().value() << std::endl;
+                    GetErrorStream() << "Lexer Error: Unknown character detected " << peek().value() << std::endl;
                     break;
             }
 
-            tokens.push_back({type, std::nullopt});
+            tokens.push_back(MakeToken(type, std::nullopt));
             eat();
             buffer.clear();
             continue;
@@ -190,7 +304,7 @@ std::vector<Token> Lexer::lex(){
        
 
         else {
-            std::cerr << "Unknown character: '" << peek().value() << std::endl;
+            GetErrorStream() << "Unknown character: '" << peek().value() << std::endl;
             eat(); 
         }
     }
@@ -1,9 +1,17 @@
 #include "lexer.hpp"
 #include "parser.hpp"
-#include "analysis.hpp"
-#include "generator.hpp"
+#include "compiler.hpp"
+#include "jit.hpp"
+#include "bytecode.hpp"
+#include "interpreter.hpp"
+#include "hotswap.hpp"
+#include "server.hpp"
+#include "options.hpp"
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 void print_tokens(const std::vector<Token> & tokens){
     for(auto token : tokens){
@@ -95,35 +103,97 @@ void print_tokens(const std::vector<Token> & tokens){
     }
 }
 
-int main(int argc, char * argv[]){
+// runs main, then again every time the source file changes. functions that didn't change keep
+// their compiled code, changed ones are swapped in behind their stubs
+static int RunWatch(const Options& options){
+    HotSwapJit jit(options);
+
+    if(jit.IsValid() == false){
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::file_time_type lastWrite;
 
-    std::stringstream buffer;
+    while(true){
+        std::error_code error;
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(options.inputPath, error);
 
-    if(argc >= 2){
-        
-        std::ifstream t(argv[1]);
-        buffer << t.rdbuf();
+        if(!error && writeTime != lastWrite){
+            lastWrite = writeTime;
+
+            std::ifstream file(options.inputPath);
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+
+            if(jit.Load(buffer.str())){
+                std::cerr << "compiled:";
+                for(const std::string& name : jit.GetSwappedFunctions()){
+                    std::cerr << " " << name;
+                }
+                std::cerr << std::endl;
+
+                std::cerr << "main returned " << jit.RunMain() << std::endl;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
     }
-    else if(argc < 2){
-        std::cerr << "Error: No source file provided" << std::endl;
+}
+
+int main(int argc, char * argv[]){
+
+    Options options;
+
+    if(ParseOptions(argc, argv, options) == false){
+        PrintUsage();
         exit(EXIT_FAILURE);
     }
 
-    Lexer lex(buffer.str());
-    std::vector<Token> tokens = lex.lex();
+    if(options.serve){
+        CompileServer server(options);
+        return server.Run();
+    }
 
-    Parser parser(tokens);
-    auto prog = parser.Parse();
+    if(options.client){
+        return RunClient(options, argc, argv);
+    }
+
+    if(options.watch){
+        return RunWatch(options);
+    }
 
-    Analyzer analyzer;
-    bool analyzed = analyzer.Analyze(prog);
+    CompilerInstance compiler(options);
 
-    if(analyzed == false){
+    if(compiler.CompileFile() == false){
       exit(EXIT_FAILURE);
     }
 
-    Generator generator;
-    generator.Generate(prog);
+    if(options.mode == Mode::Run){
+        Jit jit(options);
+
+        for(auto& generated : compiler.TakeModules()){
+            if(jit.AddModule(std::move(generated)) == false){
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if(options.tiered){
+            BytecodeCompiler bytecodeCompiler(options.checkedArithmetic);
+            Interpreter interpreter(bytecodeCompiler.Compile(compiler.GetProgram()), jit, options);
+
+            if(interpreter.IsValid() == false){
+                exit(EXIT_FAILURE);
+            }
+
+            return interpreter.RunMain();
+        }
+
+        return jit.RunMain();
+    }
+
+    if(compiler.Emit() == false){
+        exit(EXIT_FAILURE);
+    }
 
     return 0;
 }
@@ -0,0 +1,67 @@
+#include "optimizer.hpp"
+#include "diagnostics.hpp"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+
+static llvm::PipelineTuningOptions GetTuningOptions(OptLevel level){
+    llvm::PipelineTuningOptions tuning;
+
+    // same defaults as clang, vectorizers only run at -O2 and above
+    bool vectorize = level == OptLevel::O2 || level == OptLevel::O3 || level == OptLevel::Os;
+    tuning.LoopInterleaving = vectorize;
+    tuning.LoopVectorization = vectorize;
+    tuning.SLPVectorization = vectorize;
+    tuning.LoopUnrolling = level != OptLevel::O0;
+
+    return tuning;
+}
+
+Optimizer::Optimizer(OptLevel level, llvm::TargetMachine* targetMachine) : m_level(level), m_passBuilder(targetMachine, GetTuningOptions(level)) {
+    // -O0 skips building the pipeline entirely
+    if(m_level == OptLevel::O0){
+        return;
+    }
+
+    m_passBuilder.registerModuleAnalyses(m_moduleAnalysis);
+    m_passBuilder.registerCGSCCAnalyses(m_cgsccAnalysis);
+    m_passBuilder.registerFunctionAnalyses(m_functionAnalysis);
+    m_passBuilder.registerLoopAnalyses(m_loopAnalysis);
+    m_passBuilder.crossRegisterProxies(m_loopAnalysis, m_functionAnalysis, m_cgsccAnalysis, m_moduleAnalysis);
+
+    switch(m_level){
+        case OptLevel::O1:
+            m_passes = m_passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O1);
+            break;
+        case OptLevel::O2:
+            m_passes = m_passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+            break;
+        case OptLevel::O3:
+            m_passes = m_passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
+            break;
+        case OptLevel::Os:
+            m_passes = m_passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::Os);
+            break;
+        default:
+            break;
+    }
+}
+
+void Optimizer::Optimize(llvm::Module& module){
+    if(m_level == OptLevel::O0){
+        return;
+    }
+
+    // the passes assume well formed IR
+    if(llvm::verifyModule(module, &GetLLVMErrorStream())){
+        GetLLVMErrorStream() << "ERROR: Generated module is broken, skipping optimizations\n";
+        return;
+    }
+
+    m_passes.run(module, m_moduleAnalysis);
+
+    // cached analysis results refer to this module, drop them so the optimizer can be reused
+    m_loopAnalysis.clear();
+    m_functionAnalysis.clear();
+    m_cgsccAnalysis.clear();
+    m_moduleAnalysis.clear();
+}
@@ -0,0 +1,236 @@
+#include "options.hpp"
+#include "diagnostics.hpp"
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+void PrintUsage(){
+    std::cerr << "usage: xd [options] <source file>\n"
+              << "       xd --run [options] <source file>\n"
+              << "       xd --serve [--socket=<path>]\n"
+              << "options:\n"
+              << "  -O0 -O1 -O2 -O3 -Os   optimization level (default -O0)\n"
+              << "  --run                 JIT compile the program and run main, functions are compiled on their first call\n"
+              << "  --tiered              with --run, interpret functions until they are hot, then compile them in the background\n"
+              << "  --tier-threshold=<n>  calls or loop iterations before a function is compiled (default 1000)\n"
+              << "  --tier-stats          print the calls and tier of every function on exit\n"
+              << "  --watch               with --run, run main again whenever the source changes, only changed functions are recompiled\n"
+              << "  --perf                with --run, write /tmp/perf-<pid>.map and a jitdump for perf\n"
+              << "  -g                    emit line tables for profilers and debuggers\n"
+              << "  -ffast-math           let LLVM reassociate, contract and approximate float operations in every function\n"
+              << "  --checked-arith       trap on signed integer overflow instead of optimizing under the assumption it never happens\n"
+              << "  --cache-dir=<dir>     with -c, cache the object of every function and only recompile changed ones\n"
+              << "  --cache-size=<n>      evict the least recently used cache entries above n MiB (default 512)\n"
+              << "  --cache-stats         print cache hits, misses and evictions\n"
+              << "  --serve               run a compile server that keeps target machines and pipelines warm\n"
+              << "  --client              compile through a running --serve process, '-' reads the source from stdin\n"
+              << "  --socket=<path>       socket of the compile server (default $XDG_RUNTIME_DIR/xd.sock)\n"
+              << "  -c                    emit a native object file\n"
+              << "  -S                    emit native assembly\n"
+              << "  --emit-llvm-bc        emit LLVM bitcode\n"
+              << "  -o <file>             output file\n"
+              << "  -mcpu=<cpu>           target cpu, 'native' for the host cpu (default generic)\n"
+              << "  -j <n>                code generation threads (default 1)\n"
+              << "  --codegen-units=<n>   split code generation into n modules, one output each (default 1)\n";
+}
+
+// a number from 1 to the largest unsigned, larger numbers are rejected instead of wrapping
+static bool ParseCount(const std::string& text, unsigned& count){
+    uint64_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+
+    if(text.empty() || error != std::errc() || end != text.data() + text.size() || value == 0 || value > std::numeric_limits<unsigned>::max()){
+        return false;
+    }
+
+    count = value;
+    return true;
+}
+
+bool ParseOptions(int argc, char * argv[], Options& options){
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+
+        if(arg == "-O0"){
+            options.optLevel = OptLevel::O0;
+        }
+        else if(arg == "-O1"){
+            options.optLevel = OptLevel::O1;
+        }
+        else if(arg == "-O2"){
+            options.optLevel = OptLevel::O2;
+        }
+        else if(arg == "-O3"){
+            options.optLevel = OptLevel::O3;
+        }
+        else if(arg == "-Os"){
+            options.optLevel = OptLevel::Os;
+        }
+        else if(arg == "--run"){
+            options.mode = Mode::Run;
+        }
+        else if(arg == "--tiered"){
+            options.mode = Mode::Run;
+            options.tiered = true;
+        }
+        else if(arg.starts_with("--tier-threshold=")){
+            if(ParseCount(arg.substr(17), options.tierThreshold) == false){
+                GetErrorStream() << "Error: --tier-threshold expects a number from 1 to " << std::numeric_limits<unsigned>::max() << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--tier-stats"){
+            options.tierStats = true;
+        }
+        else if(arg == "--watch"){
+            options.mode = Mode::Run;
+            options.watch = true;
+        }
+        else if(arg == "--perf"){
+            options.perf = true;
+        }
+        else if(arg == "-g"){
+            options.debugInfo = true;
+        }
+        else if(arg == "--checked-arith"){
+            options.checkedArithmetic = true;
+        }
+        else if(arg == "-ffast-math"){
+            options.fastMath = true;
+        }
+        else if(arg.starts_with("--cache-dir=")){
+            options.cacheDir = arg.substr(12);
+        }
+        else if(arg.starts_with("--cache-size=")){
+            if(ParseCount(arg.substr(13), options.cacheSizeMiB) == false){
+                GetErrorStream() << "Error: --cache-size expects a number from 1 to " << std::numeric_limits<unsigned>::max() << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--cache-stats"){
+            options.cacheStats = true;
+        }
+        else if(arg == "--serve"){
+            options.serve = true;
+        }
+        else if(arg == "--client"){
+            options.client = true;
+        }
+        else if(arg.starts_with("--socket=")){
+            options.socketPath = arg.substr(9);
+        }
+        else if(arg == "-c"){
+            options.outputType = OutputType::Object;
+        }
+        else if(arg == "-S"){
+            options.outputType = OutputType::Assembly;
+        }
+        else if(arg == "--emit-llvm-bc"){
+            options.outputType = OutputType::Bitcode;
+        }
+        else if(arg == "-o"){
+            if(i + 1 >= argc){
+                GetErrorStream() << "Error: -o expects a file name" << std::endl;
+                return false;
+            }
+            options.outputPath = argv[++i];
+        }
+        else if(arg == "-j" || (arg.starts_with("-j") && arg.size() > 2)){
+            std::string count = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+
+            if(ParseCount(count, options.threads) == false){
+                GetErrorStream() << "Error: -j expects a number from 1 to " << std::numeric_limits<unsigned>::max() << std::endl;
+                return false;
+            }
+        }
+        else if(arg.starts_with("--codegen-units=")){
+            if(ParseCount(arg.substr(16), options.codegenUnits) == false){
+                GetErrorStream() << "Error: --codegen-units expects a number from 1 to " << std::numeric_limits<unsigned>::max() << std::endl;
+                return false;
+            }
+        }
+        else if(arg.starts_with("-mcpu=")){
+            options.cpu = arg.substr(6);
+        }
+        else if(arg.size() > 1 && arg[0] == '-'){
+            GetErrorStream() << "Error: Unknown option " << arg << std::endl;
+            return false;
+        }
+        else{
+            options.inputPath = arg;
+        }
+    }
+
+    if(options.serve){
+        if(options.client || options.inputPath.empty() == false){
+            GetErrorStream() << "Error: --serve doesn't take a source file, compile through --client" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    if(options.inputPath.empty()){
+        GetErrorStream() << "Error: No source file provided" << std::endl;
+        return false;
+    }
+
+    if(options.client && options.mode == Mode::Run){
+        GetErrorStream() << "Error: --client only compiles, programs can't be run by the compile server" << std::endl;
+        return false;
+    }
+
+    if(options.cacheDir.empty() == false && UsesObjectCache(options) == false){
+        GetErrorStream() << "Warning: --cache-dir only caches object files (-c), it is ignored" << std::endl;
+    }
+
+    return true;
+}
+
+std::string GetOutputPath(const Options& options){
+    if(options.outputPath.empty() == false){
+        return options.outputPath;
+    }
+
+    std::string extension;
+
+    switch(options.outputType){
+        case OutputType::Object:
+            // the cached objects of every function are bundled into an archive
+            extension = UsesObjectCache(options) ? ".a" : ".o";
+            break;
+        case OutputType::Assembly:
+            extension = ".s";
+            break;
+        case OutputType::Bitcode:
+            extension = ".bc";
+            break;
+        default:
+            return "";
+    }
+
+    std::string stem = options.inputPath;
+    size_t dot = stem.find_last_of('.');
+    size_t slash = stem.find_last_of('/');
+
+    if(dot != std::string::npos && (slash == std::string::npos || dot > slash)){
+        stem = stem.substr(0, dot);
+    }
+
+    return stem + extension;
+}
+
+std::string GetUnitOutputPath(const std::string& path, unsigned index){
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash)){
+        return path + "." + std::to_string(index);
+    }
+
+    return path.substr(0, dot) + "." + std::to_string(index) + path.substr(dot);
+}
+
+bool UsesObjectCache(const Options& options){
+    return options.cacheDir.empty() == false && options.outputType == OutputType::Object && options.mode == Mode::Compile;
+}
@@ -1,4 +1,7 @@
 #include "parser.hpp"
+#include "diagnostics.hpp"
+#include <algorithm>
+#include <set>
 
 std::optional<Token> Parser::peek(int offset = 0){
     if(offset + m_index >= m_tokens.size()){
@@ -18,28 +21,239 @@ void Parser::TryEat(TokenType token){
     } else{
         switch(token){
             case TokenType::OPEN_PAREN:
-                std::cerr << "Error, expected '('" << std::endl;
+                GetErrorStream() << "Error, expected '('" << std::endl;
                 break;
             case TokenType::CLOSE_PAREN:
-                std::cerr << "Error, expected ')'" << std::endl;
+                GetErrorStream() << "Error, expected ')'" << std::endl;
                 break;
             case TokenType::OPEN_BRACKET:
-                std::cerr << "Error, expected '{'" << std::endl;
+                GetErrorStream() << "Error, expected '{'" << std::endl;
                 break;
             case TokenType::CLOSE_BRACKET:
-                std::cerr << "Error, expected '}'" << std::endl;
+                GetErrorStream() << "Error, expected '}'" << std::endl;
                 break;
             case TokenType::SEMI:
-                std::cerr << "Error, expected ';'" << std::endl;
+                GetErrorStream() << "Error, expected ';'" << std::endl;
                 break;
             case TokenType::EQUAL:
-                std::cerr << "Error, exptected '='" << std::endl;
+                GetErrorStream() << "Error, exptected '='" << std::endl;
+                break;
+            case TokenType::LESS_THAN:
+                GetErrorStream() << "Error, expected '<'" << std::endl;
+                break;
+            case TokenType::GREATER_THAN:
+                GetErrorStream() << "Error, expected '>'" << std::endl;
+                break;
+            case TokenType::CLOSE_SQUARE:
+                GetErrorStream() << "Error, expected ']'" << std::endl;
                 break;
         }
-        exit(EXIT_FAILURE);
+        AbortCompilation();
+    }
+}
+
+bool IsBuiltinFunction(const std::string& name){
+    static const std::set<std::string> builtins = {
+        "shuffle", "select", "extract", "insert", "reduce_add", "reduce_mul", "reduce_min", "reduce_max", "len",
+        "load", "store", "fetch_add", "fetch_sub", "cas"
+    };
+
+    return builtins.contains(name);
+}
+
+// builtin types, structs and the type parameters of the function being parsed
+bool Parser::IsTypeToken(const Token& token){
+    if(IsNumericType(token.type) || token.type == TokenType::VEC || token.type == TokenType::ATOMIC){
+        return true;
+    }
+
+    switch(token.type){
+        case TokenType::IDENT:
+            return m_userTypes.contains(token.value.value()) || std::find(m_typeParams.begin(), m_typeParams.end(), token.value.value()) != m_typeParams.end();
+        default:
+            return false;
     }
 }
 
+// parses '<' TYPE (',' TYPE)* '>'
+std::vector<Token> Parser::ParseTypeList(){
+    std::vector<Token> types;
+
+    TryEat(TokenType::LESS_THAN);
+
+    while(peek().has_value() && peek().value().type != TokenType::GREATER_THAN){
+        types.push_back(eat());
+
+        if(peek().has_value() && peek().value().type == TokenType::COMMA){
+            eat();
+        }
+    }
+
+    TryEat(TokenType::GREATER_THAN);
+
+    return types;
+}
+
+Token Parser::ParseType(){
+    if(!peek().has_value() || IsTypeToken(peek().value()) == false){
+        GetErrorStream() << "Error, expected a type" << std::endl;
+        AbortCompilation();
+    }
+
+    Token type = peek().value().type == TokenType::VEC ? ParseVectorType() : peek().value().type == TokenType::ATOMIC ? ParseAtomicType() : eat();
+
+    if(peek().has_value() && peek().value().type == TokenType::MUL){
+        eat(); // eats *
+        type.isPointer = true;
+
+        if(peek().has_value() && peek().value().type == TokenType::RESTRICT){
+            eat();
+            type.isRestrict = true;
+        }
+
+        if(peek().has_value() && (peek().value().type == TokenType::MUL || peek().value().type == TokenType::OPEN_SQUARE)){
+            GetErrorStream() << "Error, pointers can't point to pointers and there are no arrays or slices of pointers" << std::endl;
+            AbortCompilation();
+        }
+
+        return type;
+    }
+
+    if(!peek().has_value() || peek().value().type != TokenType::OPEN_SQUARE){
+        return type;
+    }
+
+    eat(); // eats [
+
+    if(peek().has_value() && peek().value().type == TokenType::CLOSE_SQUARE){
+        type.isSlice = true;
+    }
+    else if(peek().has_value() && peek().value().type == TokenType::INT_LIT){
+        // lengths and indices are ints, so an array can't have more elements than an int can count
+        std::string length = eat().value.value();
+
+        if(length.size() > 10 || length.find_first_not_of("0123456789") != std::string::npos || std::stoull(length) == 0 || std::stoull(length) > 2147483647){
+            GetErrorStream() << "Error, an array has between 1 and 2147483647 elements" << std::endl;
+            AbortCompilation();
+        }
+
+        type.arrayLength = std::stoul(length);
+    }
+    else{
+        GetErrorStream() << "Error, expected the length of the array or ']' for a slice" << std::endl;
+        AbortCompilation();
+    }
+
+    TryEat(TokenType::CLOSE_SQUARE);
+
+    if(peek().has_value() && peek().value().type == TokenType::MUL){
+        GetErrorStream() << "Error, a pointer can't point to an array or slice, point to its first element instead" << std::endl;
+        AbortCompilation();
+    }
+
+    if(peek().has_value() && peek().value().type == TokenType::OPEN_SQUARE){
+        GetErrorStream() << "Error, arrays and slices have a single dimension" << std::endl;
+        AbortCompilation();
+    }
+
+    return type;
+}
+
+Token Parser::ParseVectorType(){
+    Token vec = eat();
+    TryEat(TokenType::LESS_THAN);
+
+    if(!peek().has_value() || (IsNumericType(peek().value().type) == false && IsTypeToken(peek().value()) == false) || peek().value().type == TokenType::VEC || peek().value().type == TokenType::ATOMIC
+        || (peek().value().type == TokenType::IDENT && m_userTypes.contains(peek().value().value.value()))){
+        GetErrorStream() << "Error, the element type of a vector has to be a number" << std::endl;
+        AbortCompilation();
+    }
+
+    Token type = eat();
+    TryEat(TokenType::COMMA);
+
+    if(!peek().has_value() || peek().value().type != TokenType::INT_LIT){
+        GetErrorStream() << "Error, expected the number of lanes of the vector" << std::endl;
+        AbortCompilation();
+    }
+
+    // LLVM handles any width, wider vectors than the target has are split into several registers
+    std::string lanes = eat().value.value();
+
+    if(lanes.size() > 4 || std::stoul(lanes) == 0 || std::stoul(lanes) > 1024){
+        GetErrorStream() << "Error, a vector has between 1 and 1024 lanes" << std::endl;
+        AbortCompilation();
+    }
+
+    TryEat(TokenType::GREATER_THAN);
+
+    type.lanes = std::stoul(lanes);
+    type.line = vec.line;
+    type.column = vec.column;
+    return type;
+}
+
+Token Parser::ParseAtomicType(){
+    Token atomic = eat();
+    TryEat(TokenType::LESS_THAN);
+
+    // LLVM only has atomic read-modify-write and compare-exchange for integers of up to the native width
+    if(!peek().has_value() || IsNumericType(peek().value().type) == false || IsFloatType(peek().value().type)){
+        GetErrorStream() << "Error, the type of an atomic has to be an integer type" << std::endl;
+        AbortCompilation();
+    }
+
+    Token type = eat();
+    TryEat(TokenType::GREATER_THAN);
+
+    type.isAtomic = true;
+    type.line = atomic.line;
+    type.column = atomic.column;
+    return type;
+}
+
+std::unique_ptr<CallExprNode> Parser::ParseCallExpr(){
+    auto call = std::make_unique<CallExprNode>();
+
+    call->callee = eat(); // eats function name
+
+    if(peek().has_value() && peek().value().type == TokenType::LESS_THAN){
+        call->typeArgs = ParseTypeList();
+    }
+
+    TryEat(TokenType::OPEN_PAREN);
+
+    while(peek().has_value() && peek().value().type != TokenType::CLOSE_PAREN){
+        call->args.push_back(ParseExpr());
+
+        if(peek().has_value() && peek().value().type == TokenType::COMMA){
+            eat();
+        } else {
+            break;
+        }
+    }
+
+    TryEat(TokenType::CLOSE_PAREN);
+
+    return call;
+}
+
+std::unique_ptr<CastExprNode> Parser::ParseCastExpr(){
+    auto cast = std::make_unique<CastExprNode>();
+    cast->type = ParseType();
+
+    if(!peek().has_value() || peek().value().type != TokenType::OPEN_PAREN){
+        GetErrorStream() << "Error, expected '(' after the type of a conversion" << std::endl;
+        AbortCompilation();
+    }
+
+    eat(); // eats (
+    cast->expression = ParseExpr();
+    TryEat(TokenType::CLOSE_PAREN);
+
+    return cast;
+}
+
 std::unique_ptr<PrimaryExprNode> Parser::ParsePrimaryExpr(){
     auto primaryexpr = std::make_unique<PrimaryExprNode>();
 
@@ -47,29 +261,111 @@ std::unique_ptr<PrimaryExprNode> Parser::ParsePrimaryExpr(){
 
         switch(peek().value().type){
             case TokenType::INT_LIT:
-                {
-                    auto intLit = std::make_unique<IntLitNode>();
-                    intLit->val = eat();
-                    primaryexpr->var = std::move(intLit);
-                    break;
-                }
-
             case TokenType::FLOAT_LIT:
                 {
-                    auto floatLit = std::make_unique<FloatLitNode>();
-                    floatLit->val = eat();
-                    primaryexpr->var = std::move(floatLit);
+                    Token literal = eat();
+                    std::string text = literal.value.value();
+                    size_t suffixStart = text.find_first_not_of("0123456789.");
+                    std::optional<TokenType> suffix;
+
+                    if(suffixStart != std::string::npos){
+                        suffix = GetSuffixType(text.substr(suffixStart));
+
+                        // a float literal can't become an integer, 1.5i32 is most likely a typo
+                        if(!suffix || (literal.type == TokenType::FLOAT_LIT && IsFloatType(suffix.value()) == false)){
+                            GetErrorStream() << "Error, invalid suffix on literal " << text << std::endl;
+                            AbortCompilation();
+                        }
+
+                        literal.value = text.substr(0, suffixStart);
+                    }
+
+                    if(literal.type == TokenType::INT_LIT){
+                        auto intLit = std::make_unique<IntLitNode>();
+                        intLit->val = literal;
+                        intLit->type = suffix.value_or(TokenType::INT);
+                        intLit->hasSuffix = suffix.has_value();
+                        primaryexpr->var = std::move(intLit);
+                    } else {
+                        auto floatLit = std::make_unique<FloatLitNode>();
+                        floatLit->val = literal;
+                        floatLit->type = suffix.value_or(TokenType::FLOAT);
+                        floatLit->hasSuffix = suffix.has_value();
+                        primaryexpr->var = std::move(floatLit);
+                    }
                     break;
                 }
 
             case TokenType::IDENT:
                 {
+                    auto next = peek(1);
+
+                    // function call. a '<' only starts type arguments when a type follows it,
+                    // otherwise it is a less than comparison
+                    bool isGenericCall = next.has_value() && next.value().type == TokenType::LESS_THAN
+                        && peek(2).has_value() && IsTypeToken(peek(2).value())
+                        && peek(3).has_value() && (peek(3).value().type == TokenType::GREATER_THAN || peek(3).value().type == TokenType::COMMA);
+
+                    // T(x) with a type parameter T is a conversion
+                    if(IsTypeToken(peek().value()) && next.has_value() && next.value().type == TokenType::OPEN_PAREN){
+                        primaryexpr->var = ParseCastExpr();
+                        break;
+                    }
+
+                    if((next.has_value() && next.value().type == TokenType::OPEN_PAREN) || isGenericCall){
+                        primaryexpr->var = ParseCallExpr();
+                        break;
+                    }
+
+                    if(next.has_value() && next.value().type == TokenType::OPEN_SQUARE){
+                        auto index = std::make_unique<IndexExprNode>();
+                        index->identifier = eat();
+                        eat(); // eats [
+                        index->index = ParseExpr();
+                        TryEat(TokenType::CLOSE_SQUARE);
+                        index->fields = ParseFields();
+                        primaryexpr->var = std::move(index);
+                        break;
+                    }
+
+                    if(next.has_value() && next.value().type == TokenType::DOT){
+                        auto field = std::make_unique<FieldExprNode>();
+                        field->identifier = eat();
+                        field->fields = ParseFields();
+                        primaryexpr->var = std::move(field);
+                        break;
+                    }
+
                     auto ident = std::make_unique<IdentNode>();
                     ident->val = eat();
                     primaryexpr->var = std::move(ident);
                     break;
                 }
 
+            case TokenType::AMPERSAND:
+                {
+                    eat(); // eats &
+
+                    if(!peek().has_value() || peek().value().type != TokenType::IDENT){
+                        GetErrorStream() << "Error, expected a variable after '&'" << std::endl;
+                        AbortCompilation();
+                    }
+
+                    auto addressOf = std::make_unique<AddressOfExprNode>();
+                    addressOf->identifier = eat();
+
+                    if(peek().has_value() && peek().value().type == TokenType::OPEN_SQUARE){
+                        eat(); // eats [
+                        addressOf->index = ParseExpr();
+                        TryEat(TokenType::CLOSE_SQUARE);
+                    }
+
+                    addressOf->fields = ParseFields();
+                    m_addressTaken.insert(addressOf->identifier.value.value());
+                    primaryexpr->var = std::move(addressOf);
+                    break;
+                }
+
             case TokenType::OPEN_PAREN:
                 {
                     eat();
@@ -84,10 +380,19 @@ std::unique_ptr<PrimaryExprNode> Parser::ParsePrimaryExpr(){
                 }
 
             default:
-                std::cerr << "Unexpected token type found while parsing primary expression" << std::endl;
-                break;
+                if(IsNumericType(peek().value().type) || peek().value().type == TokenType::VEC || peek().value().type == TokenType::ATOMIC){
+                    primaryexpr->var = ParseCastExpr();
+                    break;
+                }
+
+                GetErrorStream() << "Unexpected token type found while parsing primary expression" << std::endl;
+                AbortCompilation();
         }
     }
+    else{
+        GetErrorStream() << "Unexpected end of file while parsing primary expression" << std::endl;
+        AbortCompilation();
+    }
     return primaryexpr;
 }
 
@@ -95,8 +400,8 @@ std::unique_ptr<ExprNode> Parser::ParseFactor(){
     auto lhs = ParsePrimaryExpr();
 
     if(!lhs){
-        std::cerr << "Error parsing primary expression in parse factor" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() << "Error parsing primary expression in parse factor" << std::endl;
+        AbortCompilation();
     } 
 
     auto lhsexpr = std::make_unique<ExprNode>();
@@ -169,8 +474,8 @@ std::unique_ptr<ExprNode> Parser::ParseTerm(){
     auto lhs = ParseFactor();
 
     if(!lhs){
-        std::cerr << "Error parsing primary expression in parse factor" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() << "Error parsing primary expression in parse factor" << std::endl;
+        AbortCompilation();
     } 
 
     auto lhsexpr = std::move(lhs);
@@ -241,8 +546,8 @@ std::unique_ptr<ExprNode> Parser::ParseComparison(){
     auto lhs = ParseTerm();
 
     if(!lhs){
-        std::cerr << "Erorr parsing term in parse comparison" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() << "Erorr parsing term in parse comparison" << std::endl;
+        AbortCompilation();
     }
 
     auto lhsExpr = std::move(lhs);
@@ -310,8 +615,8 @@ std::unique_ptr<ExprNode> Parser::ParseEquality(){
     auto lhs = ParseComparison();
 
     if(!lhs){
-        std::cerr << "Erorr parsing term in parse comparison" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() << "Erorr parsing term in parse comparison" << std::endl;
+        AbortCompilation();
     }
 
     auto lhsExpr = std::move(lhs);
@@ -371,16 +676,39 @@ std::unique_ptr<ExprNode> Parser::ParseExpr(){
 
 std::unique_ptr<ProtoTypeNode> Parser::ParseProto(){
     auto proto = std::make_unique<ProtoTypeNode>();
-    proto->returnType= eat(); // eat return type
+
+    // generic function
+    if(peek().has_value() && peek().value().type == TokenType::LESS_THAN){
+        proto->typeParams = ParseTypeList();
+
+        for(const auto& typeParam : proto->typeParams){
+            m_typeParams.push_back(typeParam.value.value());
+        }
+    }
+
+    proto->returnType = peek().has_value() && peek().value().type == TokenType::VOID ? eat() : ParseType();
     proto->name = eat(); // eat name
 
     TryEat(TokenType::OPEN_PAREN);
  
-    proto->argCounter= 0;
-    // try to parse args?
+    // parameters: TYPE IDENTIFIER (',' TYPE IDENTIFIER)*
     while(peek().has_value() && peek().value().type != TokenType::CLOSE_PAREN){
-        proto->args.push_back(ParseStmt());
-        proto->argCounter++;
+        ParamNode param;
+        param.type = ParseType();
+
+        if(peek().has_value() == false || peek().value().type != TokenType::IDENT){
+            GetErrorStream() << "Error, expected a parameter type and name" << std::endl;
+            AbortCompilation();
+        }
+
+        param.identifier = eat();
+        proto->params.push_back(param);
+
+        if(peek().has_value() && peek().value().type == TokenType::COMMA){
+            eat();
+        } else {
+            break;
+        }
     }
     TryEat(TokenType::CLOSE_PAREN);
     return proto;
@@ -389,8 +717,8 @@ std::unique_ptr<ProtoTypeNode> Parser::ParseProto(){
 std::unique_ptr<FunctionNode> Parser::ParseFunc(){
     auto prototype = ParseProto(); 
     if(!prototype){
-        std::cerr<<"error parsing prototype for function" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() <<"error parsing prototype for function" << std::endl;
+        AbortCompilation();
     }
     auto func = std::make_unique<FunctionNode>();
     func->prototype = std::move(prototype);
@@ -401,6 +729,10 @@ std::unique_ptr<FunctionNode> Parser::ParseFunc(){
         func->body.push_back(ParseStmt());
     }
     TryEat(TokenType::CLOSE_BRACKET);
+
+    func->addressTaken = std::move(m_addressTaken);
+    m_addressTaken.clear();
+    m_typeParams.clear();
     return func;
 }
 
@@ -420,7 +752,7 @@ std::unique_ptr<CompoundStmtNode> Parser::ParseCompoundStmt(){
 std::unique_ptr<DeclerationStmtNode> Parser::ParseDecleration(){
     auto decleration = std::make_unique<DeclerationStmtNode>();
 
-    decleration->type = eat();
+    decleration->type = ParseType();
 
     decleration->identifier = eat();
 
@@ -436,20 +768,212 @@ std::unique_ptr<DeclerationStmtNode> Parser::ParseDecleration(){
 
 }
 
-std::unique_ptr<AssignmentNode> Parser::ParseAssignmentStmt(){
+std::unique_ptr<AssignmentNode> Parser::ParseAssignmentStmt(bool semicolon){
     auto assignment = std::make_unique<AssignmentNode>();
 
     assignment->identifier = eat(); // eats identifier 
 
-    TryEat(TokenType::EQUAL);
+    if(peek().has_value() && peek().value().type == TokenType::OPEN_SQUARE){
+        eat(); // eats [
+        assignment->index = ParseExpr();
+        TryEat(TokenType::CLOSE_SQUARE);
+    }
 
-    assignment->expression = ParseExpr();
+    assignment->fields = ParseFields();
 
-    TryEat(TokenType::SEMI);
+    std::optional<BinOpType> compoundType;
+
+    if(peek().has_value()){
+        switch(peek().value().type){
+            case TokenType::ADD_EQ:
+                compoundType = BinOpType::ADD;
+                break;
+            case TokenType::SUB_EQ:
+                compoundType = BinOpType::SUB;
+                break;
+            case TokenType::MUL_EQ:
+                compoundType = BinOpType::MUL;
+                break;
+            case TokenType::DIV_EQ:
+                compoundType = BinOpType::DIV;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if(compoundType.has_value() && (assignment->index || assignment->fields.empty() == false)){
+        eat(); // eats the compound assignment operator
+        assignment->compoundType = compoundType;
+        assignment->expression = ParseExpr();
+    }
+    else if(compoundType.has_value()){
+        eat(); // eats the compound assignment operator
+
+        auto ident = std::make_unique<IdentNode>();
+        ident->val = assignment->identifier;
+
+        auto identPrimary = std::make_unique<PrimaryExprNode>();
+        identPrimary->var = std::move(ident);
+
+        auto lhs = std::make_unique<ExprNode>();
+        lhs->var = std::move(identPrimary);
+
+        auto binexpr = std::make_unique<BinOpExpr>();
+        binexpr->type = compoundType.value();
+        binexpr->lhs = std::move(lhs);
+        binexpr->rhs = ParseExpr();
+
+        assignment->expression = std::make_unique<ExprNode>();
+        assignment->expression->var = std::move(binexpr);
+    } else {
+        TryEat(TokenType::EQUAL);
+        assignment->expression = ParseExpr();
+    }
+
+    if(semicolon){
+        TryEat(TokenType::SEMI);
+    }
 
     return assignment;
 }
 
+std::vector<Token> Parser::ParseFields(){
+    std::vector<Token> fields;
+
+    while(peek().has_value() && peek().value().type == TokenType::DOT){
+        eat(); // eats .
+
+        if(!peek().has_value() || peek().value().type != TokenType::IDENT){
+            GetErrorStream() << "Error, expected the name of a field after '.'" << std::endl;
+            AbortCompilation();
+        }
+
+        fields.push_back(eat());
+    }
+
+    return fields;
+}
+
+StructLayout Parser::ParseStructLayout(){
+    StructLayout layout;
+
+    while(peek().has_value() && peek().value().type == TokenType::AT){
+        eat(); // eats @
+
+        if(!peek().has_value() || peek().value().type != TokenType::IDENT){
+            GetErrorStream() << "Error, expected an annotation after '@'" << std::endl;
+            AbortCompilation();
+        }
+
+        std::string name = eat().value.value();
+
+        if(name == "packed"){
+            layout.packed = true;
+        }
+        else if(name == "cacheline_pad"){
+            layout.cachelinePad = true;
+        }
+        else if(name == "soa"){
+            layout.soa = true;
+        }
+        else if(name == "align"){
+            TryEat(TokenType::OPEN_PAREN);
+
+            std::string digits = peek().has_value() && peek().value().type == TokenType::INT_LIT ? peek().value().value.value() : "";
+            unsigned long align = digits.size() > 0 && digits.size() <= 4 && digits.find_first_not_of("0123456789") == std::string::npos ? std::stoul(digits) : 0;
+
+            // LLVM supports larger alignments, but nothing in memory is aligned to more than a page
+            if(align == 0 || align > 4096 || (align & (align - 1)) != 0){
+                GetErrorStream() << "Error, @align expects a power of two up to 4096" << std::endl;
+                AbortCompilation();
+            }
+
+            eat(); // eats the alignment
+            TryEat(TokenType::CLOSE_PAREN);
+            layout.align = align;
+        }
+        else{
+            GetErrorStream() << "Error, unknown struct annotation @" << name << ", expected @packed, @align, @cacheline_pad or @soa" << std::endl;
+            AbortCompilation();
+        }
+    }
+
+    if(layout.soa && (layout.packed || layout.align != 0 || layout.cachelinePad)){
+        GetErrorStream() << "Error, @soa can't be combined with @packed, @align or @cacheline_pad" << std::endl;
+        AbortCompilation();
+    }
+
+    if(layout.packed && layout.cachelinePad){
+        GetErrorStream() << "Error, @packed and @cacheline_pad can't be used on the same struct" << std::endl;
+        AbortCompilation();
+    }
+
+    return layout;
+}
+
+bool Parser::IsStructAhead(){
+    int offset = 0;
+
+    // @name or @name(argument)
+    while(peek(offset).has_value() && peek(offset).value().type == TokenType::AT){
+        offset += 2;
+
+        if(peek(offset).has_value() && peek(offset).value().type == TokenType::OPEN_PAREN){
+            offset += 3;
+        }
+    }
+
+    return peek(offset).has_value() && peek(offset).value().type == TokenType::STRUCT;
+}
+
+std::unique_ptr<StructNode> Parser::ParseStruct(){
+    auto structNode = std::make_unique<StructNode>();
+    structNode->layout = ParseStructLayout();
+
+    eat(); // eats struct
+
+    if(!peek().has_value() || peek().value().type != TokenType::IDENT){
+        GetErrorStream() << "Error, expected the name of the struct" << std::endl;
+        AbortCompilation();
+    }
+
+    structNode->name = eat();
+    std::string name = structNode->name.value.value();
+
+    if(m_userTypes.contains(name)){
+        GetErrorStream() << "Error, struct " << name << " is already declared" << std::endl;
+        AbortCompilation();
+    }
+
+    TryEat(TokenType::OPEN_BRACKET);
+
+    // the struct isn't a type yet, so it can't contain itself
+    while(peek().has_value() && peek().value().type != TokenType::CLOSE_BRACKET){
+        StructFieldNode field;
+        field.type = ParseType();
+
+        if(!peek().has_value() || peek().value().type != TokenType::IDENT){
+            GetErrorStream() << "Error, expected the name of a field of struct " << name << std::endl;
+            AbortCompilation();
+        }
+
+        field.identifier = eat();
+        TryEat(TokenType::SEMI);
+        structNode->fields.push_back(field);
+    }
+
+    TryEat(TokenType::CLOSE_BRACKET);
+
+    if(structNode->fields.empty()){
+        GetErrorStream() << "Error, struct " << name << " has no fields" << std::endl;
+        AbortCompilation();
+    }
+
+    m_userTypes[name] = structNode->layout.soa;
+    return structNode;
+}
+
 std::unique_ptr<IfStmtNode> Parser::ParseIfStmt(){
 
     auto ifStmt = std::make_unique<IfStmtNode>();
@@ -486,47 +1010,228 @@ std::unique_ptr<IfStmtNode> Parser::ParseIfStmt(){
 
 }
 
+// parses the annotations in front of a function or a loop. example: @vectorize(4) @unroll(2)
+LoopHints Parser::ParseAnnotations(std::optional<FastMathAttribute>& fastMath){
+    LoopHints hints;
+
+    while(peek().has_value() && peek().value().type == TokenType::AT){
+        if(peek(1).has_value() && peek(1).value().value == "fastmath"){
+            fastMath = ParseFastMathAttribute();
+            continue;
+        }
+
+        eat(); // eats @
+
+        if(!peek().has_value() || peek().value().type != TokenType::IDENT){
+            GetErrorStream() << "Error, expected an annotation after '@'" << std::endl;
+            AbortCompilation();
+        }
+
+        Token name = eat();
+        std::optional<unsigned> argument;
+
+        if(peek().has_value() && peek().value().type == TokenType::OPEN_PAREN){
+            eat();
+
+            std::string digits = peek().has_value() && peek().value().type == TokenType::INT_LIT ? peek().value().value.value() : "";
+            unsigned long count = digits.size() > 0 && digits.size() <= 4 && digits.find_first_not_of("0123456789") == std::string::npos ? std::stoul(digits) : 0;
+
+            // no target has more lanes than a vec<T, 1024>, and larger unroll counts only bloat the loop
+            if(count == 0 || count > 1024){
+                GetErrorStream() << "Error, @" << name.value.value() << " expects a number from 1 to 1024" << std::endl;
+                AbortCompilation();
+            }
+
+            eat(); // eats the number
+            argument = count;
+            TryEat(TokenType::CLOSE_PAREN);
+        }
+
+        if(name.value.value() == "vectorize"){
+            hints.vectorize = true;
+            hints.vectorizeWidth = argument.value_or(0);
+        }
+        else if(name.value.value() == "unroll"){
+            hints.unroll = true;
+            hints.unrollCount = argument.value_or(0);
+        }
+        else if(name.value.value() == "nounroll" && argument.has_value() == false){
+            hints.noUnroll = true;
+        }
+        else if(name.value.value() == "unchecked" && argument.has_value() == false){
+            hints.unchecked = true;
+        }
+        else{
+            GetErrorStream() << "Error, unknown annotation @" << name.value.value() << std::endl;
+            AbortCompilation();
+        }
+    }
+
+    if(hints.unroll && hints.noUnroll){
+        GetErrorStream() << "Error, @unroll and @nounroll can't be used on the same loop" << std::endl;
+        AbortCompilation();
+    }
+
+    return hints;
+}
+
+FastMathAttribute Parser::ParseFastMathAttribute(){
+    FastMathAttribute fastMath;
+
+    eat(); // eats @
+    eat(); // eats fastmath
+
+    if(!peek().has_value() || peek().value().type != TokenType::OPEN_PAREN){
+        return {true, true, true, true, true, true, true};
+    }
+
+    eat(); // eats (
+
+    while(peek().has_value() && peek().value().type == TokenType::IDENT){
+        std::string flag = eat().value.value();
+
+        if(flag == "reassoc") fastMath.reassoc = true;
+        else if(flag == "contract") fastMath.contract = true;
+        else if(flag == "arcp") fastMath.arcp = true;
+        else if(flag == "nnan") fastMath.nnan = true;
+        else if(flag == "ninf") fastMath.ninf = true;
+        else if(flag == "nsz") fastMath.nsz = true;
+        else if(flag == "afn") fastMath.afn = true;
+        else{
+            GetErrorStream() << "Error, unknown fast-math flag " << flag << ", expected reassoc, contract, arcp, nnan, ninf, nsz or afn" << std::endl;
+            AbortCompilation();
+        }
+
+        if(peek().has_value() && peek().value().type == TokenType::COMMA){
+            eat();
+        } else {
+            break;
+        }
+    }
+
+    if(!peek().has_value() || peek().value().type != TokenType::CLOSE_PAREN){
+        GetErrorStream() << "Error, expected ')' after the fast-math flags" << std::endl;
+        AbortCompilation();
+    }
+
+    eat(); // eats )
+    return fastMath;
+}
+
+std::unique_ptr<WhileStmtNode> Parser::ParseWhileStmt(){
+    auto whileStmt = std::make_unique<WhileStmtNode>();
+
+    TryEat(TokenType::OPEN_PAREN);
+    whileStmt->condition = ParseExpr();
+    TryEat(TokenType::CLOSE_PAREN);
+
+    TryEat(TokenType::OPEN_BRACKET);
+
+    while(peek().has_value() && peek().value().type != TokenType::CLOSE_BRACKET){
+        whileStmt->body.push_back(ParseStmt());
+    }
+
+    TryEat(TokenType::CLOSE_BRACKET);
+
+    return whileStmt;
+}
+
+std::unique_ptr<ForStmtNode> Parser::ParseForStmt(){
+    auto forStmt = std::make_unique<ForStmtNode>();
+
+    TryEat(TokenType::OPEN_PAREN);
+
+    if(peek().has_value() && peek().value().type == TokenType::SEMI){
+        eat();
+    } else {
+        forStmt->init = ParseStmt();
+
+        bool isDecleration = std::holds_alternative<std::unique_ptr<DeclerationStmtNode>>(forStmt->init->var);
+        bool isAssignment = std::holds_alternative<std::unique_ptr<AssignmentNode>>(forStmt->init->var);
+
+        if(!isDecleration && !isAssignment){
+            GetErrorStream() << "Error, the first part of a for loop must be a decleration or an assignment" << std::endl;
+            AbortCompilation();
+        }
+    }
+
+    if(peek().has_value() && peek().value().type != TokenType::SEMI){
+        forStmt->condition = ParseExpr();
+    }
+
+    TryEat(TokenType::SEMI);
+
+    if(peek().has_value() && peek().value().type != TokenType::CLOSE_PAREN){
+        if(peek().value().type != TokenType::IDENT){
+            GetErrorStream() << "Error, the last part of a for loop must be an assignment" << std::endl;
+            AbortCompilation();
+        }
+
+        forStmt->step = ParseAssignmentStmt(false);
+    }
+
+    TryEat(TokenType::CLOSE_PAREN);
+
+    TryEat(TokenType::OPEN_BRACKET);
+
+    while(peek().has_value() && peek().value().type != TokenType::CLOSE_BRACKET){
+        forStmt->body.push_back(ParseStmt());
+    }
+
+    TryEat(TokenType::CLOSE_BRACKET);
+
+    return forStmt;
+}
+
 std::unique_ptr<StmtNode> Parser::ParseStmt(){
     auto stmt = std::make_unique<StmtNode>();
 
     auto current = peek();
     if (!current.has_value()) {
-        std::cerr << "error: unexpected end of input while parsing statement" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() << "error: unexpected end of input while parsing statement" << std::endl;
+        AbortCompilation();
     }
 
+    stmt->line = current->line;
+    stmt->column = current->column;
+
     // compound statements
     if(peek().value().type == TokenType::OPEN_BRACKET){
       eat(); // eats open bracket
       auto compoundStmt = ParseCompoundStmt();
 
       if(!compoundStmt){
-        std::cerr << "error: couldnt parse compoundStmt" << std::endl;
-        exit(EXIT_FAILURE);
+        GetErrorStream() << "error: couldnt parse compoundStmt" << std::endl;
+        AbortCompilation();
       }
 
       stmt->var = std::move(compoundStmt);
     }
 
+    else if(IsStructAhead()){
+        GetErrorStream() << "Error, structs can only be declared at the top level" << std::endl;
+        AbortCompilation();
+    }
+
     // handles functions
-    if(peek().value().type == TokenType::FN){
+    else if(peek().value().type == TokenType::FN){
         eat(); // eat fn token
         auto func = ParseFunc();
         if(!func){
-            std::cerr << "error parsing function" << std::endl;
-            exit(EXIT_FAILURE);
+            GetErrorStream() << "error parsing function" << std::endl;
+            AbortCompilation();
         }
         stmt->var = std::move(func);
         
     }
 
-    else if(peek().value().type == TokenType::INT || peek().value().type == TokenType::FLOAT || peek().value().type == TokenType::UINT){
+    else if(IsNumericType(peek().value().type) || peek().value().type == TokenType::VEC || peek().value().type == TokenType::ATOMIC){
 
         auto decleration = ParseDecleration();
 
         if(!decleration){
-            std::cerr << "error parsing let statement" << std::endl;
-            exit(EXIT_FAILURE);
+            GetErrorStream() << "error parsing let statement" << std::endl;
+            AbortCompilation();
         }
         stmt->var = std::move(decleration);
     }
@@ -537,23 +1242,51 @@ std::unique_ptr<StmtNode> Parser::ParseStmt(){
         auto next = peek(1);
 
         if (next.has_value() == false) {
-            std::cerr << "Error: unexpected end of input after identifier" << std::endl;
-            exit(EXIT_FAILURE);
+            GetErrorStream() << "Error: unexpected end of input after identifier" << std::endl;
+            AbortCompilation();
+        }
+
+        // decleration using a struct or a type parameter. example: T x = 10;
+        if (IsTypeToken(peek().value()) && (next->type == TokenType::IDENT || next->type == TokenType::OPEN_SQUARE || next->type == TokenType::MUL)) {
+            auto decleration = ParseDecleration();
+            stmt->var = std::move(decleration);
         }
 
         // assigment statement
-        if (next->type == TokenType::EQUAL) {
+        else if (next->type == TokenType::EQUAL || next->type == TokenType::OPEN_SQUARE || next->type == TokenType::DOT || next->type == TokenType::ADD_EQ || next->type == TokenType::SUB_EQ
+            || next->type == TokenType::MUL_EQ || next->type == TokenType::DIV_EQ) {
             auto assignment = ParseAssignmentStmt();
             if (!assignment) {
-                std::cerr << "error parsing assignment" << std::endl;
-                exit(EXIT_FAILURE);
+                GetErrorStream() << "error parsing assignment" << std::endl;
+                AbortCompilation();
             }
             stmt->var = std::move(assignment);
         }
 
-        // function call
-        else if (next->type == TokenType::OPEN_PAREN) {
+        // function call, a '<' after an identifier can only start type arguments here
+        else if (next->type == TokenType::OPEN_PAREN || next->type == TokenType::LESS_THAN) {
+            auto exprStmt = std::make_unique<ExprStmtNode>();
+            exprStmt->expression = ParseExpr();
+            TryEat(TokenType::SEMI);
+            stmt->var = std::move(exprStmt);
+        }
+
+        else {
+            GetErrorStream() << "Error, expected an assignment or a call after " << peek().value().value.value() << std::endl;
+            AbortCompilation();
+        }
+    }
+
+    else if(peek().value().type == TokenType::RETURN){
+        eat(); // eats return token
+        auto returnStmt = std::make_unique<ReturnNode>();
+
+        if(peek().has_value() && peek().value().type != TokenType::SEMI){
+            returnStmt->value = ParseExpr();
         }
+
+        TryEat(TokenType::SEMI);
+        stmt->var = std::move(returnStmt);
     }
 
     else if(peek().value().type == TokenType::IF){
@@ -561,22 +1294,74 @@ std::unique_ptr<StmtNode> Parser::ParseStmt(){
         auto ifStmt = ParseIfStmt();
 
         if(!ifStmt){
-            std::cerr << "Error parsing if statement" << std::endl;
-            exit(EXIT_FAILURE);
+            GetErrorStream() << "Error parsing if statement" << std::endl;
+            AbortCompilation();
         }
         stmt->var = std::move(ifStmt);
     }
 
+    // functions and loops with annotations, and loops without them
+    else if(peek().value().type == TokenType::AT || peek().value().type == TokenType::WHILE || peek().value().type == TokenType::FOR){
+        std::optional<FastMathAttribute> fastMath;
+        LoopHints hints = ParseAnnotations(fastMath);
+        bool isLoop = peek().has_value() && (peek().value().type == TokenType::WHILE || peek().value().type == TokenType::FOR);
+
+        if(fastMath.has_value() && isLoop){
+            GetErrorStream() << "Error, @fastmath must be followed by a function" << std::endl;
+            AbortCompilation();
+        }
+
+        if(peek().has_value() && peek().value().type == TokenType::FN){
+            if(hints.vectorize || hints.unroll || hints.noUnroll){
+                GetErrorStream() << "Error, loop annotations must be followed by a while or for loop" << std::endl;
+                AbortCompilation();
+            }
+
+            eat(); // eat fn token
+            auto func = ParseFunc();
+            func->fastMath = fastMath.value_or(FastMathAttribute{});
+            func->unchecked = hints.unchecked;
+            stmt->var = std::move(func);
+        }
+        else if(peek().has_value() && peek().value().type == TokenType::WHILE){
+            eat(); // eats while token
+            auto whileStmt = ParseWhileStmt();
+            whileStmt->hints = hints;
+            stmt->var = std::move(whileStmt);
+        }
+        else if(peek().has_value() && peek().value().type == TokenType::FOR){
+            eat(); // eats for token
+            auto forStmt = ParseForStmt();
+            forStmt->hints = hints;
+            stmt->var = std::move(forStmt);
+        }
+        else{
+            GetErrorStream() << "Error, annotations must be followed by a function or a while or for loop" << std::endl;
+            AbortCompilation();
+        }
+    }
+
+    // nothing would consume the token
+    else{
+        GetErrorStream() << "Error, unexpected token at the start of a statement" << std::endl;
+        AbortCompilation();
+    }
+
     return stmt;
 }
 
 std::unique_ptr<ProgNode> Parser::Parse() {
     auto prog = std::make_unique<ProgNode>();  
     while (peek().has_value()) {
+        if (IsStructAhead()) {
+            prog->structs.push_back(ParseStruct());
+            continue;
+        }
+
         auto stmt = ParseStmt();
         if (!stmt) {
-            std::cerr << "error parsing stmt" << std::endl;
-            exit(EXIT_FAILURE);
+            GetErrorStream() << "error parsing stmt" << std::endl;
+            AbortCompilation();
         }
         prog->stmts.push_back(std::move(stmt));
     }
@@ -0,0 +1,93 @@
+#include "profiling.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include <string>
+
+PerfMapListener::PerfMapListener(){
+    std::string path = "/tmp/perf-" + std::to_string(llvm::sys::Process::getProcessId()) + ".map";
+    std::error_code error;
+
+    m_file = std::make_unique<llvm::raw_fd_ostream>(path, error);
+
+    if(error){
+        llvm::errs() << "ERROR: Could not open " << path << ": " << error.message() << "\n";
+        m_file.reset();
+    }
+}
+
+void PerfMapListener::notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info){
+    if(m_file == nullptr){
+        return;
+    }
+
+    // the debug object has its symbols at the addresses the code was loaded to
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObject = info.getObjectForDebug(object);
+
+    if(debugObject.getBinary() == nullptr){
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for(const auto& [symbol, size] : llvm::object::computeSymbolSizes(*debugObject.getBinary())){
+        auto type = symbol.getType();
+
+        if(!type){
+            llvm::consumeError(type.takeError());
+            continue;
+        }
+
+        if(*type != llvm::object::SymbolRef::ST_Function){
+            continue;
+        }
+
+        auto name = symbol.getName();
+        auto address = symbol.getAddress();
+
+        if(!name || !address){
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(address.takeError());
+            continue;
+        }
+
+        *m_file << llvm::format_hex_no_prefix(*address, 1) << " " << llvm::format_hex_no_prefix(size, 1) << " " << *name << "\n";
+    }
+
+    // perf can read the map while the program is still running
+    m_file->flush();
+}
+
+const std::vector<llvm::JITEventListener*>& GetProfilingListeners(){
+    static std::vector<llvm::JITEventListener*> listeners = []{
+        static PerfMapListener perfMap;
+        std::vector<llvm::JITEventListener*> created = {&perfMap};
+
+        // writes jit-<pid>.dump for perf inject --jit, with line tables for code built with debug info
+        if(llvm::JITEventListener* jitdump = llvm::JITEventListener::createPerfJITEventListener()){
+            created.push_back(jitdump);
+        } else {
+            llvm::errs() << "WARNING: LLVM was built without perf support, only the perf map is written\n";
+        }
+
+        return created;
+    }();
+
+    return listeners;
+}
+
+std::unique_ptr<llvm::orc::ObjectLayer> CreateProfiledObjectLayer(llvm::orc::ExecutionSession& session){
+    // the memory manager callback takes the object buffer in newer versions of LLVM
+    auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(session, [](auto&&...){
+        return std::make_unique<llvm::SectionMemoryManager>();
+    });
+
+    for(llvm::JITEventListener* listener : GetProfilingListeners()){
+        layer->registerJITEventListener(*listener);
+    }
+
+    return layer;
+}
@@ -0,0 +1,454 @@
+#include "server.hpp"
+#include "diagnostics.hpp"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <csignal>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// every message is a sequence of fields, a field is a 32 bit length followed by its bytes.
+// numbers are sent as fields too, client and server always run on the same machine
+static constexpr uint32_t MaxFieldSize = 256u << 20;
+
+static bool WriteAll(int fd, const char* data, size_t size){
+    while(size > 0){
+        // a client that went away must not kill the server with SIGPIPE
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+
+        if(written <= 0){
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+static bool ReadAll(int fd, char* data, size_t size){
+    while(size > 0){
+        ssize_t received = recv(fd, data, size, 0);
+
+        if(received <= 0){
+            return false;
+        }
+
+        data += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+static bool WriteField(int fd, const std::string& field){
+    uint32_t size = field.size();
+    return WriteAll(fd, reinterpret_cast<const char*>(&size), sizeof(size)) && WriteAll(fd, field.data(), field.size());
+}
+
+static bool ReadField(int fd, std::string& field){
+    uint32_t size = 0;
+
+    if(ReadAll(fd, reinterpret_cast<char*>(&size), sizeof(size)) == false || size > MaxFieldSize){
+        return false;
+    }
+
+    field.resize(size);
+    return ReadAll(fd, field.data(), size);
+}
+
+static bool WriteRequest(int fd, const CompileRequest& request){
+    if(WriteField(fd, request.cwd) == false || WriteField(fd, std::to_string(request.args.size())) == false){
+        return false;
+    }
+
+    for(const std::string& arg : request.args){
+        if(WriteField(fd, arg) == false){
+            return false;
+        }
+    }
+
+    return WriteField(fd, request.source);
+}
+
+static bool ReadRequest(int fd, CompileRequest& request){
+    std::string count;
+
+    if(ReadField(fd, request.cwd) == false || ReadField(fd, count) == false){
+        return false;
+    }
+
+    if(count.empty() || count.size() > 4 || count.find_first_not_of("0123456789") != std::string::npos){
+        return false;
+    }
+
+    request.args.resize(std::stoul(count));
+
+    for(std::string& arg : request.args){
+        if(ReadField(fd, arg) == false){
+            return false;
+        }
+    }
+
+    return ReadField(fd, request.source);
+}
+
+static bool WriteResponse(int fd, const CompileResponse& response){
+    return WriteField(fd, std::to_string(response.status))
+        && WriteField(fd, std::to_string(response.latencyMicros))
+        && WriteField(fd, response.output)
+        && WriteField(fd, response.error);
+}
+
+static bool ReadResponse(int fd, CompileResponse& response){
+    std::string status, latency;
+
+    if(ReadField(fd, status) == false || ReadField(fd, latency) == false){
+        return false;
+    }
+
+    response.status = std::stoi(status);
+    response.latencyMicros = std::stoull(latency);
+
+    return ReadField(fd, response.output) && ReadField(fd, response.error);
+}
+
+// a connected socket, or -1 when nothing listens on the path
+static int Connect(const std::string& path){
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if(path.size() >= sizeof(address.sun_path)){
+        return -1;
+    }
+
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd < 0){
+        return -1;
+    }
+
+    if(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0){
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// relative paths of the request are relative to the working directory of the client
+static std::string ResolvePath(const std::string& cwd, const std::string& path){
+    if(path.empty() || path == "-" || std::filesystem::path(path).is_absolute()){
+        return path;
+    }
+
+    return (std::filesystem::path(cwd) / path).lexically_normal().string();
+}
+
+// path of the listening socket, removed when the server is stopped with ctrl-c or kill
+static char s_socketPath[sizeof(sockaddr_un::sun_path)];
+
+static void StopServer(int){
+    unlink(s_socketPath);
+    _exit(0);
+}
+
+std::string GetDefaultSocketPath(){
+    const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+
+    if(runtimeDirectory != nullptr && runtimeDirectory[0] == '/'){
+        return std::string(runtimeDirectory) + "/xd.sock";
+    }
+
+    return "/tmp/xd-" + std::to_string(getuid()) + "/xd.sock";
+}
+
+// creates the directory of the default socket, or checks that the existing one can't be
+// entered by anyone but the user. /tmp is shared, another user could have created it first
+static bool MakePrivateDirectory(const std::string& path){
+    if(mkdir(path.c_str(), S_IRWXU) != 0 && errno != EEXIST){
+        std::cerr << "Error: Could not create " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat status{};
+
+    if(lstat(path.c_str(), &status) != 0 || S_ISDIR(status.st_mode) == false || status.st_uid != getuid() || (status.st_mode & (S_IRWXG | S_IRWXO)) != 0){
+        std::cerr << "Error: " << path << " must be a directory that only belongs to the user" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// true when the process on the other end runs as the same user as the server
+static bool IsSameUser(int connection){
+#ifdef __linux__
+    ucred credentials{};
+    socklen_t size = sizeof(credentials);
+
+    return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == getuid();
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+
+    return getpeereid(connection, &uid, &gid) == 0 && uid == getuid();
+#endif
+}
+
+CompileServer::CompileServer(const Options& options) : m_socketPath(options.socketPath.empty() ? GetDefaultSocketPath() : options.socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if(m_socketPath.size() >= sizeof(address.sun_path)){
+        std::cerr << "Error: Socket path " << m_socketPath << " is too long" << std::endl;
+        return;
+    }
+
+    std::strncpy(address.sun_path, m_socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    if(options.socketPath.empty() && MakePrivateDirectory(std::filesystem::path(m_socketPath).parent_path().string()) == false){
+        return;
+    }
+
+    int running = Connect(m_socketPath);
+
+    if(running >= 0){
+        close(running);
+        std::cerr << "Error: A compile server is already listening on " << m_socketPath << std::endl;
+        return;
+    }
+
+    // nothing listens on it, so the file is left over from a server that was killed
+    unlink(m_socketPath.c_str());
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(m_socket < 0){
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    // requests write files with the permissions of the server, only its user may connect. the
+    // socket is created without access for others, there is no window before a chmod
+    mode_t mask = umask(S_IRWXG | S_IRWXO);
+    bool listening = bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && listen(m_socket, SOMAXCONN) == 0;
+    umask(mask);
+
+    if(listening == false){
+        std::cerr << "Error: Could not listen on " << m_socketPath << ": " << std::strerror(errno) << std::endl;
+        close(m_socket);
+        m_socket = -1;
+        return;
+    }
+}
+
+CompileServer::~CompileServer(){
+    if(m_socket >= 0){
+        close(m_socket);
+        unlink(m_socketPath.c_str());
+    }
+}
+
+bool CompileServer::IsValid(){
+    return m_socket >= 0;
+}
+
+int CompileServer::Run(){
+    if(!IsValid()){
+        return EXIT_FAILURE;
+    }
+
+    std::strncpy(s_socketPath, m_socketPath.c_str(), sizeof(s_socketPath) - 1);
+    std::signal(SIGINT, StopServer);
+    std::signal(SIGTERM, StopServer);
+
+    std::cerr << "xd: compile server listening on " << m_socketPath << std::endl;
+
+    while(true){
+        int connection = accept(m_socket, nullptr, nullptr);
+
+        if(connection < 0){
+            if(errno == EINTR){
+                continue;
+            }
+
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::thread([this, connection]{
+            ServeConnection(connection);
+            close(connection);
+        }).detach();
+    }
+}
+
+void CompileServer::ServeConnection(int connection){
+    // the permissions of the socket already keep other users out, unless it was given a shared path
+    if(IsSameUser(connection) == false){
+        std::lock_guard<std::mutex> lock(m_logMutex);
+        std::cerr << "xd: refused a connection from another user" << std::endl;
+        return;
+    }
+
+    CompileRequest request;
+
+    if(ReadRequest(connection, request) == false){
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    CompileResponse response;
+
+    // an exception escaping the thread would terminate the server, it only fails the request
+    try{
+        response = Compile(request);
+    }
+    catch(const std::exception& exception){
+        response = {};
+        response.error = std::string("Error: Internal compiler error: ") + exception.what() + "\n";
+    }
+    catch(...){
+        response = {};
+        response.error = "Error: Internal compiler error\n";
+    }
+
+    response.latencyMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::lock_guard<std::mutex> lock(m_logMutex);
+
+        std::string commandLine;
+        for(const std::string& arg : request.args){
+            commandLine += (commandLine.empty() ? "" : " ") + arg;
+        }
+
+        std::cerr << "xd: " << (response.status == 0 ? "compiled '" : "failed '") << commandLine << "' in "
+                  << response.latencyMicros / 1000.0 << " ms (" << m_pool.GetCreatedCount() << " target machines)" << std::endl;
+    }
+
+    WriteResponse(connection, response);
+}
+
+CompileResponse CompileServer::Compile(const CompileRequest& request){
+    CompileResponse response;
+
+    // the client prints the errors and warnings of its own compilation, the server prints none
+    std::ostringstream errors;
+    ErrorStreamScope scope(errors);
+
+    std::vector<std::string> args = {"xd"};
+    args.insert(args.end(), request.args.begin(), request.args.end());
+
+    std::vector<char*> argv;
+
+    for(std::string& arg : args){
+        argv.push_back(arg.data());
+    }
+
+    Options options;
+
+    if(ParseOptions(argv.size(), argv.data(), options) == false){
+        response.error = errors.str() + "Error: Invalid options\n";
+        return response;
+    }
+
+    if(options.serve || options.client || options.mode == Mode::Run){
+        response.error = "Error: The compile server only compiles, it doesn't run programs or serve requests\n";
+        return response;
+    }
+
+    bool printIR = options.outputType == OutputType::IR && options.outputPath.empty();
+
+    if(options.inputPath == "-" && options.outputPath.empty() && printIR == false){
+        response.error = "Error: Source read from stdin needs an output file, use -o\n";
+        return response;
+    }
+
+    options.inputPath = ResolvePath(request.cwd, options.inputPath);
+    options.outputPath = ResolvePath(request.cwd, options.outputPath);
+    options.cacheDir = ResolvePath(request.cwd, options.cacheDir);
+
+    CompilerInstance compiler(options, &m_pool);
+
+    bool compiled = options.inputPath == "-" ? compiler.Compile(request.source) : compiler.CompileFile();
+
+    if(compiled == false){
+        response.error = errors.str() + "Error: Compilation failed\n";
+        return response;
+    }
+
+    if(printIR){
+        llvm::raw_string_ostream output(response.output);
+
+        for(auto& generated : compiler.TakeModules()){
+            generated.module->print(output, nullptr);
+        }
+
+        output.flush();
+    }
+    else if(compiler.Emit() == false){
+        response.error = errors.str() + "Error: Could not write the output\n";
+        return response;
+    }
+
+    response.error = errors.str();
+    response.status = 0;
+    return response;
+}
+
+int RunClient(const Options& options, int argc, char * argv[]){
+    std::string socketPath = options.socketPath.empty() ? GetDefaultSocketPath() : options.socketPath;
+
+    CompileRequest request;
+    request.cwd = std::filesystem::current_path().string();
+
+    // the server parses the same command line, minus the options that only concern the client
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+
+        if(arg != "--client" && arg.starts_with("--socket=") == false){
+            request.args.push_back(arg);
+        }
+    }
+
+    if(options.inputPath == "-"){
+        request.source.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+
+    int connection = Connect(socketPath);
+
+    if(connection < 0){
+        std::cerr << "Error: No compile server is listening on " << socketPath << ", start one with xd --serve" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    CompileResponse response;
+
+    if(WriteRequest(connection, request) == false || ReadResponse(connection, response) == false){
+        std::cerr << "Error: Lost the connection to the compile server" << std::endl;
+        close(connection);
+        return EXIT_FAILURE;
+    }
+
+    close(connection);
+
+    std::cerr << response.output << response.error;
+
+    return response.status;
+}